@@ -7,13 +7,19 @@ PATH_SRC 	      = src
 PATH_INCLUDE      = include
 PATH_EXAMPLES	  = example
 
+# Estadísticas de compresión (LZ77Estadisticas): make ESTADISTICAS=-DLZ77_ESTADISTICAS
+ESTADISTICAS  =
+# Solo la versión genérica del codificador/decodificador: make NUCLEOS=-DLZ77_SIN_NUCLEOS
+NUCLEOS       =
+
 INCLUDE_FLAGS = -I. -I$(PATH_INCLUDE)
 GLOBAL_CFLAGS = -std=c$(VESRION_C) $(INCLUDE_FLAGS) -masm=intel \
-				-D_ExceptionHandler -fdiagnostics-color=always $(DEBUG_LINUX)
+				-D_ExceptionHandler -fdiagnostics-color=always $(DEBUG_LINUX) $(ESTADISTICAS) $(NUCLEOS)
 
 CFLAGS 		  =  $(GLOBAL_CFLAGS) -O3 -Wno-unused-parameter \
 				-Wno-implicit-fallthrough -Wno-type-limits  \
 				-Wno-unused-variable -Wno-pointer-sign
 ARR_FLAGS     = -rc
+LDFLAGS       = -lpthread
 
-OBJECTS = 	lz77.o
\ No newline at end of file
+OBJECTS = 	lz77.o lz77_buscadores.o lz77_entropia.o lz77_diccionario.o lz77_ajuste.o lz77_hilos.o lz77_bloques.o lz77_flujo.o lz77_dedup.o lz77_paralelo.o
\ No newline at end of file
@@ -0,0 +1,474 @@
+/*
+ * Banco de pruebas de rendimiento.
+ *
+ * Comprime y descomprime cada archivo de un corpus con todas las combinaciones de
+ * parámetros pedidas y, para cada una, informa del ratio, la velocidad (mediana y
+ * percentiles de varias repeticiones) y la memoria máxima usada. Sin directorio se
+ * usa un corpus sintético generado en memoria (texto, binario, aleatorio y
+ * repetitivo), que también se puede volcar a disco con -g.
+ *
+ * Cada combinación se mide en un proceso hijo para que la memoria máxima de una no
+ * contamine la de las siguientes.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include "lz77.h"
+
+#define MAX_VALORES      16
+#define MAX_REPETICIONES 1000
+#define TAM_GENERADO     (1u << 20)
+
+typedef struct Lista {
+    int valores[MAX_VALORES];
+    int num;
+} Lista;
+
+typedef struct Archivo {
+    char nombre[256];
+    unsigned char *datos;
+    unsigned int tam;
+} Archivo;
+
+/* Resultado de una combinación, enviado por el hijo a través de una tubería */
+typedef struct Resultado {
+    int correcto;
+    long long tam_comprimido;
+    double comp_ms[3], desc_ms[3];    /* Mínimo, mediana y percentil 90 */
+    long memoria_kb;
+} Resultado;
+
+static double Ahora(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e3 + t.tv_nsec * 1e-6;
+}
+
+/* Generador pseudoaleatorio determinista (xorshift64) */
+static unsigned long long semilla = 0x9E3779B97F4A7C15ULL;
+static unsigned int Aleatorio(void) {
+    semilla ^= semilla << 13;
+    semilla ^= semilla >> 7;
+    semilla ^= semilla << 17;
+    return (unsigned int)(semilla >> 32);
+}
+
+/* Texto: palabras de un vocabulario con frecuencias muy desiguales */
+static void GenerarTexto(unsigned char *p, unsigned int n) {
+    static const char *palabras[] = {
+        "de", "la", "que", "el", "en", "y", "a", "los", "se", "del", "las", "un", "por", "con",
+        "no", "una", "su", "para", "es", "al", "lo", "como", "compresión", "diccionario",
+        "coincidencia", "longitud", "distancia", "sector", "ventana", "parámetros", "buffer",
+        "rendimiento", "datos", "archivo", "bloque", "flujo", "tabla", "cadena", "hash"
+    };
+    const unsigned int num = sizeof(palabras) / sizeof(palabras[0]);
+    unsigned int i = 0, columna = 0;
+    while (i < n) {
+        /* Mínimo de dos sorteos: favorece las primeras palabras */
+        unsigned int a = Aleatorio() % num, b = Aleatorio() % num;
+        const char *w = palabras[a < b ? a : b];
+        while (*w && i < n)
+            p[i++] = (unsigned char)*w++;
+        columna += 8;
+        if (i < n)
+            p[i++] = columna > 72 ? (columna = 0, '\n') : (Aleatorio() % 16 == 0 ? ',' : ' ');
+    }
+}
+
+/* Binario: registros de 32 bytes con contadores, campos pequeños y valores en coma flotante */
+static void GenerarBinario(unsigned char *p, unsigned int n) {
+    unsigned int i, j;
+    unsigned char registro[32];
+    for (i = 0; i < n; i += sizeof(registro)) {
+        unsigned int id = i / sizeof(registro);
+        float valor = (float)(Aleatorio() % 1000) * 0.25f;
+        memset(registro, 0, sizeof(registro));
+        memcpy(registro, &id, 4);
+        registro[4] = (unsigned char)(Aleatorio() % 4);
+        registro[5] = (unsigned char)(id % 7);
+        memcpy(registro + 8, &valor, 4);
+        for (j = 12; j < 20; j++)
+            registro[j] = (unsigned char)("ABCDEFGH"[Aleatorio() % 8]);
+        memcpy(p + i, registro, n - i < sizeof(registro) ? n - i : sizeof(registro));
+    }
+}
+
+static void GenerarAleatorio(unsigned char *p, unsigned int n) {
+    unsigned int i;
+    for (i = 0; i < n; i++)
+        p[i] = (unsigned char)Aleatorio();
+}
+
+/* Repetitivo: un patrón de 200 bytes con alguna mutación ocasional */
+static void GenerarRepetitivo(unsigned char *p, unsigned int n) {
+    unsigned char patron[200];
+    unsigned int i;
+    GenerarTexto(patron, sizeof(patron));
+    for (i = 0; i < n; i++) {
+        if (Aleatorio() % 4096 == 0)
+            patron[Aleatorio() % sizeof(patron)] = (unsigned char)Aleatorio();
+        p[i] = patron[i % sizeof(patron)];
+    }
+}
+
+static int CorpusSintetico(Archivo *archivos, unsigned int tam) {
+    static const char *nombres[] = {"texto", "binario", "aleatorio", "repetitivo"};
+    static void (*generadores[])(unsigned char *, unsigned int) = {
+        GenerarTexto, GenerarBinario, GenerarAleatorio, GenerarRepetitivo
+    };
+    int i;
+    for (i = 0; i < 4; i++) {
+        snprintf(archivos[i].nombre, sizeof(archivos[i].nombre), "%s", nombres[i]);
+        archivos[i].tam = tam;
+        archivos[i].datos = (unsigned char *)malloc(tam ? tam : 1);
+        if (!archivos[i].datos)
+            return -1;
+        generadores[i](archivos[i].datos, tam);
+    }
+    return 4;
+}
+
+static int LeerArchivo(const char *ruta, Archivo *a) {
+    FILE *f = fopen(ruta, "rb");
+    long tam;
+    if (!f)
+        return -1;
+    fseek(f, 0, SEEK_END);
+    tam = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if (tam < 0 || tam > 0x7FFFFFFFL) {
+        fclose(f);
+        return -1;
+    }
+    a->tam = (unsigned int)tam;
+    a->datos = (unsigned char *)malloc(a->tam ? a->tam : 1);
+    if (!a->datos || fread(a->datos, 1, a->tam, f) != a->tam) {
+        fclose(f);
+        free(a->datos);
+        return -1;
+    }
+    fclose(f);
+    return 0;
+}
+
+static int CompararNombres(const void *a, const void *b) {
+    return strcmp(((const Archivo *)a)->nombre, ((const Archivo *)b)->nombre);
+}
+
+/* Todos los archivos regulares del directorio, por orden alfabético */
+static int CorpusDirectorio(const char *directorio, Archivo **archivos) {
+    DIR *d = opendir(directorio);
+    struct dirent *e;
+    struct stat st;
+    char ruta[4096];
+    int num = 0, capacidad = 16;
+    if (!d)
+        return -1;
+    *archivos = (Archivo *)malloc(capacidad * sizeof(Archivo));
+    while (*archivos && (e = readdir(d)) != NULL) {
+        snprintf(ruta, sizeof(ruta), "%s/%s", directorio, e->d_name);
+        if (stat(ruta, &st) != 0 || !S_ISREG(st.st_mode))
+            continue;
+        if (num == capacidad) {
+            Archivo *nuevos = (Archivo *)realloc(*archivos, 2 * capacidad * sizeof(Archivo));
+            if (!nuevos)
+                break;
+            *archivos = nuevos;
+            capacidad *= 2;
+        }
+        snprintf((*archivos)[num].nombre, sizeof((*archivos)[num].nombre), "%s", e->d_name);
+        if (LeerArchivo(ruta, &(*archivos)[num]) == 0)
+            num++;
+        else
+            fprintf(stderr, "No se pudo leer %s\n", ruta);
+    }
+    closedir(d);
+    if (!*archivos)
+        return -1;
+    qsort(*archivos, num, sizeof(Archivo), CompararNombres);
+    return num;
+}
+
+static int GuardarCorpus(const char *directorio, unsigned int tam) {
+    Archivo archivos[4];
+    char ruta[4096];
+    int i, n = CorpusSintetico(archivos, tam);
+    if (n < 0)
+        return -1;
+    mkdir(directorio, 0755);
+    for (i = 0; i < n; i++) {
+        FILE *f;
+        snprintf(ruta, sizeof(ruta), "%s/%s.bin", directorio, archivos[i].nombre);
+        f = fopen(ruta, "wb");
+        if (!f || fwrite(archivos[i].datos, 1, archivos[i].tam, f) != archivos[i].tam) {
+            fprintf(stderr, "No se pudo escribir %s\n", ruta);
+            if (f)
+                fclose(f);
+            return -1;
+        }
+        fclose(f);
+        free(archivos[i].datos);
+    }
+    return 0;
+}
+
+static int LeerLista(const char *texto, Lista *l) {
+    char *fin;
+    l->num = 0;
+    while (*texto && l->num < MAX_VALORES) {
+        l->valores[l->num++] = (int)strtol(texto, &fin, 10);
+        if (fin == texto)
+            return -1;
+        texto = *fin == ',' ? fin + 1 : fin;
+    }
+    return *texto ? -1 : 0;
+}
+
+static int CompararDoubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+/* Mínimo, mediana y percentil 90 (rango más cercano) de n medidas */
+static void Percentiles(double *tiempos, int n, double *salida) {
+    qsort(tiempos, n, sizeof(double), CompararDoubles);
+    salida[0] = tiempos[0];
+    salida[1] = tiempos[(n + 1) / 2 - 1];
+    salida[2] = tiempos[(9 * n + 9) / 10 - 1];
+}
+
+/* Memoria residente actual en KiB */
+static long MemoriaResidente(void) {
+    long paginas_total, paginas_residentes = 0;
+    FILE *f = fopen("/proc/self/statm", "r");
+    if (f) {
+        if (fscanf(f, "%ld %ld", &paginas_total, &paginas_residentes) != 2)
+            paginas_residentes = 0;
+        fclose(f);
+    }
+    return paginas_residentes * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+/* Mide una combinación (en el proceso hijo) */
+static void Medir(const Archivo *a, const LZ77Params *params, int repeticiones, Resultado *r) {
+    double comp[MAX_REPETICIONES], desc[MAX_REPETICIONES], t;
+    long memoria_inicial = MemoriaResidente();
+    unsigned long long capacidad = CotaCompresion(params, a->tam);
+    unsigned char *comprimido = (unsigned char *)malloc(capacidad);
+    unsigned char *descomprimido = (unsigned char *)malloc(a->tam ? a->tam : 1);
+    LZ77Contexto *ctx = CrearContexto(params);
+    struct rusage uso;
+    int i, tam = -1, tam_desc = -1;
+
+    memset(r, 0, sizeof(*r));
+    if (!comprimido || !descomprimido || !ctx)
+        return;
+    for (i = 0; i < repeticiones; i++) {
+        t = Ahora();
+        tam = CodificarBufferCtx(ctx, a->datos, a->tam, comprimido, (unsigned int)capacidad);
+        comp[i] = Ahora() - t;
+        if (tam < 0)
+            return;
+    }
+    for (i = 0; i < repeticiones; i++) {
+        t = Ahora();
+        tam_desc = DecodificarBufferCtx(ctx, comprimido, tam, descomprimido, a->tam);
+        desc[i] = Ahora() - t;
+    }
+    r->correcto = tam_desc == (int)a->tam && memcmp(a->datos, descomprimido, a->tam) == 0;
+    r->tam_comprimido = tam;
+    Percentiles(comp, repeticiones, r->comp_ms);
+    Percentiles(desc, repeticiones, r->desc_ms);
+    getrusage(RUSAGE_SELF, &uso);
+    r->memoria_kb = uso.ru_maxrss - memoria_inicial;
+    DestruirContexto(ctx);
+    free(comprimido);
+    free(descomprimido);
+}
+
+static int MedirEnHijo(const Archivo *a, const LZ77Params *params, int repeticiones, Resultado *r) {
+    int tuberia[2], estado;
+    pid_t pid;
+    if (pipe(tuberia) != 0)
+        return -1;
+    fflush(NULL);
+    pid = fork();
+    if (pid < 0)
+        return -1;
+    if (pid == 0) {
+        close(tuberia[0]);
+        Medir(a, params, repeticiones, r);
+        _exit(write(tuberia[1], r, sizeof(*r)) == sizeof(*r) ? 0 : 1);
+    }
+    close(tuberia[1]);
+    estado = read(tuberia[0], r, sizeof(*r)) == sizeof(*r) ? 0 : -1;
+    close(tuberia[0]);
+    waitpid(pid, NULL, 0);
+    return estado;
+}
+
+static double MBs(unsigned int tam, double ms) {
+    return ms > 0 ? tam / 1e3 / ms : 0;
+}
+
+enum { FORMATO_TABLA, FORMATO_CSV, FORMATO_JSON };
+
+static void Imprimir(FILE *f, int formato, int primero, const Archivo *a, const LZ77Params *p, const Resultado *r) {
+    double ratio = a->tam ? 100.0 * r->tam_comprimido / a->tam : 0;
+    if (formato == FORMATO_CSV) {
+        if (primero)
+            fprintf(f, "archivo,tam,bits_diccionario,bits_hash,max_comparaciones,codicia,bit_sector,"
+                       "tam_comprimido,ratio,comp_mbs,desc_mbs,comp_ms_min,comp_ms_p50,comp_ms_p90,"
+                       "desc_ms_min,desc_ms_p50,desc_ms_p90,memoria_kb,correcto\n");
+        fprintf(f, "%s,%u,%d,%d,%d,%d,%d,%lld,%.3f,%.2f,%.2f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%ld,%d\n",
+                a->nombre, a->tam, p->bits_diccionario, p->bits_hash, p->max_comparaciones, p->codicia, p->bit_sector,
+                r->tam_comprimido, ratio, MBs(a->tam, r->comp_ms[1]), MBs(a->tam, r->desc_ms[1]),
+                r->comp_ms[0], r->comp_ms[1], r->comp_ms[2], r->desc_ms[0], r->desc_ms[1], r->desc_ms[2],
+                r->memoria_kb, r->correcto);
+    } else if (formato == FORMATO_JSON) {
+        fprintf(f, "%s\n  {\"archivo\": \"%s\", \"tam\": %u, \"bits_diccionario\": %d, \"bits_hash\": %d, "
+                   "\"max_comparaciones\": %d, \"codicia\": %d, \"bit_sector\": %d, \"tam_comprimido\": %lld, "
+                   "\"ratio\": %.3f, \"comp_mbs\": %.2f, \"desc_mbs\": %.2f, "
+                   "\"comp_ms\": {\"min\": %.3f, \"p50\": %.3f, \"p90\": %.3f}, "
+                   "\"desc_ms\": {\"min\": %.3f, \"p50\": %.3f, \"p90\": %.3f}, "
+                   "\"memoria_kb\": %ld, \"correcto\": %s}",
+                primero ? "[" : ",", a->nombre, a->tam, p->bits_diccionario, p->bits_hash, p->max_comparaciones,
+                p->codicia, p->bit_sector, r->tam_comprimido, ratio, MBs(a->tam, r->comp_ms[1]),
+                MBs(a->tam, r->desc_ms[1]), r->comp_ms[0], r->comp_ms[1], r->comp_ms[2],
+                r->desc_ms[0], r->desc_ms[1], r->desc_ms[2], r->memoria_kb, r->correcto ? "true" : "false");
+    } else {
+        if (primero)
+            fprintf(f, "%-16s %10s %3s %3s %5s %2s %3s %8s %9s %9s %9s %9s %8s %s\n", "archivo", "tam", "dic", "hsh",
+                    "comp", "cd", "sec", "ratio", "comp MB/s", "comp p90", "desc MB/s", "desc p90", "mem KiB", "ok");
+        fprintf(f, "%-16.16s %10u %3d %3d %5d %2d %3d %7.2f%% %9.2f %9.2f %9.2f %9.2f %8ld %s\n",
+                a->nombre, a->tam, p->bits_diccionario, p->bits_hash, p->max_comparaciones, p->codicia, p->bit_sector,
+                ratio, MBs(a->tam, r->comp_ms[1]), MBs(a->tam, r->comp_ms[2]), MBs(a->tam, r->desc_ms[1]),
+                MBs(a->tam, r->desc_ms[2]), r->memoria_kb, r->correcto ? "sí" : "NO");
+    }
+}
+
+static void Uso(const char *programa) {
+    printf("Uso: %s [opciones] [directorio]\n"
+           "  -d LISTA   valores de bits_diccionario (p. ej. 12,13,15)\n"
+           "  -H LISTA   valores de bits_hash\n"
+           "  -m LISTA   valores de max_comparaciones\n"
+           "  -c LISTA   valores de codicia\n"
+           "  -s LISTA   valores de bit_sector\n"
+           "  -r N       repeticiones por combinación (5)\n"
+           "  -f FORMATO tabla, csv o json (tabla)\n"
+           "  -o ARCHIVO escribe los resultados en ARCHIVO\n"
+           "  -t BYTES   tamaño de cada archivo del corpus sintético (%u)\n"
+           "  -g DIR     guarda el corpus sintético en DIR y termina\n"
+           "Sin directorio se usa el corpus sintético. Cada lista vale por defecto lo de default_params.\n",
+           programa, TAM_GENERADO);
+}
+
+int main(int argc, char *argv[]) {
+    Lista dic = {{default_params.bits_diccionario}, 1}, hsh = {{default_params.bits_hash}, 1};
+    Lista comp = {{default_params.max_comparaciones}, 1}, cod = {{default_params.codicia}, 1};
+    Lista sec = {{default_params.bit_sector}, 1};
+    const char *directorio = NULL, *destino = NULL, *generar = NULL;
+    unsigned int tam_generado = TAM_GENERADO;
+    int repeticiones = 5, formato = FORMATO_TABLA, num_archivos, opcion, fallos = 0, primero = 1;
+    int a, i, j, k, l, m;
+    Archivo *archivos, sinteticos[4];
+    FILE *salida = stdout;
+
+    while ((opcion = getopt(argc, argv, "d:H:m:c:s:r:f:o:t:g:h")) != -1) {
+        int error = 0;
+        switch (opcion) {
+        case 'd': error = LeerLista(optarg, &dic); break;
+        case 'H': error = LeerLista(optarg, &hsh); break;
+        case 'm': error = LeerLista(optarg, &comp); break;
+        case 'c': error = LeerLista(optarg, &cod); break;
+        case 's': error = LeerLista(optarg, &sec); break;
+        case 'r': repeticiones = atoi(optarg); break;
+        case 'o': destino = optarg; break;
+        case 't': tam_generado = (unsigned int)strtoul(optarg, NULL, 10); break;
+        case 'g': generar = optarg; break;
+        case 'f':
+            formato = !strcmp(optarg, "csv") ? FORMATO_CSV : !strcmp(optarg, "json") ? FORMATO_JSON :
+                      !strcmp(optarg, "tabla") ? FORMATO_TABLA : -1;
+            error = formato < 0;
+            break;
+        default:
+            Uso(argv[0]);
+            return opcion == 'h' ? 0 : 1;
+        }
+        if (error) {
+            Uso(argv[0]);
+            return 1;
+        }
+    }
+    if (repeticiones < 1 || repeticiones > MAX_REPETICIONES) {
+        fprintf(stderr, "Número de repeticiones no válido\n");
+        return 1;
+    }
+    if (generar)
+        return GuardarCorpus(generar, tam_generado) == 0 ? 0 : 1;
+    if (optind < argc)
+        directorio = argv[optind];
+
+    if (directorio) {
+        num_archivos = CorpusDirectorio(directorio, &archivos);
+    } else {
+        archivos = sinteticos;
+        num_archivos = CorpusSintetico(sinteticos, tam_generado);
+    }
+    if (num_archivos <= 0) {
+        fprintf(stderr, "Corpus vacío o no legible\n");
+        return 1;
+    }
+    if (destino && !(salida = fopen(destino, "w"))) {
+        perror("Error al abrir el archivo de salida");
+        return 1;
+    }
+
+    for (a = 0; a < num_archivos; a++)
+        for (i = 0; i < dic.num; i++)
+            for (j = 0; j < hsh.num; j++)
+                for (k = 0; k < comp.num; k++)
+                    for (l = 0; l < cod.num; l++)
+                        for (m = 0; m < sec.num; m++) {
+                            LZ77Params params = default_params;
+                            Resultado r;
+                            params.bits_diccionario = dic.valores[i];
+                            params.bits_hash = hsh.valores[j];
+                            params.max_comparaciones = comp.valores[k];
+                            params.codicia = cod.valores[l];
+                            params.bit_sector = sec.valores[m];
+                            if (params.bits_diccionario < 1 || params.bits_diccionario > LZ77_MAX_BITS_DICCIONARIO ||
+                                params.bit_sector < 1 || params.bit_sector > params.bits_diccionario ||
+                                params.bits_hash < 1 || params.bits_hash > 24 || params.max_comparaciones < 1) {
+                                fprintf(stderr, "Combinación no válida omitida (dic %d, hash %d, comp %d, sector %d)\n",
+                                        params.bits_diccionario, params.bits_hash, params.max_comparaciones, params.bit_sector);
+                                continue;
+                            }
+                            if (MedirEnHijo(&archivos[a], &params, repeticiones, &r) != 0) {
+                                fprintf(stderr, "Fallo al medir %s\n", archivos[a].nombre);
+                                fallos++;
+                                continue;
+                            }
+                            fallos += !r.correcto;
+                            Imprimir(salida, formato, primero, &archivos[a], &params, &r);
+                            primero = 0;
+                            fflush(salida);
+                        }
+    if (formato == FORMATO_JSON)
+        fprintf(salida, primero ? "[]\n" : "\n]\n");
+
+    if (salida != stdout)
+        fclose(salida);
+    for (a = 0; a < num_archivos; a++)
+        free(archivos[a].datos);
+    if (archivos != sinteticos)
+        free(archivos);
+    return fallos ? 1 : 0;
+}
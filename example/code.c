@@ -51,33 +51,34 @@ int main(int argc, char *argv[]) {
     /* Modificar los parámetros si es necesario */
     /* params.bits_diccionario = 12; */
 
-    /* Calcular los parámetros derivados */
-    DerivedParams derived = calculate_derived_params(&params);
-
-    /* Asignar memoria para las tablas globales */
-    diccionario = (unsigned char *)malloc(derived.tam_diccionario + derived.max_coincidencia);
-    hash = (unsigned int *)malloc(derived.tam_hash * sizeof(unsigned int));
-    siguiente_enlace = (unsigned int *)malloc(derived.tam_diccionario * sizeof(unsigned int));
-
-    if (!diccionario || !hash || !siguiente_enlace) {
+    /* Crear el contexto (reserva las tablas del diccionario y la tabla hash) */
+    LZ77Contexto *ctx = CrearContexto(&params);
+    if (!ctx) {
         fprintf(stderr, "Error al asignar memoria para las tablas de compresión\n");
         free(datos);
         free(comprimido);
         free(descomprimido);
-        if (diccionario) free(diccionario);
-        if (hash) free(hash);
-        if (siguiente_enlace) free(siguiente_enlace);
         return 1;
     }
 
     // Comprimir los datos
-    int tam_comprimido = CodificarBuffer(&params, &derived, datos, tam_datos, comprimido, tam_datos * 2);
+    int tam_comprimido = CodificarBufferCtx(ctx, datos, tam_datos, comprimido, tam_datos * 2);
     if (tam_comprimido < 0) {
         printf("Error al comprimir\n");
     } else {
         printf("Size original: %u, Size comprimido: %d\n", tam_datos, tam_comprimido);
+#ifdef LZ77_ESTADISTICAS
+        const LZ77Estadisticas *est = EstadisticasCtx(ctx);
+        printf("Literales: %llu, coincidencias: %llu\n", est->literales, est->coincidencias);
+        printf("Profundidad media: %.2f, máxima: %llu, límite alcanzado: %llu de %llu búsquedas\n",
+               est->busquedas ? (double)est->candidatos / est->busquedas : 0.0, est->profundidad_maxima,
+               est->limite_alcanzado, est->busquedas);
+        printf("Perezosas ganadas: %llu de %llu\n", est->perezosas_ganadas, est->intentos_perezosos);
+        printf("Tiempos (ms): eliminar %.3f, hashear %.3f, búsqueda %.3f, total %.3f\n",
+               est->ns_eliminar / 1e6, est->ns_hashear / 1e6, est->ns_busqueda / 1e6, est->ns_total / 1e6);
+#endif
         // Descomprimir los datos
-        int tam_descomprimido = DecodificarBuffer(&params, &derived, comprimido, tam_comprimido, descomprimido, tam_datos);
+        int tam_descomprimido = DecodificarBufferCtx(ctx, comprimido, tam_comprimido, descomprimido, tam_datos);
         if (tam_descomprimido < 0) {
             printf("Error al descomprimir\n");
         } else {
@@ -95,9 +96,7 @@ int main(int argc, char *argv[]) {
     free(datos);
     free(comprimido);
     free(descomprimido);
-    free(diccionario);
-    free(hash);
-    free(siguiente_enlace);
+    DestruirContexto(ctx);
 
     return 0;
 }
\ No newline at end of file
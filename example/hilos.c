@@ -0,0 +1,195 @@
+/*
+ * Prueba de carga con varios hilos.
+ *
+ * Cada hilo tiene su propio LZ77Contexto y su propia carga (texto sintético con una
+ * semilla distinta) y la comprime y descomprime varias veces sin ningún bloqueo.
+ * Para 1 .. N hilos se mide el rendimiento agregado y se comprueba que cada salida
+ * descomprime a su carga y que el comprimido es idéntico al obtenido con un solo
+ * hilo: si quedara estado compartido entre contextos, los hilos se pisarían. Con
+ * contextos independientes el rendimiento debería crecer casi linealmente con los
+ * hilos hasta el número de núcleos.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "lz77.h"
+#include "lz77_hilos.h"
+
+#define TAM_CARGA (1u << 20)
+
+typedef struct Trabajador {
+    pthread_t hilo;
+    const LZ77Params *params;
+    pthread_barrier_t *salida;        /* Todos los hilos empiezan a la vez */
+    const unsigned char *carga;
+    unsigned int tam;
+    const unsigned char *referencia;  /* Comprimido con un solo hilo */
+    int tam_referencia, repeticiones;
+    int correcto;
+} Trabajador;
+
+static double Ahora(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e3 + t.tv_nsec * 1e-6;
+}
+
+/* Texto: palabras de un vocabulario con frecuencias muy desiguales (xorshift64) */
+static void GenerarTexto(unsigned char *p, unsigned int n, unsigned long long semilla) {
+    static const char *palabras[] = {
+        "de", "la", "que", "el", "en", "y", "a", "los", "se", "del", "las", "un", "por", "con",
+        "no", "una", "su", "para", "es", "al", "lo", "como", "compresión", "diccionario",
+        "coincidencia", "longitud", "distancia", "sector", "ventana", "parámetros", "buffer"
+    };
+    const unsigned int num = sizeof(palabras) / sizeof(palabras[0]);
+    unsigned int i = 0;
+    while (i < n) {
+        unsigned int a, b;
+        const char *w;
+        semilla ^= semilla << 13;
+        semilla ^= semilla >> 7;
+        semilla ^= semilla << 17;
+        a = (unsigned int)(semilla >> 32) % num;
+        b = (unsigned int)(semilla >> 40) % num;
+        w = palabras[a < b ? a : b];
+        while (*w && i < n)
+            p[i++] = (unsigned char)*w++;
+        if (i < n)
+            p[i++] = (semilla & 15) == 0 ? '\n' : ' ';
+    }
+}
+
+static void *Trabajar(void *arg) {
+    Trabajador *t = (Trabajador *)arg;
+    unsigned int capacidad = (unsigned int)CotaCompresion(t->params, t->tam);
+    unsigned char *comprimido = (unsigned char *)malloc(capacidad);
+    unsigned char *descomprimido = (unsigned char *)malloc(t->tam ? t->tam : 1);
+    LZ77Contexto *ctx = CrearContexto(t->params);
+    int i;
+
+    t->correcto = comprimido && descomprimido && ctx;
+    pthread_barrier_wait(t->salida);
+    for (i = 0; t->correcto && i < t->repeticiones; i++) {
+        int tam = CodificarBufferCtx(ctx, t->carga, t->tam, comprimido, capacidad);
+        t->correcto = tam == t->tam_referencia && memcmp(comprimido, t->referencia, tam) == 0 &&
+                      DecodificarBufferCtx(ctx, comprimido, tam, descomprimido, t->tam) == (int)t->tam &&
+                      memcmp(descomprimido, t->carga, t->tam) == 0;
+    }
+    DestruirContexto(ctx);
+    free(comprimido);
+    free(descomprimido);
+    return NULL;
+}
+
+static void Uso(const char *programa) {
+    printf("Uso: %s [opciones]\n"
+           "  -n N       hasta N hilos (uno por núcleo)\n"
+           "  -t BYTES   tamaño de la carga de cada hilo (%u)\n"
+           "  -r N       compresiones y descompresiones por hilo (5)\n"
+           "  -1 .. -9   nivel de compresión (%d)\n",
+           programa, TAM_CARGA, LZ77_NIVEL_POR_DEFECTO);
+}
+
+int main(int argc, char *argv[]) {
+    LZ77Params params = default_params;
+    unsigned int tam = TAM_CARGA;
+    int max_hilos = LZ77NumeroNucleos(), repeticiones = 5, nivel = LZ77_NIVEL_POR_DEFECTO;
+    int opcion, n, i, fallos = 0;
+    unsigned char **cargas, **referencias;
+    int *tam_referencias;
+    double base = 0;
+
+    while ((opcion = getopt(argc, argv, "n:t:r:123456789h")) != -1) {
+        switch (opcion) {
+        case 'n': max_hilos = atoi(optarg); break;
+        case 't': tam = (unsigned int)strtoul(optarg, NULL, 10); break;
+        case 'r': repeticiones = atoi(optarg); break;
+        case 'h': Uso(argv[0]); return 0;
+        default:
+            if (opcion >= '1' && opcion <= '9') {
+                nivel = opcion - '0';
+                break;
+            }
+            Uso(argv[0]);
+            return 1;
+        }
+    }
+    if (max_hilos < 1 || repeticiones < 1 || AplicarNivel(&params, nivel) != 0) {
+        Uso(argv[0]);
+        return 1;
+    }
+
+    /* Una carga por hilo y su comprimido de referencia, calculado antes con un hilo */
+    cargas = (unsigned char **)calloc(max_hilos, sizeof(unsigned char *));
+    referencias = (unsigned char **)calloc(max_hilos, sizeof(unsigned char *));
+    tam_referencias = (int *)calloc(max_hilos, sizeof(int));
+    if (!cargas || !referencias || !tam_referencias)
+        return 1;
+    for (i = 0; i < max_hilos; i++) {
+        unsigned int capacidad = (unsigned int)CotaCompresion(&params, tam);
+        LZ77Contexto *ctx = CrearContexto(&params);
+        cargas[i] = (unsigned char *)malloc(tam ? tam : 1);
+        referencias[i] = (unsigned char *)malloc(capacidad);
+        if (!ctx || !cargas[i] || !referencias[i]) {
+            fprintf(stderr, "Sin memoria para la carga del hilo %d\n", i);
+            return 1;
+        }
+        GenerarTexto(cargas[i], tam, 0x9E3779B97F4A7C15ULL * (i + 1));
+        tam_referencias[i] = CodificarBufferCtx(ctx, cargas[i], tam, referencias[i], capacidad);
+        DestruirContexto(ctx);
+        if (tam_referencias[i] < 0)
+            return 1;
+    }
+
+    printf("%5s %12s %9s %10s %s\n", "hilos", "MB/s total", "aumento", "eficiencia", "ok");
+    for (n = 1; n <= max_hilos; n++) {
+        Trabajador *trabajadores = (Trabajador *)calloc(n, sizeof(Trabajador));
+        pthread_barrier_t salida;
+        double t, mbs;
+        int correcto = 1;
+
+        if (!trabajadores)
+            return 1;
+        pthread_barrier_init(&salida, NULL, n + 1);
+        for (i = 0; i < n; i++) {
+            trabajadores[i] = (Trabajador){0, &params, &salida, cargas[i], tam, referencias[i], tam_referencias[i],
+                                           repeticiones, 0};
+            if (pthread_create(&trabajadores[i].hilo, NULL, Trabajar, &trabajadores[i]) != 0) {
+                fprintf(stderr, "No se pudo crear el hilo %d\n", i);
+                return 1;
+            }
+        }
+        /* El tiempo cuenta desde que todos han reservado su contexto */
+        pthread_barrier_wait(&salida);
+        t = Ahora();
+        for (i = 0; i < n; i++) {
+            pthread_join(trabajadores[i].hilo, NULL);
+            correcto &= trabajadores[i].correcto;
+        }
+        t = Ahora() - t;
+        pthread_barrier_destroy(&salida);
+        free(trabajadores);
+
+        /* Bytes originales comprimidos y descomprimidos por milisegundo */
+        mbs = t > 0 ? 2.0 * n * repeticiones * tam / 1e3 / t : 0;
+        if (n == 1)
+            base = mbs;
+        printf("%5d %12.2f %8.2fx %9.1f%% %s\n", n, mbs, base > 0 ? mbs / base : 0,
+               base > 0 ? 100.0 * mbs / base / n : 0, correcto ? "sí" : "NO");
+        fflush(stdout);
+        fallos += !correcto;
+    }
+
+    for (i = 0; i < max_hilos; i++) {
+        free(cargas[i]);
+        free(referencias[i]);
+    }
+    free(cargas);
+    free(referencias);
+    free(tam_referencias);
+    return fallos ? 1 : 0;
+}
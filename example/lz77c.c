@@ -0,0 +1,503 @@
+/*
+ * Compresor/descompresor de línea de órdenes.
+ *
+ * Un archivo .lz7 es una secuencia de contenedores por bloques (lz77_bloques.h), o con
+ * deduplicación (lz77_dedup.h) si se comprimió con -D, cada uno con hasta un segmento
+ * de la entrada. Con -D los segmentos son SEGMENTOS_DEDUP veces más largos, porque las
+ * repeticiones solo se buscan dentro de cada uno. Se procesa segmento a segmento, así que la
+ * memoria usada no depende del tamaño del archivo:
+ *   - Las entradas regulares se proyectan en memoria (mmap) y las páginas de cada
+ *     segmento se descartan al terminarlo; '-' y las tuberías se leen por segmentos.
+ *   - Cada segmento se comprime o descomprime en un buffer alineado a página que se
+ *     vuelca con escrituras grandes, lo que también vale para tuberías.
+ *
+ * Un archivo .lz7 vacío o formado solo por contenedores vacíos descomprime a nada.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "lz77.h"
+#include "lz77_bloques.h"
+#include "lz77_dedup.h"
+#include "lz77_hilos.h"
+
+#define EXTENSION             ".lz7"
+#define ALINEACION            4096
+#define BLOQUES_POR_SEGMENTO  32
+#define SEGMENTOS_DEDUP       8
+#define VENTANA_MINIMA        8
+
+typedef struct Opciones {
+    int descomprimir;
+    int a_salida_estandar;
+    int forzar;
+    int detallado;
+    int dedup;
+    int num_hilos;
+    unsigned int tam_bloque;
+    const char *salida;
+    LZ77Params params;
+} Opciones;
+
+/* Entrada: proyección de un archivo regular o lectura por segmentos de un descriptor */
+typedef struct Entrada {
+    int fd;
+    const unsigned char *mapa;
+    size_t tam_mapa, pos;
+    unsigned char *buffer;        /* Solo sin proyección */
+    size_t capacidad;
+} Entrada;
+
+static double Ahora(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static void *ReservarAlineado(size_t tam) {
+    void *p = NULL;
+    if (posix_memalign(&p, ALINEACION, tam ? tam : 1) != 0)
+        return NULL;
+    return p;
+}
+
+/* Escribe todo el buffer reintentando las escrituras parciales */
+static int EscribirTodo(int fd, const unsigned char *datos, size_t tam) {
+    while (tam) {
+        ssize_t n = write(fd, datos, tam);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        datos += n;
+        tam -= (size_t)n;
+    }
+    return 0;
+}
+
+/* Lee hasta tam bytes; devuelve menos solo al llegar al final */
+static ssize_t LeerTodo(int fd, unsigned char *datos, size_t tam) {
+    size_t total = 0;
+    while (total < tam) {
+        ssize_t n = read(fd, datos + total, tam - total);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        if (n == 0)
+            break;
+        total += (size_t)n;
+    }
+    return (ssize_t)total;
+}
+
+static int AbrirEntrada(Entrada *e, int fd) {
+    struct stat st;
+    memset(e, 0, sizeof(*e));
+    e->fd = fd;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void *mapa = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapa != MAP_FAILED) {
+            madvise(mapa, (size_t)st.st_size, MADV_SEQUENTIAL);
+            e->mapa = (const unsigned char *)mapa;
+            e->tam_mapa = (size_t)st.st_size;
+        }
+    }
+    return 0;
+}
+
+static void CerrarEntrada(Entrada *e) {
+    if (e->mapa)
+        munmap((void *)e->mapa, e->tam_mapa);
+    free(e->buffer);
+}
+
+/* Descarta las páginas ya procesadas de la proyección: la memoria residente no crece */
+static void DescartarHasta(Entrada *e, size_t fin) {
+    size_t pagina = (size_t)sysconf(_SC_PAGESIZE);
+    size_t limite = fin / pagina * pagina;
+    if (e->mapa && limite)
+        madvise((void *)e->mapa, limite, MADV_DONTNEED);
+}
+
+/*
+ * Devuelve en *datos un puntero a los siguientes tam bytes como mucho (menos solo al
+ * final de la entrada) sin avanzar; -1 en caso de error.
+ */
+static ssize_t VerEntrada(Entrada *e, size_t tam, const unsigned char **datos) {
+    ssize_t n;
+    if (e->mapa) {
+        *datos = e->mapa + e->pos;
+        return (ssize_t)(e->tam_mapa - e->pos < tam ? e->tam_mapa - e->pos : tam);
+    }
+    if (tam > e->capacidad) {
+        unsigned char *b = (unsigned char *)realloc(e->buffer, tam);
+        if (!b)
+            return -1;
+        e->buffer = b;
+        e->capacidad = tam;
+    }
+    n = LeerTodo(e->fd, e->buffer, tam);
+    *datos = e->buffer;
+    return n;
+}
+
+static int Comprimir(const Opciones *o, int entrada, int salida, unsigned long long *total_entrada,
+                     unsigned long long *total_salida) {
+    const size_t tam_segmento = (size_t)o->tam_bloque * BLOQUES_POR_SEGMENTO * (o->dedup ? SEGMENTOS_DEDUP : 1);
+    const size_t capacidad = o->dedup ? CotaDedup(&o->params, tam_segmento, o->tam_bloque)
+                                      : CotaBloques(&o->params, tam_segmento, o->tam_bloque);
+    unsigned char *buffer = (unsigned char *)ReservarAlineado(capacidad);
+    const unsigned char *datos;
+    Entrada e;
+    int primero = 1, r = -1;
+
+    if (!buffer)
+        return -1;
+    AbrirEntrada(&e, entrada);
+    for (;;) {
+        ssize_t n = VerEntrada(&e, tam_segmento, &datos);
+        long long comprimido;
+        if (n < 0)
+            break;
+        /* Una entrada vacía produce un contenedor vacío */
+        if (n == 0 && !primero) {
+            r = 0;
+            break;
+        }
+        comprimido = o->dedup ? CodificarDedup(&o->params, datos, (size_t)n, buffer, capacidad, o->tam_bloque, o->num_hilos)
+                              : CodificarBloques(&o->params, datos, (size_t)n, buffer, capacidad, o->tam_bloque, o->num_hilos);
+        if (comprimido < 0 || EscribirTodo(salida, buffer, (size_t)comprimido) != 0)
+            break;
+        e.pos += (size_t)n;
+        DescartarHasta(&e, e.pos);
+        *total_entrada += (unsigned long long)n;
+        *total_salida += (unsigned long long)comprimido;
+        primero = 0;
+        if ((size_t)n < tam_segmento) {
+            r = 0;
+            break;
+        }
+    }
+    CerrarEntrada(&e);
+    free(buffer);
+    return r;
+}
+
+static unsigned int Leer32(const unsigned char *p) {
+    return (unsigned int)p[0] | ((unsigned int)p[1] << 8) | ((unsigned int)p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+static unsigned long long Leer64(const unsigned char *p) {
+    return (unsigned long long)Leer32(p) | ((unsigned long long)Leer32(p + 4) << 32);
+}
+
+/* Sin proyección: lee n bytes en la posición pos del buffer, ampliándolo si hace falta */
+static ssize_t LeerAlBuffer(Entrada *e, size_t pos, size_t n) {
+    if (pos > ((size_t)-1 >> 2) || n > ((size_t)-1 >> 2))
+        return -1;
+    if (e->capacidad - pos < n || e->capacidad < pos) {
+        size_t nueva = e->capacidad ? e->capacidad : 1u << 16;
+        unsigned char *b;
+        while (nueva < pos || nueva - pos < n)
+            nueva *= 2;
+        if (!(b = (unsigned char *)realloc(e->buffer, nueva)))
+            return -1;
+        e->buffer = b;
+        e->capacidad = nueva;
+    }
+    return LeerTodo(e->fd, e->buffer + pos, n);
+}
+
+/*
+ * Lee el siguiente contenedor completo. Con proyección solo calcula su tamaño
+ * recorriendo las cabeceras de bloque; sin ella lo copia al buffer de la entrada.
+ * Un contenedor con deduplicación lleva delante su cabecera y sus referencias, que
+ * se saltan para llegar al contenedor por bloques del residuo.
+ * Devuelve su tamaño, 0 al final de la entrada o -1 si está truncado.
+ */
+static long long SiguienteContenedor(Entrada *e, const unsigned char **contenedor) {
+    unsigned int num_bloques, i;
+    size_t base = 0, tam;
+
+    if (e->mapa) {
+        const unsigned char *p = e->mapa + e->pos;
+        size_t resto = e->tam_mapa - e->pos;
+        if (resto == 0)
+            return 0;
+        if (resto >= LZ77_DEDUP_CABECERA && memcmp(p, LZ77_DEDUP_MAGIA, 4) == 0) {
+            if (Leer64(p + 16) > resto - LZ77_DEDUP_CABECERA)
+                return -1;
+            base = LZ77_DEDUP_CABECERA + (size_t)Leer64(p + 16);
+        }
+        if (resto - base < LZ77_BLOQUES_CABECERA)
+            return -1;
+        num_bloques = Leer32(p + base + 24);
+        tam = base + LZ77_BLOQUES_CABECERA;
+        for (i = 0; i < num_bloques; i++) {
+            if (resto - tam < LZ77_BLOQUES_CABECERA_BLOQUE)
+                return -1;
+            tam += LZ77_BLOQUES_CABECERA_BLOQUE;
+            if (Leer32(p + tam - LZ77_BLOQUES_CABECERA_BLOQUE) > resto - tam)
+                return -1;
+            tam += Leer32(p + tam - LZ77_BLOQUES_CABECERA_BLOQUE);
+        }
+        if (p[base + 5] & LZ77_BLOQUES_INDICE) {
+            if (resto - tam < 8 * (size_t)num_bloques + LZ77_BLOQUES_PIE)
+                return -1;
+            tam += 8 * (size_t)num_bloques + LZ77_BLOQUES_PIE;
+        }
+        *contenedor = p;
+        return (long long)tam;
+    }
+
+    {
+        ssize_t n = LeerAlBuffer(e, 0, 4);
+        size_t leidos = 4;    /* Bytes ya leídos de la cabecera de bloques */
+        if (n == 0)
+            return 0;
+        if (n != 4)
+            return -1;
+        if (memcmp(e->buffer, LZ77_DEDUP_MAGIA, 4) == 0) {
+            if (LeerAlBuffer(e, 4, LZ77_DEDUP_CABECERA - 4) != LZ77_DEDUP_CABECERA - 4)
+                return -1;
+            if (Leer64(e->buffer + 16) > ((size_t)-1 >> 2))
+                return -1;
+            base = LZ77_DEDUP_CABECERA + (size_t)Leer64(e->buffer + 16);
+            if (LeerAlBuffer(e, LZ77_DEDUP_CABECERA, base - LZ77_DEDUP_CABECERA) != (ssize_t)(base - LZ77_DEDUP_CABECERA))
+                return -1;
+            leidos = 0;
+        }
+        if (LeerAlBuffer(e, base + leidos, LZ77_BLOQUES_CABECERA - leidos) != (ssize_t)(LZ77_BLOQUES_CABECERA - leidos))
+            return -1;
+    }
+    num_bloques = Leer32(e->buffer + base + 24);
+    tam = base + LZ77_BLOQUES_CABECERA;
+    for (i = 0; i < num_bloques; i++) {
+        unsigned int tam_bloque;
+        if (LeerAlBuffer(e, tam, LZ77_BLOQUES_CABECERA_BLOQUE) != LZ77_BLOQUES_CABECERA_BLOQUE)
+            return -1;
+        tam_bloque = Leer32(e->buffer + tam);
+        tam += LZ77_BLOQUES_CABECERA_BLOQUE;
+        if (LeerAlBuffer(e, tam, tam_bloque) != (ssize_t)tam_bloque)
+            return -1;
+        tam += tam_bloque;
+    }
+    if (e->buffer[base + 5] & LZ77_BLOQUES_INDICE) {
+        /* 8 bytes por bloque: nunca más que las cabeceras de bloque ya leídas */
+        size_t tam_indice = 8 * (size_t)num_bloques + LZ77_BLOQUES_PIE;
+        if (tam_indice > tam - base || LeerAlBuffer(e, tam, tam_indice) != (ssize_t)tam_indice)
+            return -1;
+        tam += tam_indice;
+    }
+    *contenedor = e->buffer;
+    return (long long)tam;
+}
+
+static int Descomprimir(const Opciones *o, int entrada, int salida, unsigned long long *total_entrada,
+                        unsigned long long *total_salida) {
+    unsigned char *buffer = NULL;
+    size_t capacidad = 0;
+    const unsigned char *contenedor;
+    Entrada e;
+    int r = -1, dedup;
+
+    AbrirEntrada(&e, entrada);
+    for (;;) {
+        long long tam = SiguienteContenedor(&e, &contenedor), original, n;
+        if (tam == 0) {
+            r = 0;
+            break;
+        }
+        dedup = tam > 0 && memcmp(contenedor, LZ77_DEDUP_MAGIA, 4) == 0;
+        if (tam < 0 || (original = dedup ? TamanoOriginalDedup(contenedor, (size_t)tam)
+                                         : TamanoOriginalBloques(contenedor, (size_t)tam)) < 0) {
+            fprintf(stderr, "Contenedor truncado o no válido\n");
+            break;
+        }
+        if ((size_t)original > capacidad) {
+            free(buffer);
+            capacidad = (size_t)original;
+            if (!(buffer = (unsigned char *)ReservarAlineado(capacidad)))
+                break;
+        }
+        n = dedup ? DecodificarDedup(contenedor, (size_t)tam, buffer, capacidad, o->num_hilos)
+                  : DecodificarBloques(contenedor, (size_t)tam, buffer, capacidad, o->num_hilos);
+        if (n != original || EscribirTodo(salida, buffer, (size_t)n) != 0)
+            break;
+        if (e.mapa) {
+            e.pos += (size_t)tam;
+            DescartarHasta(&e, e.pos);
+        }
+        *total_entrada += (unsigned long long)tam;
+        *total_salida += (unsigned long long)n;
+    }
+    CerrarEntrada(&e);
+    free(buffer);
+    return r;
+}
+
+/* Nombre de salida por defecto: añade o quita la extensión */
+static char *NombreSalida(const char *entrada, int descomprimir) {
+    size_t n = strlen(entrada), ext = strlen(EXTENSION);
+    char *nombre = (char *)malloc(n + ext + 1);
+    if (!nombre)
+        return NULL;
+    if (descomprimir) {
+        if (n <= ext || strcmp(entrada + n - ext, EXTENSION) != 0) {
+            fprintf(stderr, "%s: sin extensión %s, se ignora\n", entrada, EXTENSION);
+            free(nombre);
+            return NULL;
+        }
+        memcpy(nombre, entrada, n - ext);
+        nombre[n - ext] = '\0';
+    } else {
+        memcpy(nombre, entrada, n);
+        memcpy(nombre + n, EXTENSION, ext + 1);
+    }
+    return nombre;
+}
+
+static int ProcesarArchivo(const Opciones *o, const char *nombre) {
+    int estandar = strcmp(nombre, "-") == 0;
+    int entrada = estandar ? STDIN_FILENO : open(nombre, O_RDONLY);
+    int salida = STDOUT_FILENO, r;
+    char *nombre_salida = NULL;
+    unsigned long long total_entrada = 0, total_salida = 0;
+    double t;
+
+    if (entrada < 0) {
+        perror(nombre);
+        return -1;
+    }
+    if (!o->a_salida_estandar && (!estandar || o->salida)) {
+        nombre_salida = o->salida ? strdup(o->salida) : NombreSalida(nombre, o->descomprimir);
+        if (!nombre_salida) {
+            close(entrada);
+            return -1;
+        }
+        salida = open(nombre_salida, O_WRONLY | O_CREAT | O_TRUNC | (o->forzar ? 0 : O_EXCL), 0644);
+        if (salida < 0) {
+            perror(nombre_salida);
+            free(nombre_salida);
+            close(entrada);
+            return -1;
+        }
+    }
+
+    t = Ahora();
+    r = o->descomprimir ? Descomprimir(o, entrada, salida, &total_entrada, &total_salida)
+                        : Comprimir(o, entrada, salida, &total_entrada, &total_salida);
+    t = Ahora() - t;
+
+    if (!estandar)
+        close(entrada);
+    if (nombre_salida) {
+        if (close(salida) != 0)
+            r = -1;
+        if (r != 0)
+            unlink(nombre_salida);
+    }
+    if (r != 0)
+        fprintf(stderr, "%s: error al %s\n", nombre, o->descomprimir ? "descomprimir" : "comprimir");
+    else if (o->detallado)
+        fprintf(stderr, "%s: %llu -> %llu bytes (%.2f%%), %.1f MB/s\n", nombre, total_entrada, total_salida,
+                total_entrada ? 100.0 * total_salida / total_entrada : 0.0,
+                t > 0 ? (o->descomprimir ? total_salida : total_entrada) / t / 1e6 : 0.0);
+    free(nombre_salida);
+    return r;
+}
+
+static void Uso(const char *programa) {
+    fprintf(stderr,
+            "Uso: %s [opciones] [archivo...]\n"
+            "  -d         descomprimir\n"
+            "  -c         escribir en la salida estándar\n"
+            "  -o ARCHIVO nombre de salida (con un solo archivo)\n"
+            "  -f         sobrescribir la salida si existe\n"
+            "  -1 .. -9   nivel de compresión (%d)\n"
+            "  -w BITS    bits de la ventana, %d..%d (%d)\n"
+            "  -T N       hilos (0 = uno por núcleo); con pocos bloques también dentro de cada uno\n"
+            "  -B BYTES   tamaño de bloque (%u)\n"
+            "  -e         etapa de entropía (Huffman)\n"
+            "  -a         elegir el formato de cada bloque según sus datos (ignora -w)\n"
+            "  -x         longitudes y distancias de tamaño variable (coincidencias largas)\n"
+            "  -L         tokens en carriles (descompresión más rápida; sin -e)\n"
+            "  -D         buscar antes repeticiones lejanas (fuera de la ventana)\n"
+            "  -v         informar del ratio y la velocidad\n"
+            "Sin archivos, o con '-', se usa la entrada estándar y se escribe en la salida estándar.\n"
+            "Al comprimir se añade %s al nombre; al descomprimir se quita.\n",
+            programa, LZ77_NIVEL_POR_DEFECTO, VENTANA_MINIMA, LZ77_MAX_BITS_DICCIONARIO,
+            default_params.bits_diccionario, LZ77_BLOQUE_POR_DEFECTO, EXTENSION);
+}
+
+int main(int argc, char *argv[]) {
+    Opciones o;
+    int c, i, errores = 0, nivel = LZ77_NIVEL_POR_DEFECTO;
+    long valor;
+
+    memset(&o, 0, sizeof(o));
+    o.params = default_params;
+    o.tam_bloque = LZ77_BLOQUE_POR_DEFECTO;
+    while ((c = getopt(argc, argv, "123456789dcfo:w:T:B:eaxLDvh")) != -1) {
+        switch (c) {
+        case '1': case '2': case '3': case '4': case '5': case '6': case '7': case '8': case '9':
+            nivel = c - '0';
+            break;
+        case 'd': o.descomprimir = 1; break;
+        case 'c': o.a_salida_estandar = 1; break;
+        case 'f': o.forzar = 1; break;
+        case 'o': o.salida = optarg; break;
+        case 'e': o.params.entropia = LZ77_ENTROPIA_HUFFMAN; break;
+        case 'a': o.params.autoajuste = 1; break;
+        case 'x': o.params.codigos = LZ77_CODIGOS_VARIABLES; break;
+        case 'L': o.params.carriles = 1; break;
+        case 'D': o.dedup = 1; break;
+        case 'v': o.detallado = 1; break;
+        case 'w':
+            valor = strtol(optarg, NULL, 10);
+            if (valor < VENTANA_MINIMA || valor > LZ77_MAX_BITS_DICCIONARIO) {
+                fprintf(stderr, "Ventana no válida: %s\n", optarg);
+                return 1;
+            }
+            o.params.bits_diccionario = (int)valor;
+            break;
+        case 'T':
+            o.num_hilos = (int)strtol(optarg, NULL, 10);
+            break;
+        case 'B':
+            valor = strtol(optarg, NULL, 10);
+            if (valor < (long)LZ77_BLOQUE_MINIMO || valor > (long)LZ77_BLOQUE_MAXIMO) {
+                fprintf(stderr, "Tamaño de bloque no válido: %s\n", optarg);
+                return 1;
+            }
+            o.tam_bloque = (unsigned int)valor;
+            break;
+        default:
+            Uso(argv[0]);
+            return c == 'h' ? 0 : 1;
+        }
+    }
+    AplicarNivel(&o.params, nivel);
+    if (o.params.bit_sector > o.params.bits_diccionario)
+        o.params.bit_sector = o.params.bits_diccionario;
+    if (o.salida && argc - optind > 1) {
+        fprintf(stderr, "-o solo admite un archivo de entrada\n");
+        return 1;
+    }
+
+    if (optind == argc)
+        return ProcesarArchivo(&o, "-") != 0;
+    for (i = optind; i < argc; i++)
+        errores += ProcesarArchivo(&o, argv[i]) != 0;
+    return errores != 0;
+}
@@ -0,0 +1,261 @@
+/*
+ * Pruebas de robustez del descompresor.
+ *
+ * Construye a mano flujos de tokens, válidos y dañados, con los dos códigos de
+ * coincidencia y comprueba que DecodificarBufferCtx y DecodificarFlujo aceptan los
+ * válidos y rechazan los demás: distancias que salen de lo ya decodificado (el
+ * diccionario del flujo no se inicializa, así que aceptarlas devolvería memoria sin
+ * escribir) y flujos truncados. También comprueba que la etapa de entropía no
+ * almacena sin comprimir entradas que solo Huffman puede reducir, y que la API
+ * clásica, sobre las tablas globales, sigue comprimiendo igual que la de contextos.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lz77.h"
+#include "lz77_flujo.h"
+
+#define TAM_SALIDA 256
+
+/* Escritor de bits LSB primero, como el del codificador */
+typedef struct Escritor {
+    unsigned char datos[64];
+    unsigned int bits;
+} Escritor;
+
+static void Poner(Escritor *e, unsigned int valor, unsigned int num_bits) {
+    unsigned int i;
+    for (i = 0; i < num_bits; i++, e->bits++)
+        if ((valor >> i) & 1)
+            e->datos[e->bits >> 3] |= (unsigned char)(1u << (e->bits & 7));
+}
+
+static unsigned int NumBits(unsigned int v) {
+    return v ? 32 - __builtin_clz(v) : 0;
+}
+
+static void Literal(Escritor *e, const LZ77Params *p, unsigned int c) {
+    Poner(e, 0, 1);
+    Poner(e, c, p->bits_caracter);
+}
+
+static void Coincidencia(Escritor *e, const LZ77Params *p, unsigned int longitud, unsigned int distancia) {
+    Poner(e, 1, 1);
+    Poner(e, longitud - p->umbral - 1, p->bits_coincidencia);
+    if (p->codigos == LZ77_CODIGOS_FIJOS) {
+        Poner(e, distancia, p->bits_diccionario);
+    } else {
+        /* Cubeta (bits de la distancia) y los bits bajo el más alto */
+        unsigned int cubeta = NumBits(distancia);
+        Poner(e, cubeta, NumBits(p->bits_diccionario));
+        if (cubeta > 1)
+            Poner(e, distancia, cubeta - 1);
+    }
+}
+
+static void Fin(Escritor *e, const LZ77Params *p) {
+    Poner(e, 1, 1);
+    if (p->codigos == LZ77_CODIGOS_FIJOS) {
+        Poner(e, (1u << p->bits_coincidencia) - 1, p->bits_coincidencia);
+    } else {
+        Poner(e, 0, p->bits_coincidencia);
+        Poner(e, 0, NumBits(p->bits_diccionario));
+    }
+}
+
+static unsigned int Bytes(const Escritor *e) {
+    return (e->bits + 7) / 8;
+}
+
+/* Tamaño decodificado o -1 si se rechaza */
+static int DecodificarConBuffer(const LZ77Params *p, const unsigned char *in, unsigned int tam, unsigned char *out) {
+    LZ77Contexto *ctx = CrearContexto(p);
+    int r;
+    if (!ctx)
+        return -2;
+    r = DecodificarBufferCtx(ctx, in, tam, out, TAM_SALIDA);
+    DestruirContexto(ctx);
+    return r < 0 ? -1 : r;
+}
+
+static int DecodificarConFlujo(const LZ77Params *p, const unsigned char *in, unsigned int tam, unsigned char *out) {
+    LZ77Flujo *flujo = CrearFlujoDecodificacion(p);
+    int r;
+    if (!flujo)
+        return -2;
+    flujo->entrada = in;
+    flujo->disponible_entrada = tam;
+    flujo->salida = out;
+    flujo->disponible_salida = TAM_SALIDA;
+    r = DecodificarFlujo(flujo, LZ77_FLUJO_FINALIZAR);
+    r = r == LZ77_FLUJO_FIN ? (int)flujo->total_salida : -1;
+    DestruirFlujo(flujo);
+    return r;
+}
+
+static int fallos = 0;
+
+/* esperado: los bytes que debe producir, o NULL si el flujo se ha de rechazar */
+static void Comprobar(const char *nombre, const LZ77Params *p, const unsigned char *in, unsigned int tam,
+                      const char *esperado) {
+    unsigned char salida[TAM_SALIDA];
+    int (*decodificadores[2])(const LZ77Params *, const unsigned char *, unsigned int, unsigned char *) = {
+        DecodificarConBuffer, DecodificarConFlujo
+    };
+    static const char *nombres[2] = {"buffer", "flujo"};
+    int i;
+    for (i = 0; i < 2; i++) {
+        int r = decodificadores[i](p, in, tam, salida), correcto;
+        if (esperado)
+            correcto = r == (int)strlen(esperado) && memcmp(salida, esperado, r) == 0;
+        else
+            correcto = r == -1;
+        printf("%-9s %-24s %-6s %s\n", p->codigos == LZ77_CODIGOS_FIJOS ? "fijos" : "variables", nombre,
+               nombres[i], correcto ? "correcto" : "FALLO");
+        fallos += !correcto;
+    }
+}
+
+static void Probar(int codigos) {
+    LZ77Params p = default_params;
+    Escritor e;
+    const char *abcde = "abcde";
+    unsigned int i;
+    p.codigos = codigos;
+
+    /* "abcde" y una copia de 3 bytes desde 5 atrás */
+    memset(&e, 0, sizeof(e));
+    for (i = 0; i < 5; i++)
+        Literal(&e, &p, (unsigned char)abcde[i]);
+    Coincidencia(&e, &p, 3, 5);
+    Fin(&e, &p);
+    Comprobar("válido", &p, e.datos, Bytes(&e), "abcdeabc");
+    Comprobar("truncado", &p, e.datos, Bytes(&e) / 2, NULL);
+    Comprobar("sin marca de fin", &p, e.datos, 5 * (1 + p.bits_caracter) / 8, NULL);
+
+    /* Coincidencia como primer token */
+    memset(&e, 0, sizeof(e));
+    Coincidencia(&e, &p, 3, 5);
+    Fin(&e, &p);
+    Comprobar("distancia sin datos", &p, e.datos, Bytes(&e), NULL);
+
+    /* Distancia mayor que lo decodificado */
+    memset(&e, 0, sizeof(e));
+    Literal(&e, &p, 'a');
+    Literal(&e, &p, 'b');
+    Coincidencia(&e, &p, 3, 5);
+    Fin(&e, &p);
+    Comprobar("distancia tras 2 bytes", &p, e.datos, Bytes(&e), NULL);
+
+    /* Distancia 0 (solo se puede escribir con códigos fijos) */
+    if (codigos == LZ77_CODIGOS_FIJOS) {
+        memset(&e, 0, sizeof(e));
+        Literal(&e, &p, 'a');
+        Coincidencia(&e, &p, 3, 0);
+        Fin(&e, &p);
+        Comprobar("distancia 0", &p, e.datos, Bytes(&e), NULL);
+    }
+}
+
+/*
+ * Con la etapa de entropía, una entrada sin apenas coincidencias pero con pocos
+ * símbolos (bytes al azar de un alfabeto de 32) se comprime con Huffman a unos 5 bits
+ * por byte: el muestreo de incompresibles no debe darla por incompresible y almacenarla.
+ */
+static void ProbarBajaEntropia(void) {
+    const unsigned int tam = 1u << 20;
+    LZ77Params p = default_params;
+    unsigned long long semilla = 0x9E3779B97F4A7C15ULL;
+    unsigned int capacidad, i;
+    unsigned char *datos, *comprimido, *descomprimido;
+    LZ77Contexto *ctx;
+    int r, correcto = 0;
+
+    p.entropia = LZ77_ENTROPIA_HUFFMAN;
+    capacidad = (unsigned int)CotaCompresion(&p, tam);
+    datos = (unsigned char *)malloc(tam);
+    comprimido = (unsigned char *)malloc(capacidad);
+    descomprimido = (unsigned char *)malloc(tam);
+    ctx = CrearContexto(&p);
+    if (datos && comprimido && descomprimido && ctx) {
+        for (i = 0; i < tam; i++) {
+            semilla ^= semilla << 13;
+            semilla ^= semilla >> 7;
+            semilla ^= semilla << 17;
+            datos[i] = (unsigned char)('A' + (semilla >> 59));
+        }
+        r = CodificarBufferCtx(ctx, datos, tam, comprimido, capacidad);
+        correcto = r > 0 && (unsigned int)r < tam * 7 / 8 &&
+                   DecodificarBufferCtx(ctx, comprimido, r, descomprimido, tam) == (int)tam &&
+                   memcmp(descomprimido, datos, tam) == 0;
+    }
+    printf("%-9s %-24s %-6s %s\n", "entropía", "32 símbolos al azar", "buffer", correcto ? "correcto" : "FALLO");
+    fallos += !correcto;
+    DestruirContexto(ctx);
+    free(datos);
+    free(comprimido);
+    free(descomprimido);
+}
+
+/*
+ * API clásica: CodificarBuffer y DecodificarBuffer sobre las tablas globales, que
+ * reserva el llamante como en las versiones anteriores, deben seguir comprimiendo lo
+ * mismo que CodificarBufferCtx con los mismos parámetros. Se comprimen dos entradas
+ * seguidas para comprobar también que las globales se reinician entre llamadas.
+ */
+static void ProbarApiClasica(void) {
+    const unsigned int tam = 300000;
+    static const char *palabras[] = {"coincidencia ", "diccionario ", "ventana ", "de ", "la ", "hash\n"};
+    LZ77Params p = default_params;
+    DerivedParams d = calculate_derived_params(&p);
+    unsigned long long semilla = 0x2545F4914F6CDD1DULL;
+    unsigned int capacidad = (unsigned int)CotaCompresion(&p, tam), i, n;
+    unsigned char *datos = (unsigned char *)malloc(tam);
+    unsigned char *comprimido = (unsigned char *)malloc(capacidad);
+    unsigned char *referencia = (unsigned char *)malloc(capacidad);
+    unsigned char *descomprimido = (unsigned char *)malloc(tam);
+    LZ77Contexto *ctx = CrearContexto(&p);
+    int r, correcto = 1, vuelta;
+
+    diccionario = (unsigned char *)malloc(d.tam_diccionario + d.max_coincidencia);
+    hash = (unsigned int *)malloc(d.tam_hash * sizeof(unsigned int));
+    siguiente_enlace = (unsigned int *)malloc(d.tam_diccionario * sizeof(unsigned int));
+    if (!datos || !comprimido || !referencia || !descomprimido || !ctx || !diccionario || !hash || !siguiente_enlace)
+        correcto = 0;
+    for (vuelta = 0; correcto && vuelta < 2; vuelta++) {
+        /* Texto de pocas palabras; la segunda vuelta, con otra semilla */
+        for (i = 0; i < tam; i += n) {
+            const char *w;
+            semilla ^= semilla << 13;
+            semilla ^= semilla >> 7;
+            semilla ^= semilla << 17;
+            w = palabras[semilla % (sizeof(palabras) / sizeof(palabras[0]))];
+            for (n = 0; w[n] && i + n < tam; n++)
+                datos[i + n] = (unsigned char)w[n];
+        }
+        r = CodificarBuffer(&p, &d, datos, tam, comprimido, capacidad);
+        correcto = r > 0 && CodificarBufferCtx(ctx, datos, tam, referencia, capacidad) == r &&
+                   memcmp(comprimido, referencia, r) == 0 &&
+                   DecodificarBuffer(&p, &d, comprimido, r, descomprimido, tam) == (int)tam &&
+                   memcmp(descomprimido, datos, tam) == 0;
+    }
+    printf("%-9s %-24s %-6s %s\n", "clásica", "ida y vuelta", "buffer", correcto ? "correcto" : "FALLO");
+    fallos += !correcto;
+    DestruirContexto(ctx);
+    free(diccionario);
+    free(hash);
+    free(siguiente_enlace);
+    free(datos);
+    free(comprimido);
+    free(referencia);
+    free(descomprimido);
+}
+
+int main(void) {
+    Probar(LZ77_CODIGOS_FIJOS);
+    Probar(LZ77_CODIGOS_VARIABLES);
+    ProbarBajaEntropia();
+    ProbarApiClasica();
+    printf("%s\n", fallos ? "Hay fallos" : "Todas las pruebas correctas");
+    return fallos ? 1 : 0;
+}
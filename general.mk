@@ -2,7 +2,19 @@ include config.mk
 
 all: $(TARGET).a
 	ar -t $^
-	gcc $(CFLAGS) $(INCLUDE_FLAGS) $(PATH_EXAMPLES)/code.c -L. -lLZ77_c -o code.$(EXTENSION)
+	gcc $(CFLAGS) $(INCLUDE_FLAGS) $(PATH_EXAMPLES)/code.c -L. -lLZ77_c $(LDFLAGS) -o code.$(EXTENSION)
+
+bench: $(TARGET).a
+	gcc $(CFLAGS) $(INCLUDE_FLAGS) $(PATH_EXAMPLES)/bench.c -L. -lLZ77_c $(LDFLAGS) -o bench.$(EXTENSION)
+
+hilos: $(TARGET).a
+	gcc $(CFLAGS) $(INCLUDE_FLAGS) $(PATH_EXAMPLES)/hilos.c -L. -lLZ77_c $(LDFLAGS) -o hilos.$(EXTENSION)
+
+robustez: $(TARGET).a
+	gcc $(CFLAGS) $(INCLUDE_FLAGS) $(PATH_EXAMPLES)/robustez.c -L. -lLZ77_c $(LDFLAGS) -o robustez.$(EXTENSION)
+
+cli: $(TARGET).a
+	gcc $(CFLAGS) $(INCLUDE_FLAGS) $(PATH_EXAMPLES)/lz77c.c -L. -lLZ77_c $(LDFLAGS) -o lz77c.$(EXTENSION)
 
 $(TARGET).a: $(OBJECTS)
 	$(ARR) $(ARR_FLAGS) $@ $^
@@ -11,6 +23,33 @@ $(TARGET).a: $(OBJECTS)
 lz77.o: $(PATH_SRC)/lz77.c
 	$(CC) $(CFLAGS) -c $^ -o $@
 
+lz77_buscadores.o: $(PATH_SRC)/lz77_buscadores.c
+	$(CC) $(CFLAGS) -c $^ -o $@
+
+lz77_entropia.o: $(PATH_SRC)/lz77_entropia.c
+	$(CC) $(CFLAGS) -c $^ -o $@
+
+lz77_diccionario.o: $(PATH_SRC)/lz77_diccionario.c
+	$(CC) $(CFLAGS) -c $^ -o $@
+
+lz77_ajuste.o: $(PATH_SRC)/lz77_ajuste.c
+	$(CC) $(CFLAGS) -c $^ -o $@
+
+lz77_hilos.o: $(PATH_SRC)/lz77_hilos.c
+	$(CC) $(CFLAGS) -c $^ -o $@
+
+lz77_bloques.o: $(PATH_SRC)/lz77_bloques.c
+	$(CC) $(CFLAGS) -c $^ -o $@
+
+lz77_flujo.o: $(PATH_SRC)/lz77_flujo.c
+	$(CC) $(CFLAGS) -c $^ -o $@
+
+lz77_dedup.o: $(PATH_SRC)/lz77_dedup.c
+	$(CC) $(CFLAGS) -c $^ -o $@
+
+lz77_paralelo.o: $(PATH_SRC)/lz77_paralelo.c
+	$(CC) $(CFLAGS) -c $^ -o $@
+
 cleanobj:
 	$(RM) $(RMFLAGS) *.o
 
@@ -20,4 +59,4 @@ cleanall: cleanobj
 
 .SILENT: clean cleanobj cleanall
 .IGNORE: cleanobj cleanall
-.PHONY:  cleanobj cleanall
\ No newline at end of file
+.PHONY:  bench hilos robustez cli cleanobj cleanall
\ No newline at end of file
@@ -56,7 +56,8 @@ typedef struct LZ77Params {
      *
      * Determina la longitud máxima de una coincidencia que puede ser codificada.
      * Un valor más alto permite codificar coincidencias más largas, pero requiere más bits para representar la longitud.
-     * La longitud máxima de coincidencia es (1 << bits_coincidencia) + umbral - 1.
+     * La longitud máxima de coincidencia es (1 << bits_coincidencia) + umbral - 1
+     * (con LZ77_CODIGOS_VARIABLES, la mayor que se codifica sin escape).
      *
      * @range 1 a ... (Depende del tamaño del diccionario y el tiempo de compresión deseado)
      */
@@ -92,8 +93,168 @@ typedef struct LZ77Params {
      * @range 1 a ... (Depende de la memoria disponible y el tiempo de compresión deseado)
      */
     int bit_sector;
+
+    /**
+     * @brief Activa el modo de ventana grande.
+     *
+     * Las tablas hash y de enlaces guardan posiciones absolutas de 32 bits y los candidatos
+     * fuera de la ventana se descartan por distancia, por lo que reutilizar un sector ya no
+     * requiere recorrer las tablas (EliminarDatos pasa a ser O(1)). Permite diccionarios de
+     * hasta 2^LZ77_MAX_BITS_DICCIONARIO bytes y produce la misma salida que el modo clásico.
+     * Se activa automáticamente si bits_diccionario > LZ77_MAX_BITS_DICCIONARIO_CLASICO.
+     * Los contextos de CrearContexto/CrearContextoEn lo usan siempre (su reinicio no
+     * recorre las tablas), así que este campo solo afecta a la API clásica.
+     *
+     * @range 0 o 1
+     */
+    int ventana_grande;
+
+    /**
+     * @brief Estrategia de análisis (parseo) del codificador.
+     *
+     * LZ77_ESTRATEGIA_CODICIA mantiene el comportamiento clásico según el campo codicia.
+     * Las demás eligen explícitamente entre análisis voraz, perezoso de uno o dos pasos y
+     * óptimo (programación dinámica sobre el coste en bits de los tokens). Todas producen
+     * el mismo formato y se decodifican con DecodificarBuffer.
+     *
+     * @range LZ77_ESTRATEGIA_CODICIA a LZ77_ESTRATEGIA_OPTIMA
+     */
+    int estrategia;
+
+    /**
+     * @brief Buscador de coincidencias.
+     *
+     * LZ77_BUSCADOR_CADENA es la cadena hash clásica (tam_hash + tam_diccionario enteros).
+     * LZ77_BUSCADOR_DOBLE añade una tabla de cabezas indexada por una clave larga
+     * (LZ77_CLAVE_LARGA bytes) que se consulta antes de recorrer la cadena
+     * (2 * tam_hash + tam_diccionario enteros). LZ77_BUSCADOR_ARBOL es un árbol binario al
+     * estilo del bt4 de LZMA para búsquedas profundas (tam_hash + 2 * tam_diccionario
+     * enteros). LZ77_BUSCADOR_RAPIDO es una tabla hash de una sola sonda sin cadenas
+     * (tam_hash enteros). Los buscadores distintos de la cadena usan posiciones absolutas
+     * (modo ventana grande) y solo están disponibles a través de la API con contexto.
+     *
+     * @range LZ77_BUSCADOR_CADENA a LZ77_BUSCADOR_RAPIDO
+     */
+    int buscador;
+
+    /**
+     * @brief Etapa de codificación de entropía.
+     *
+     * Con LZ77_ENTROPIA_HUFFMAN, CodificarBufferCtx recodifica los tokens con códigos de
+     * Huffman canónicos por segmentos (literales y longitudes en un alfabeto, distancias
+     * agrupadas en otro), cada segmento con sus propias tablas. La salida empieza con un
+     * byte que indica si los tokens van recodificados o en el formato sin comprimir (si la
+     * recodificación no reduce el tamaño o bits_caracter > 8), o si se almacena la entrada
+     * tal cual porque los tokens no la reducen (como mucho 1 byte de más sobre datos
+     * incompresibles). Solo la API con contexto y el contenedor por bloques la admiten.
+     *
+     * @range LZ77_ENTROPIA_NINGUNA o LZ77_ENTROPIA_HUFFMAN
+     */
+    int entropia;
+
+    /**
+     * @brief Ajuste automático del formato en el contenedor por bloques.
+     *
+     * Con 1, CodificarBloques elige bits_caracter, umbral, bits_coincidencia y
+     * bits_diccionario para cada bloque con AjustarParametros y los guarda al principio
+     * de sus datos, de modo que el descompresor se configura solo. La API con contexto
+     * no lo usa: basta con llamar a AjustarParametros antes de crear el contexto.
+     *
+     * @range 0 o 1
+     */
+    int autoajuste;
+
+    /**
+     * @brief Aceleración de la búsqueda en zonas sin coincidencias, al estilo de LZ4.
+     *
+     * Con 0 se busca en cada posición. Con n > 0, tras cada búsqueda fallida se emiten
+     * 1 + (fallos_seguidos * n) / 64 literales antes de volver a buscar, así que los
+     * datos incompresibles se recorren cada vez más deprisa; la primera coincidencia
+     * devuelve el paso a 1. No afecta al formato. Se ignora con el análisis óptimo.
+     *
+     * @range 0 a ... (Más alto: más rápido sobre datos poco compresibles y peor ratio)
+     */
+    int aceleracion;
+
+    /**
+     * @brief Codificación de longitudes y distancias en los tokens de coincidencia.
+     *
+     * Con LZ77_CODIGOS_FIJOS la longitud ocupa bits_coincidencia bits y la distancia
+     * bits_diccionario. Con LZ77_CODIGOS_VARIABLES el valor máximo del campo de longitud
+     * es un escape al que siguen grupos de 7 bits (más uno de continuación) con el
+     * exceso, así que una coincidencia llega hasta el tamaño del sector (como mucho
+     * LZ77_MAX_COINCIDENCIA_VARIABLE); la distancia se envía como su número de bits (la
+     * cubeta, en los bits necesarios para escribir bits_diccionario) seguido de los bits
+     * que quedan bajo el más alto, así que las distancias cortas son más baratas.
+     * Las rachas y los registros repetidos pasan a ocupar muy pocos tokens. Forma parte
+     * del formato: hay que decodificar con el mismo valor.
+     *
+     * @range LZ77_CODIGOS_FIJOS o LZ77_CODIGOS_VARIABLES
+     */
+    int codigos;
+
+    /**
+     * @brief Tokens repartidos en carriles para decodificar con más paralelismo.
+     *
+     * Con un solo flujo cada lectura de bits depende de la anterior. Con 1, la salida
+     * de CodificarBufferCtx lleva los campos de los tokens en LZ77_CARRILES flujos de
+     * bits independientes, uno tras otro: el de control (banderas, campos de longitud
+     * y extensiones), el de literales y el de distancias, precedidos del tamaño en
+     * bytes de los dos primeros (4 bytes cada uno). El decodificador avanza un lector
+     * por carril, así que las lecturas de campos distintos ya no se esperan entre sí;
+     * con bits_caracter = 8 el carril de literales son los propios bytes y las rachas
+     * de literales se copian de golpe. Ocupa LZ77_CARRILES_CABECERA bytes más. Forma
+     * parte del formato: hay que decodificar con el mismo valor. Se ignora con etapa
+     * de entropía, en la API clásica y en flujo.
+     *
+     * @range 0 o 1
+     */
+    int carriles;
 } LZ77Params;
 
+/* Etapa de entropía */
+#define LZ77_ENTROPIA_NINGUNA      0
+#define LZ77_ENTROPIA_HUFFMAN      1
+
+/* Codificación de los tokens de coincidencia */
+#define LZ77_CODIGOS_FIJOS         0
+#define LZ77_CODIGOS_VARIABLES     1
+
+/* Tokens en carriles (params.carriles): número de carriles y bytes de sus tamaños */
+#define LZ77_CARRILES              3
+#define LZ77_CARRILES_CABECERA     8
+
+/* Longitud máxima de una coincidencia con LZ77_CODIGOS_VARIABLES */
+#define LZ77_MAX_COINCIDENCIA_VARIABLE (1u << 16)
+
+/* Buscadores de coincidencias */
+#define LZ77_BUSCADOR_CADENA       0
+#define LZ77_BUSCADOR_DOBLE        1
+#define LZ77_BUSCADOR_ARBOL        2
+#define LZ77_BUSCADOR_RAPIDO       3
+
+/* Longitud de la clave de la tabla larga de LZ77_BUSCADOR_DOBLE */
+#define LZ77_CLAVE_LARGA           8
+
+/* Estrategias de análisis */
+#define LZ77_ESTRATEGIA_CODICIA    0  /* Voraz si codicia = 1, perezosa si codicia = 0 */
+#define LZ77_ESTRATEGIA_VORAZ      1
+#define LZ77_ESTRATEGIA_PEREZOSA   2
+#define LZ77_ESTRATEGIA_PEREZOSA2  3
+#define LZ77_ESTRATEGIA_OPTIMA     4
+
+/* Niveles de compresión para AplicarNivel */
+#define LZ77_NIVEL_MIN             1
+#define LZ77_NIVEL_MAX             9
+#define LZ77_NIVEL_POR_DEFECTO     6
+
+/* Tamaño mínimo de los tramos de la compresión con varios hilos (EstablecerHilosCtx) */
+#define LZ77_TRAMO_PARALELO        (1u << 18)
+
+/* Límites de bits_diccionario: el modo clásico usa 0xFFFF como NULO */
+#define LZ77_MAX_BITS_DICCIONARIO_CLASICO 15
+#define LZ77_MAX_BITS_DICCIONARIO         26
+
 /* Valores por defecto para los parámetros */
 static LZ77Params default_params = {
     .codicia = 0,
@@ -103,7 +264,15 @@ static LZ77Params default_params = {
     .bits_coincidencia = 4,
     .bits_diccionario = 13,
     .bits_hash = 10,
-    .bit_sector = 10
+    .bit_sector = 10,
+    .ventana_grande = 0,
+    .estrategia = LZ77_ESTRATEGIA_CODICIA,
+    .buscador = LZ77_BUSCADOR_CADENA,
+    .entropia = LZ77_ENTROPIA_NINGUNA,
+    .autoajuste = 0,
+    .aceleracion = 0,
+    .codigos = LZ77_CODIGOS_FIJOS,
+    .carriles = 0
 };
 
 /**
@@ -116,11 +285,121 @@ typedef struct DerivedParams {
     unsigned int bits_desplazamiento;
     unsigned int tam_sector;
     unsigned int mascara_sector;
+    unsigned int ventana_grande;
 } DerivedParams;
 
 /* Valores por defecto para los parámetros */
 extern LZ77Params default_params;
 
+#ifdef LZ77_ESTADISTICAS
+/* Cubetas de los histogramas: la cubeta i cuenta los valores en [2^(i-1), 2^i) */
+#define LZ77_CUBETAS_HISTOGRAMA 32
+
+/**
+ * @brief Estadísticas de la última llamada a CodificarBufferCtx/DecodificarBufferCtx.
+ *
+ * Solo existen si la biblioteca y el programa se compilan con -DLZ77_ESTADISTICAS;
+ * sin esa macro no queda rastro de ellas en el código. Los flujos acumulan desde su
+ * creación. Los recorridos de búsqueda solo se cuentan en las cadenas hash
+ * (LZ77_BUSCADOR_CADENA y LZ77_BUSCADOR_DOBLE).
+ */
+typedef struct LZ77Estadisticas {
+    /* Tokens escritos o leídos (sin la marca de fin) */
+    unsigned long long literales, coincidencias;
+    unsigned long long histograma_longitudes[LZ77_CUBETAS_HISTOGRAMA];
+    unsigned long long histograma_distancias[LZ77_CUBETAS_HISTOGRAMA];
+
+    /* Búsquedas: candidatos / busquedas es la profundidad media recorrida */
+    unsigned long long busquedas, candidatos, profundidad_maxima;
+    unsigned long long limite_alcanzado;      /* Búsquedas cortadas por max_comparaciones */
+
+    /* Análisis perezoso: posiciones siguientes probadas y veces que ganaron */
+    unsigned long long intentos_perezosos, perezosas_ganadas;
+
+    /* Tiempos en nanosegundos */
+    unsigned long long ns_eliminar, ns_hashear, ns_busqueda, ns_total;
+} LZ77Estadisticas;
+#endif
+
+/**
+ * @brief Contexto de codificación/decodificación.
+ *
+ * Contiene todo el estado que antes vivía en variables globales: las tablas del
+ * diccionario, el buffer de bits y los cursores de entrada/salida. Cada hilo
+ * puede usar su propio contexto sin necesidad de bloqueos.
+ */
+typedef struct LZ77Contexto {
+    LZ77Params params;
+    DerivedParams derived;
+
+    /* Tablas (tam_diccionario + max_coincidencia, tam_hash y tam_diccionario entradas) */
+    unsigned char *diccionario;
+    unsigned int *hash, *siguiente_enlace;
+
+    /* Modo ventana grande: posición absoluta del índice 0 del diccionario en la vuelta
+     * actual y primera posición absoluta que sigue dentro de la ventana */
+    unsigned int base, limite;
+
+    /* Resultado de la última búsqueda de coincidencia */
+    unsigned int longitud_coincidencia, posicion_coincidencia;
+
+    /* Buffer de bits */
+    unsigned int buffer_bits, bits_en;
+
+    /* Buffers en memoria */
+    const unsigned char *in_ptr;
+    unsigned int in_size, in_pos;
+    unsigned char *out_ptr;
+    unsigned int out_capacity, out_pos;
+
+    /* Buscadores alternativos: tabla de la clave larga (doble), hijos del árbol binario
+     * (2 por posición) y estado de los buscadores que insertan a medida que buscan */
+    unsigned int *hash_largo, *hijos;
+    unsigned int cursor;              /* Siguiente posición absoluta por insertar */
+    unsigned int fin_datos;           /* Posición absoluta tras el último byte cargado */
+    unsigned int cache_posicion[4], cache_longitud[4], cache_origen[4];
+
+    /* Espacio de trabajo del análisis óptimo (3 * (tam_sector + 1) entradas) */
+    unsigned int *analisis;
+
+    /* Etapa de entropía y carriles: tokens en un solo flujo de la última llamada */
+    unsigned char *tokens;
+    unsigned int tam_tokens;
+
+    /* Diccionario prefijado (no se copia: debe seguir vivo mientras se use) y, si está
+     * preparado, su estado ya hasheado. inicio_entrada es la posición del diccionario
+     * circular donde la última codificación empezó a cargar la entrada */
+    const unsigned char *prefijo;
+    unsigned int tam_prefijo;
+    const struct LZ77DiccionarioPreparado *preparado;
+    unsigned int inicio_entrada;
+
+    /* Distinto de 0 si las tablas fueron reservadas por CrearContexto */
+    int propietario;
+
+    /* Distinto de 0 tras el primer borrado de las tablas: a partir de entonces cada
+     * reinicio empieza una generación nueva en vez de borrarlas (InicializarCodificacionCtx) */
+    int tablas_iniciadas;
+
+    /* Distinto de 0 si la última llamada se quedó sin buffer de salida o de entrada */
+    int error;
+
+    /* Búsquedas fallidas seguidas (params.aceleracion) */
+    unsigned int fallos;
+
+    /* Compresión con varios hilos (EstablecerHilosCtx): búsquedas desde umbral del
+     * sector actual, pares (longitud, origen) desde la posición primera_precalculada.
+     * Con registrar_precalculadas las que faltan se hacen y se guardan en la tabla */
+    int num_hilos;
+    unsigned int *precalculadas;
+    unsigned int primera_precalculada, num_precalculadas;
+    int registrar_precalculadas;
+
+#ifdef LZ77_ESTADISTICAS
+    LZ77Estadisticas estadisticas;
+#endif
+} LZ77Contexto;
+
 /* Estructuras globales */
 extern unsigned char *diccionario;
 extern unsigned int *hash, *siguiente_enlace;
@@ -134,6 +413,131 @@ extern unsigned int out_capacity, out_pos;
 
 /* Prototipos de funciones */
 DerivedParams calculate_derived_params(const LZ77Params *params);
+
+/* Tamaño máximo de la salida de CodificarBuffer/CodificarBufferCtx para n bytes de entrada
+ * (incluye la marca de fin): con ese espacio la compresión nunca falla */
+unsigned long long CotaCompresion(const LZ77Params *params, unsigned long long n);
+
+/**
+ * @brief Ajusta los parámetros del codificador a un nivel de compresión.
+ *
+ * Solo modifica campos que no afectan al formato (estrategia, codicia,
+ * max_comparaciones, bits_hash y aceleracion), por lo que cualquier nivel se
+ * decodifica con los mismos parámetros. Nivel 1: el más rápido (voraz); nivel 9: la
+ * mejor compresión (análisis óptimo con búsquedas profundas).
+ *
+ * @return 0 si el nivel es válido, -1 en caso contrario.
+ */
+int AplicarNivel(LZ77Params *params, int nivel);
+
+/**
+ * @brief Elige los campos de formato (bits_caracter, umbral, bits_coincidencia y
+ * bits_diccionario) que mejor comprimen datos.
+ *
+ * bits_caracter se ajusta al mayor byte de toda la entrada (7 para texto ASCII); los
+ * demás salen de una muestra del principio, recorrida con un buscador rápido, estimando
+ * el tamaño con cada formato candidato. Entre ventanas de coste parecido se queda la
+ * menor. Reduce bit_sector si no cabe en la nueva ventana. El resultado solo vale para
+ * estos datos: el descompresor necesita los mismos campos.
+ */
+void AjustarParametros(LZ77Params *params, const unsigned char *datos, size_t tam);
+
+/* Gestión de contextos */
+LZ77Contexto *CrearContexto(const LZ77Params *params);
+void ReiniciarContexto(LZ77Contexto *ctx);
+/* Libera un contexto de CrearContexto; con uno de CrearContextoEn no hace nada */
+void DestruirContexto(LZ77Contexto *ctx);
+
+/**
+ * @brief Bytes de memoria que necesita CrearContextoEn para estos parámetros.
+ *
+ * Incluye el propio contexto, las tablas del buscador y, con etapa de entropía o
+ * carriles, el espacio para los tokens de entradas de hasta tam_maximo_entrada bytes
+ * (con entropía las mayores se comprimen sin recodificar; con carriles no se pueden
+ * comprimir). No hay requisitos de alineación.
+ *
+ * @return El tamaño, o 0 si los parámetros no admiten tam_maximo_entrada.
+ */
+size_t TamanoEspacioTrabajo(const LZ77Params *params, unsigned int tam_maximo_entrada);
+
+/**
+ * @brief Crea un contexto dentro de memoria del llamante (arena, pool...), sin reservar nada.
+ *
+ * La memoria debe seguir viva mientras se use el contexto y puede reutilizarse sin
+ * más al terminar; DestruirContexto no la libera.
+ *
+ * @return El contexto (dentro de memoria) o NULL si tam < TamanoEspacioTrabajo(...).
+ */
+LZ77Contexto *CrearContextoEn(const LZ77Params *params, unsigned int tam_maximo_entrada, void *memoria, size_t tam);
+
+/**
+ * @brief Crea un contexto que solo sirve para DecodificarBufferCtx.
+ *
+ * No reserva el diccionario ni las tablas del buscador (ni el espacio del análisis
+ * óptimo o de los tokens): la descompresión escribe directamente en la salida, así
+ * que el contexto ocupa lo mismo sea cual sea el tamaño de la ventana o del hash.
+ * CodificarBufferCtx devuelve -1 con él. Se libera con DestruirContexto.
+ */
+LZ77Contexto *CrearContextoDecodificacion(const LZ77Params *params);
+
+/* Como TamanoEspacioTrabajo/CrearContextoEn, para un contexto solo de descompresión */
+size_t TamanoEspacioDecodificacion(const LZ77Params *params);
+LZ77Contexto *CrearContextoDecodificacionEn(const LZ77Params *params, void *memoria, size_t tam);
+
+/* Versiones reentrantes (todo el estado vive en el contexto) */
+void EnviarBitsCtx(LZ77Contexto *ctx, unsigned int bits, unsigned int num_bits);
+unsigned int LeerBitsCtx(LZ77Contexto *ctx, unsigned int num_bits);
+void EnviarCoincidenciaCtx(LZ77Contexto *ctx, unsigned int longitud, unsigned int distancia);
+void EnviarCaracterCtx(LZ77Contexto *ctx, unsigned int caracter);
+void InicializarCodificacionCtx(LZ77Contexto *ctx);
+unsigned int CargarDiccionarioCtx(LZ77Contexto *ctx, unsigned int posicion);
+void LimpiarTrasDatos(LZ77Contexto *ctx, unsigned int fin);
+void EliminarDatosCtx(LZ77Contexto *ctx, unsigned int posicion);
+void HashearDatosCtx(LZ77Contexto *ctx, unsigned int posicion, unsigned int bytes_a_hashear);
+void EncontrarCoincidenciaCtx(LZ77Contexto *ctx, unsigned int posicion, unsigned int longitud_inicial);
+void BuscarEnDiccionarioCtx(LZ77Contexto *ctx, unsigned int posicion, unsigned int bytes_a_comprimir);
+/*
+ * Devuelven el tamaño de la salida o -1 si no cabe en output_capacity (basta con
+ * CotaCompresion bytes al comprimir) o la entrada está truncada o corrupta. Nunca
+ * terminan el proceso. Cada compresión reinicia las tablas en tiempo constante.
+ */
+int CodificarBufferCtx(LZ77Contexto *ctx, const unsigned char *input, unsigned int input_size, unsigned char *output, unsigned int output_capacity);
+int DecodificarBufferCtx(LZ77Contexto *ctx, const unsigned char *input, unsigned int input_size, unsigned char *output, unsigned int output_capacity);
+
+/**
+ * @brief Fija un diccionario prefijado para las siguientes llamadas a
+ * CodificarBufferCtx/DecodificarBufferCtx del contexto.
+ *
+ * El codificador parte de una ventana que ya contiene el diccionario (hasheado como
+ * si fuera entrada previa) y el decodificador admite coincidencias que apunten a él,
+ * así que ambos extremos deben usar el mismo. Solo se aprovecha el final, hasta
+ * tam_diccionario - tam_sector bytes. Los datos no se copian. NULL o 0 lo quita.
+ */
+void EstablecerDiccionarioCtx(LZ77Contexto *ctx, const unsigned char *datos, unsigned int tam);
+
+/**
+ * @brief Comprime con varios hilos sin partir la entrada en las siguientes llamadas a
+ * CodificarBufferCtx del contexto.
+ *
+ * La entrada se reparte en tramos de al menos LZ77_TRAMO_PARALELO bytes (y cuatro
+ * ventanas). Cada hilo adelanta las búsquedas de un tramo sobre su propia copia de
+ * la ventana que lo precede, reconstruida desde la entrada, y el hilo llamante
+ * recorre los tramos en orden eligiendo los tokens con esas búsquedas y escribiendo
+ * los bits; solo mantiene sus propias cadenas hash en los tramos donde el análisis
+ * del hilo puede separarse del suyo (datos casi incompresibles). La ventana no se
+ * reinicia entre tramos, así que la salida es idéntica byte a byte a la de un solo
+ * hilo y se decodifica igual. Solo se aplica con LZ77_BUSCADOR_CADENA, sin
+ * diccionario prefijado y a entradas de al menos dos tramos; si no, se comprime con
+ * un hilo. num_hilos <= 0 es uno por núcleo y 1 desactiva el modo, que está
+ * desactivado al crear el contexto.
+ */
+void EstablecerHilosCtx(LZ77Contexto *ctx, int num_hilos);
+#ifdef LZ77_ESTADISTICAS
+const LZ77Estadisticas *EstadisticasCtx(const LZ77Contexto *ctx);
+void ReiniciarEstadisticasCtx(LZ77Contexto *ctx);
+#endif
+
+/* API clásica: opera sobre las estructuras globales (no reentrante) */
 void EnviarBits(unsigned int bits, unsigned int num_bits);
 unsigned int LeerBits(unsigned int num_bits);
 void EnviarCoincidencia(const LZ77Params *params, const DerivedParams *derived, unsigned int longitud, unsigned int distancia);
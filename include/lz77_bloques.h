@@ -0,0 +1,146 @@
+// lz77_bloques.h
+#ifndef LZ77_BLOQUES_H
+#define LZ77_BLOQUES_H
+
+#include "lz77.h"
+
+/*
+ * Contenedor por bloques.
+ *
+ * La entrada se divide en bloques de tam_bloque bytes que se comprimen de forma
+ * independiente (cada uno empieza con el diccionario vacío), lo que permite
+ * comprimirlos y descomprimirlos en paralelo.
+ *
+ * Formato (enteros en little-endian):
+ *   Cabecera (LZ77_BLOQUES_CABECERA bytes):
+ *     "LZ7B"             4 bytes
+ *     version            1 byte
+ *     flags              1 byte  (LZ77_BLOQUES_*; el resto reservado, 0)
+ *     bits_caracter      1 byte
+ *     umbral             1 byte
+ *     bits_coincidencia  1 byte
+ *     bits_diccionario   1 byte
+ *     reservado          2 bytes
+ *     tam_bloque         4 bytes
+ *     tam_original       8 bytes
+ *     num_bloques        4 bytes
+ *   Por cada bloque (LZ77_BLOQUES_CABECERA_BLOQUE bytes + datos):
+ *     tam_comprimido     4 bytes
+ *     tam_original       4 bytes
+ *     datos              tam_comprimido bytes (flujo de CodificarBuffer)
+ *
+ *   Con LZ77_BLOQUES_INDICE, tras el último bloque:
+ *     desplazamiento     8 bytes por bloque (inicio de su cabecera de bloque)
+ *   y el pie (LZ77_BLOQUES_PIE bytes):
+ *     inicio_indice      8 bytes
+ *     num_bloques        4 bytes
+ *     "LZ7I"             4 bytes
+ *
+ * Con LZ77_BLOQUES_ENTROPIA cada bloque es la salida de CodificarBufferCtx con
+ * params.entropia = LZ77_ENTROPIA_HUFFMAN (byte de modo y tablas propias).
+ *
+ * Con LZ77_BLOQUES_AUTOAJUSTE (params.autoajuste) los datos de cada bloque empiezan
+ * con su propio formato, elegido por AjustarParametros, y los campos de la cabecera
+ * del contenedor no se usan al descomprimir:
+ *     bits_caracter, umbral, bits_coincidencia, bits_diccionario   1 byte cada uno
+ *
+ * Con LZ77_BLOQUES_ALMACENADOS los bloques con tam_comprimido == tam_original son
+ * los datos originales sin más (ni byte de modo ni formato). Se almacena un bloque
+ * cuando el muestreo lo da por incompresible o cuando comprimido no sería menor, así
+ * que sobre datos incompresibles el contenedor solo añade la cabecera, 8 bytes por
+ * bloque y el índice. El flag solo se pone si hay algún bloque almacenado.
+ *
+ * Con LZ77_BLOQUES_VARIABLES todos los bloques usan params.codigos =
+ * LZ77_CODIGOS_VARIABLES. Al descomprimir bit_sector = bits_diccionario, así que la
+ * longitud máxima admitida nunca es menor que la del codificador.
+ *
+ * Con LZ77_BLOQUES_CARRILES todos los bloques usan params.carriles = 1 (tokens en
+ * carriles; no se combina con LZ77_BLOQUES_ENTROPIA, que lo anula).
+ *
+ * El índice permite descomprimir un rango sin leer más que la cabecera, el pie, las
+ * entradas del índice y los bloques que lo cubren (DecodificarRangoBloques), por
+ * ejemplo sobre un archivo proyectado en memoria. El bloque i empieza siempre en la
+ * posición i * tam_bloque de los datos originales, así que no hace falta guardarla.
+ */
+
+#define LZ77_BLOQUES_MAGIA             "LZ7B"
+#define LZ77_BLOQUES_VERSION           1
+#define LZ77_BLOQUES_CABECERA          28
+#define LZ77_BLOQUES_CABECERA_BLOQUE   8
+
+/* Flags de la cabecera */
+#define LZ77_BLOQUES_ENTROPIA          0x01
+#define LZ77_BLOQUES_INDICE            0x02
+#define LZ77_BLOQUES_AUTOAJUSTE        0x04
+#define LZ77_BLOQUES_ALMACENADOS       0x08
+#define LZ77_BLOQUES_VARIABLES         0x10
+#define LZ77_BLOQUES_CARRILES          0x20
+
+/* Bytes del formato de cada bloque con LZ77_BLOQUES_AUTOAJUSTE */
+#define LZ77_BLOQUES_FORMATO           4
+
+#define LZ77_BLOQUES_MAGIA_INDICE      "LZ7I"
+#define LZ77_BLOQUES_PIE               16
+
+#define LZ77_BLOQUE_MINIMO             (1u << 12)
+#define LZ77_BLOQUE_MAXIMO             (1u << 30)
+#define LZ77_BLOQUE_POR_DEFECTO        (1u << 20)
+
+/**
+ * @brief Tamaño máximo que puede ocupar la salida de CodificarBloques.
+ *
+ * El buffer de salida de CodificarBloques y CodificarBloquesIndexados debe tener al
+ * menos este tamaño: cada bloque se comprime directamente en su hueco de la salida
+ * y después se compactan.
+ */
+size_t CotaBloques(const LZ77Params *params, size_t input_size, unsigned int tam_bloque);
+
+/**
+ * @brief Comprime input en bloques independientes usando num_hilos hilos.
+ *
+ * @param tam_bloque Tamaño de bloque sin comprimir (0 = LZ77_BLOQUE_POR_DEFECTO).
+ * @param num_hilos  Número de hilos (<= 0 = uno por núcleo). Con menos bloques que
+ *                   hilos, los que sobran se reparten dentro de cada bloque
+ *                   (EstablecerHilosCtx), sin cambiar la salida.
+ * @return Tamaño de la salida o -1 en caso de error.
+ */
+long long CodificarBloques(const LZ77Params *params, const unsigned char *input, size_t input_size,
+                           unsigned char *output, size_t output_capacity, unsigned int tam_bloque, int num_hilos);
+
+/**
+ * @brief Como CodificarBloques, pero añade el índice de bloques (LZ77_BLOQUES_INDICE)
+ * para poder descomprimir rangos con DecodificarRangoBloques.
+ */
+long long CodificarBloquesIndexados(const LZ77Params *params, const unsigned char *input, size_t input_size,
+                                    unsigned char *output, size_t output_capacity, unsigned int tam_bloque, int num_hilos);
+
+/**
+ * @brief Tamaño original de un contenedor por bloques, leído de su cabecera.
+ *
+ * @return Tamaño descomprimido o -1 si la cabecera no es válida.
+ */
+long long TamanoOriginalBloques(const unsigned char *input, size_t input_size);
+
+/**
+ * @brief Descomprime un contenedor por bloques; cada hilo escribe sus bloques
+ * directamente en su porción del buffer de salida.
+ *
+ * @return Tamaño descomprimido o -1 en caso de error.
+ */
+long long DecodificarBloques(const unsigned char *input, size_t input_size,
+                             unsigned char *output, size_t output_capacity, int num_hilos);
+
+/**
+ * @brief Descomprime solo los bytes [desplazamiento, desplazamiento + longitud) de los
+ * datos originales, decodificando únicamente los bloques que los cubren.
+ *
+ * Con índice, input_size debe ser el tamaño exacto del contenedor (el pie está al
+ * final); sin él, o si el pie no está, se recorren las cabeceras de bloque hasta el
+ * último bloque necesario. El rango se recorta al final de los datos.
+ *
+ * @return Bytes escritos en output o -1 en caso de error.
+ */
+long long DecodificarRangoBloques(const unsigned char *input, size_t input_size, unsigned long long desplazamiento,
+                                  size_t longitud, unsigned char *output, size_t output_capacity, int num_hilos);
+
+#endif
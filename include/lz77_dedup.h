@@ -0,0 +1,81 @@
+// lz77_dedup.h
+#ifndef LZ77_DEDUP_H
+#define LZ77_DEDUP_H
+
+#include "lz77_bloques.h"
+
+/*
+ * Contenedor con deduplicación previa de repeticiones lejanas.
+ *
+ * La ventana de CodificarBuffer no pasa de tam_diccionario bytes, así que una
+ * repetición a megabytes de distancia (archivos duplicados en un tar, copias de
+ * seguridad sucesivas) no se encuentra. Esta etapa recorre antes toda la entrada con
+ * un hash rodante (gear) sobre los últimos LZ77_DEDUP_VENTANA_HASH bytes y toma como
+ * anclas las posiciones en las que sus LZ77_DEDUP_BITS_SEPARACION bits altos son
+ * cero. Las anclas dependen solo del contenido, así que dos copias de un segmento
+ * tienen las mismas en las mismas posiciones relativas: cada ancla se busca en una
+ * tabla de 1 << LZ77_DEDUP_BITS_ANCLAS posiciones (la más reciente por hueco, con
+ * memoria fija sea cual sea la entrada) y, si los bytes coinciden, la coincidencia
+ * se extiende hacia atrás y hacia delante. Las de al menos LZ77_DEDUP_MINIMO bytes
+ * se guardan como referencias y el resto de la entrada (el residuo) se comprime con
+ * CodificarBloques.
+ *
+ * Formato (enteros en little-endian):
+ *   Cabecera (LZ77_DEDUP_CABECERA bytes):
+ *     "LZ7D"             4 bytes
+ *     version            1 byte
+ *     reservado          3 bytes
+ *     tam_original       8 bytes
+ *     tam_referencias    8 bytes
+ *   Referencias (tam_referencias bytes), cada una con tres enteros de 7 bits por
+ *   byte (el octavo a 1 si sigue otro byte, empezando por los menos significativos):
+ *     literales          bytes del residuo que van antes de la referencia
+ *     distancia          hacia atrás desde el inicio de la referencia (>= 1)
+ *     longitud           bytes copiados (puede solaparse consigo misma)
+ *   Residuo: contenedor por bloques (lz77_bloques.h) con tam_original menos la suma
+ *   de las longitudes; sus últimos bytes siguen a la última referencia.
+ *
+ * Al descomprimir el residuo se decodifica al final de la salida y se va moviendo a
+ * su sitio delante de cada referencia, sin memoria adicional.
+ */
+
+#define LZ77_DEDUP_MAGIA               "LZ7D"
+#define LZ77_DEDUP_VERSION             1
+#define LZ77_DEDUP_CABECERA            24
+
+#define LZ77_DEDUP_VENTANA_HASH        64       /* Bytes que cubre el hash rodante */
+#define LZ77_DEDUP_BITS_SEPARACION     8        /* Un ancla cada 256 bytes de media */
+#define LZ77_DEDUP_BITS_ANCLAS         20       /* Tabla de anclas: 8 MiB */
+#define LZ77_DEDUP_MINIMO              128      /* Longitud mínima de una referencia */
+
+/**
+ * @brief Tamaño máximo que puede ocupar la salida de CodificarDedup.
+ */
+size_t CotaDedup(const LZ77Params *params, size_t input_size, unsigned int tam_bloque);
+
+/**
+ * @brief Busca repeticiones lejanas en toda la entrada y comprime el resto con
+ * CodificarBloques (tam_bloque y num_hilos como en ella).
+ *
+ * @return Tamaño de la salida o -1 en caso de error.
+ */
+long long CodificarDedup(const LZ77Params *params, const unsigned char *input, size_t input_size,
+                         unsigned char *output, size_t output_capacity, unsigned int tam_bloque, int num_hilos);
+
+/**
+ * @brief Tamaño original de un contenedor con deduplicación, leído de su cabecera.
+ *
+ * @return Tamaño descomprimido o -1 si la cabecera no es válida.
+ */
+long long TamanoOriginalDedup(const unsigned char *input, size_t input_size);
+
+/**
+ * @brief Descomprime un contenedor con deduplicación; el residuo se descomprime con
+ * DecodificarBloques usando num_hilos hilos.
+ *
+ * @return Tamaño descomprimido o -1 en caso de error.
+ */
+long long DecodificarDedup(const unsigned char *input, size_t input_size,
+                           unsigned char *output, size_t output_capacity, int num_hilos);
+
+#endif
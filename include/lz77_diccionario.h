@@ -0,0 +1,68 @@
+// lz77_diccionario.h
+#ifndef LZ77_DICCIONARIO_H
+#define LZ77_DICCIONARIO_H
+
+#include "lz77.h"
+
+/*
+ * Diccionarios prefijados para mensajes pequeños.
+ *
+ * Un diccionario es contenido típico de los mensajes que el codificador encuentra
+ * ya en la ventana, de modo que incluso el primer byte de un mensaje corto puede
+ * codificarse como coincidencia. EstablecerDiccionarioCtx (lz77.h) basta para usar
+ * uno, pero vuelve a hashearlo en cada mensaje; un diccionario preparado guarda la
+ * ventana y las tablas ya construidas y cada mensaje solo las copia.
+ *
+ * El flujo comprimido no identifica el diccionario: compresor y descompresor deben
+ * acordarlo por su cuenta.
+ */
+
+typedef struct LZ77DiccionarioPreparado {
+    LZ77Params params;
+    unsigned char *datos;             /* Parte aprovechada del diccionario (tam bytes) */
+    unsigned int tam;
+    unsigned int inicio;              /* Posición del diccionario circular donde empieza la entrada */
+    /* Estado tras hashear el diccionario (solo con LZ77_BUSCADOR_CADENA; NULL en otro caso) */
+    unsigned char *ventana;           /* inicio bytes */
+    unsigned int *hash;               /* tam_hash entradas */
+    unsigned int *enlace;             /* inicio entradas */
+} LZ77DiccionarioPreparado;
+
+/* Bytes de las claves que cuenta el entrenador y tamaño de los fragmentos que elige */
+#define LZ77_ENTRENAR_CLAVE       6
+#define LZ77_ENTRENAR_FRAGMENTO   64
+
+/**
+ * @brief Prepara un diccionario para los parámetros dados.
+ *
+ * Los datos se copian. Sirve para contextos creados con los mismos bits_diccionario,
+ * bits_hash, umbral, bit_sector y buscador; los demás parámetros (nivel, estrategia,
+ * entropía) pueden variar.
+ *
+ * @return El diccionario o NULL si no hay memoria.
+ */
+LZ77DiccionarioPreparado *PrepararDiccionario(const LZ77Params *params, const unsigned char *datos, unsigned int tam);
+void LiberarDiccionarioPreparado(LZ77DiccionarioPreparado *diccionario);
+
+/**
+ * @brief Usa un diccionario preparado en las siguientes llamadas del contexto
+ * (codificación y decodificación). NULL lo quita.
+ *
+ * @return 0, o -1 si fue preparado con parámetros incompatibles con el contexto.
+ */
+int UsarDiccionarioPreparadoCtx(LZ77Contexto *ctx, const LZ77DiccionarioPreparado *diccionario);
+
+/**
+ * @brief Construye un diccionario a partir de mensajes de ejemplo.
+ *
+ * Las muestras van concatenadas en muestras y tamanos[i] es la longitud de la i-ésima.
+ * Se eligen fragmentos de LZ77_ENTRENAR_FRAGMENTO bytes cuyas claves de
+ * LZ77_ENTRENAR_CLAVE bytes aparecen en más muestras; los más útiles quedan al final,
+ * más cerca de los mensajes.
+ *
+ * @return Tamaño del diccionario escrito (<= capacidad) o -1 en caso de error.
+ */
+long long EntrenarDiccionario(const unsigned char *muestras, const size_t *tamanos, unsigned int num_muestras,
+                              unsigned char *diccionario, unsigned int capacidad);
+
+#endif
@@ -0,0 +1,86 @@
+// lz77_flujo.h
+#ifndef LZ77_FLUJO_H
+#define LZ77_FLUJO_H
+
+#include "lz77.h"
+
+/*
+ * Interfaz de flujo (push/pull) al estilo de zlib.
+ *
+ * El llamante rellena entrada/disponible_entrada y salida/disponible_salida y llama
+ * a CodificarFlujo o DecodificarFlujo tantas veces como haga falta; ambas avanzan
+ * los punteros y descuentan lo consumido/producido. La memoria usada es fija: la
+ * ventana deslizante del contexto más un buffer de un sector, sin importar el
+ * tamaño total de los datos.
+ *
+ * Sin vaciados intermedios, el flujo producido es idéntico al de CodificarBuffer.
+ */
+
+/* Modos de CodificarFlujo/DecodificarFlujo */
+#define LZ77_FLUJO_CONTINUAR  0  /* Procesar solo lo que se pueda sin esperar más entrada */
+#define LZ77_FLUJO_VACIAR     1  /* Codificar toda la entrada recibida y entregar los bytes completos */
+#define LZ77_FLUJO_FINALIZAR  2  /* No habrá más entrada: escribir la marca de fin */
+
+/* Valores de retorno */
+#define LZ77_FLUJO_OK         0  /* Se necesita más entrada o más espacio de salida */
+#define LZ77_FLUJO_FIN        1  /* Flujo terminado (marca de fin escrita o leída) */
+#define LZ77_FLUJO_ERROR     -1
+
+typedef struct LZ77Flujo {
+    /* Campos públicos */
+    const unsigned char *entrada;
+    size_t disponible_entrada;
+    unsigned long long total_entrada;
+    unsigned char *salida;
+    size_t disponible_salida;
+    unsigned long long total_salida;
+
+    /* Estado interno */
+    LZ77Contexto *ctx;
+    int codificando;
+    int terminado;
+
+    /* Codificación: sector actual de la ventana */
+    unsigned int posicion_sector;     /* Inicio del sector en el diccionario */
+    unsigned int cargados;            /* Bytes del sector ya copiados al diccionario */
+    unsigned int hasheados;           /* Bytes del sector desde los que aún no se ha hasheado */
+    unsigned int procesados;          /* Bytes del sector ya codificados */
+    int marcar_para_eliminar;
+    unsigned char *pendiente;         /* Bytes codificados aún no entregados */
+    unsigned int tam_pendiente, inicio_pendiente;
+
+    /* Decodificación */
+    unsigned long long bits;
+    unsigned int num_bits;
+    unsigned int posicion;            /* Posición en el diccionario circular */
+    unsigned int copia_restante, copia_desde;
+    unsigned int longitud_pendiente;  /* Códigos variables: longitud leída, falta la distancia */
+} LZ77Flujo;
+
+/* Devuelven NULL si no hay memoria o si params->entropia != LZ77_ENTROPIA_NINGUNA */
+LZ77Flujo *CrearFlujoCodificacion(const LZ77Params *params);
+LZ77Flujo *CrearFlujoDecodificacion(const LZ77Params *params);
+void DestruirFlujo(LZ77Flujo *flujo);
+
+/**
+ * @brief Codifica la entrada disponible.
+ *
+ * Con LZ77_FLUJO_VACIAR se codifica todo lo recibido y se entregan todos los bytes
+ * completos; los bits de un último byte incompleto se entregan con la siguiente
+ * llamada que los complete o con LZ77_FLUJO_FINALIZAR.
+ *
+ * @return LZ77_FLUJO_OK, LZ77_FLUJO_FIN cuando se ha entregado la marca de fin o LZ77_FLUJO_ERROR.
+ */
+int CodificarFlujo(LZ77Flujo *flujo, int modo);
+
+/**
+ * @brief Decodifica la entrada disponible.
+ *
+ * Con LZ77_FLUJO_FINALIZAR el llamante indica que no llegará más entrada: si el
+ * flujo está truncado se devuelve LZ77_FLUJO_ERROR en lugar de esperar.
+ *
+ * @return LZ77_FLUJO_OK, LZ77_FLUJO_FIN al leer la marca de fin o LZ77_FLUJO_ERROR.
+ */
+int DecodificarFlujo(LZ77Flujo *flujo, int modo);
+
+#endif
@@ -0,0 +1,48 @@
+// lz77_hilos.h
+#ifndef LZ77_HILOS_H
+#define LZ77_HILOS_H
+
+/**
+ * @brief Función ejecutada por cada tarea del pool.
+ *
+ * @param datos Puntero opaco compartido por todas las tareas.
+ * @param hilo  Índice del hilo que ejecuta la tarea (0 .. num_hilos - 1), útil para
+ *              acceder a recursos propios del hilo (por ejemplo, un LZ77Contexto).
+ * @param tarea Índice de la tarea (0 .. num_tareas - 1).
+ * @return 0 si la tarea terminó correctamente, distinto de 0 en caso de error.
+ */
+typedef int (*LZ77Tarea)(void *datos, unsigned int hilo, unsigned int tarea);
+
+/* Número de núcleos disponibles (al menos 1) */
+int LZ77NumeroNucleos(void);
+
+/* Ajusta num_hilos: <= 0 significa un hilo por núcleo, y nunca más hilos que tareas */
+int LZ77HilosEfectivos(int num_hilos, unsigned int num_tareas);
+
+/**
+ * @brief Ejecuta num_tareas tareas repartidas entre num_hilos hilos.
+ *
+ * Los hilos toman la siguiente tarea pendiente de un contador compartido, por lo
+ * que bloques de coste desigual se reparten solos. Si no se puede crear un hilo,
+ * sus tareas las ejecutan los demás (incluido el hilo llamante).
+ *
+ * @return 0 si todas las tareas terminaron correctamente, -1 en caso contrario.
+ */
+int LZ77EjecutarParalelo(int num_hilos, unsigned int num_tareas, LZ77Tarea funcion, void *datos);
+
+/**
+ * @brief Ejecuta num_tareas tareas en dos etapas: producir, en cualquier hilo, y
+ * consumir, en el hilo llamante y en orden en cuanto cada tarea está producida.
+ *
+ * Como mucho en_vuelo tareas pueden estar producidas o produciéndose sin haberse
+ * consumido, así que la tarea t puede usar el hueco t % en_vuelo de un buffer
+ * circular. Mientras espera, el hilo llamante produce él mismo la siguiente tarea
+ * pendiente: sin hilos adicionales todo se ejecuta en él. producir recibe el hilo
+ * 0 .. num_hilos - 1 (0 es el llamante) y consumir siempre el 0.
+ *
+ * @return 0 si todas las tareas terminaron correctamente, -1 en caso contrario.
+ */
+int LZ77EjecutarEnOrden(int num_hilos, unsigned int num_tareas, unsigned int en_vuelo,
+                        LZ77Tarea producir, LZ77Tarea consumir, void *datos);
+
+#endif
@@ -7,19 +7,60 @@
 #ifndef LZ77_C
 #define LZ77_C
 #include "lz77.h"
+#include "lz77_interno.h"
 
 
 DerivedParams calculate_derived_params(const LZ77Params *params) {
     DerivedParams derived;
     derived.max_coincidencia = (1 << params->bits_coincidencia) + params->umbral - 1;
+    if (params->codigos == LZ77_CODIGOS_VARIABLES) {
+        /* Una coincidencia no pasa del final del sector en que empieza */
+        unsigned int max = 1u << params->bit_sector;
+        if (max > LZ77_MAX_COINCIDENCIA_VARIABLE)
+            max = LZ77_MAX_COINCIDENCIA_VARIABLE;
+        if (max > derived.max_coincidencia)
+            derived.max_coincidencia = max;
+    }
     derived.tam_diccionario = (1 << params->bits_diccionario);
     derived.tam_hash = (1 << params->bits_hash);
     derived.bits_desplazamiento = (params->bits_hash + params->umbral) / (params->umbral + 1);
     derived.tam_sector = (1 << params->bit_sector);
     derived.mascara_sector = ((0xFFFF << params->bit_sector) & 0xFFFF);
+    derived.ventana_grande = params->ventana_grande || params->bits_diccionario > LZ77_MAX_BITS_DICCIONARIO_CLASICO ||
+                             params->buscador != LZ77_BUSCADOR_CADENA;
     return derived;
 }
 
+/* Tokens en carriles: solo sin etapa de entropía */
+static inline int UsaCarriles(const LZ77Params *params) {
+    return params->carriles && params->entropia == LZ77_ENTROPIA_NINGUNA;
+}
+
+/* Peor caso de CodificarBuffer para n bytes: todo literales o todo coincidencias mínimas
+ * (más el byte de modo si hay etapa de entropía, o los tamaños y el relleno de los
+ * carriles) */
+unsigned long long CotaCompresion(const LZ77Params *params, unsigned long long n) {
+    unsigned long long bits_literal = 1 + params->bits_caracter;
+    unsigned long long bits_coincidencia = 1 + params->bits_coincidencia + params->bits_diccionario;
+    unsigned long long a = n * bits_literal;
+    unsigned long long b = ((n + params->umbral) / (params->umbral + 1)) * bits_coincidencia;
+    if (params->codigos == LZ77_CODIGOS_VARIABLES) {
+        /* Cubeta y bits bajo el más alto en lugar de la distancia; con g grupos de
+         * extensión la coincidencia cubre al menos LongitudEscape + 128^(g - 1) - 1 bytes */
+        unsigned long long escape = LongitudEscape(params), minima = escape, c;
+        unsigned int g;
+        bits_coincidencia = params->bits_coincidencia + BitsCubeta(params->bits_diccionario) + params->bits_diccionario;
+        b = ((n + params->umbral) / (params->umbral + 1)) * bits_coincidencia;
+        for (g = 1; g <= LZ77_GRUPOS_EXTENSION; minima = escape + (1ULL << (7 * g)) - 1, g++) {
+            c = ((n + minima - 1) / minima) * (bits_coincidencia + 8 * g);
+            if (c > b)
+                b = c;
+        }
+    }
+    return ((a > b ? a : b) + bits_coincidencia + 7) / 8 + 1 + (params->entropia != LZ77_ENTROPIA_NINGUNA) +
+           (UsaCarriles(params) ? LZ77_CARRILES_CABECERA + LZ77_CARRILES - 1 : 0);
+}
+
 /* Estructuras globales */
 unsigned char *diccionario;
 unsigned int *hash, *siguiente_enlace;
@@ -32,286 +73,1944 @@ unsigned int in_size, in_pos;
 unsigned char *out_ptr;
 unsigned int out_capacity, out_pos;
 
+/* Estado del modo ventana grande para la API clásica */
+static unsigned int base_ventana, limite_ventana;
+
+/* Las posiciones absolutas se rebasan antes de acercarse al desbordamiento de 32 bits */
+#define LZ77_LIMITE_REBASE 0xC0000000u
+
+/* Estrategia de análisis efectiva: LZ77_ESTRATEGIA_CODICIA se traduce según codicia */
+static inline int EstrategiaEfectiva(const LZ77Params *params) {
+    if (params->estrategia == LZ77_ESTRATEGIA_CODICIA)
+        return params->codicia ? LZ77_ESTRATEGIA_VORAZ : LZ77_ESTRATEGIA_PEREZOSA;
+    return params->estrategia;
+}
+
+/* Niveles de compresión: estrategia, comparaciones por posición, bits de la tabla hash y aceleración */
+static const struct {
+    int estrategia, max_comparaciones, bits_hash, aceleracion;
+} niveles[LZ77_NIVEL_MAX + 1] = {
+    {0, 0, 0, 0},
+    {LZ77_ESTRATEGIA_VORAZ,     2,    12, 2},
+    {LZ77_ESTRATEGIA_VORAZ,     8,    12, 1},
+    {LZ77_ESTRATEGIA_VORAZ,     24,   12, 1},
+    {LZ77_ESTRATEGIA_PEREZOSA,  16,   12, 1},
+    {LZ77_ESTRATEGIA_PEREZOSA,  40,   12, 1},
+    {LZ77_ESTRATEGIA_PEREZOSA,  75,   12, 1},
+    {LZ77_ESTRATEGIA_PEREZOSA2, 128,  14, 0},
+    {LZ77_ESTRATEGIA_OPTIMA,    256,  14, 0},
+    {LZ77_ESTRATEGIA_OPTIMA,    1024, 15, 0},
+};
+
+int AplicarNivel(LZ77Params *params, int nivel) {
+    if (nivel < LZ77_NIVEL_MIN || nivel > LZ77_NIVEL_MAX)
+        return -1;
+    params->estrategia = niveles[nivel].estrategia;
+    params->codicia = niveles[nivel].estrategia == LZ77_ESTRATEGIA_VORAZ;
+    params->max_comparaciones = niveles[nivel].max_comparaciones;
+    params->bits_hash = niveles[nivel].bits_hash;
+    params->aceleracion = niveles[nivel].aceleracion;
+    return 0;
+}
+
+/* Gestión de contextos */
+LZ77Contexto *CrearContexto(const LZ77Params *params) {
+    LZ77Contexto *ctx = (LZ77Contexto *)calloc(1, sizeof(LZ77Contexto));
+    if (!ctx)
+        return NULL;
+    ctx->params = *params;
+    ctx->derived = calculate_derived_params(params);
+    /* Posiciones absolutas siempre: misma salida y el reinicio no recorre las tablas */
+    ctx->derived.ventana_grande = 1;
+    ctx->diccionario = (unsigned char *)malloc(ctx->derived.tam_diccionario + ctx->derived.max_coincidencia + LZ77_RELLENO_DICCIONARIO);
+    ctx->hash = (unsigned int *)malloc(ctx->derived.tam_hash * sizeof(unsigned int));
+    /* El árbol y la tabla de una sola sonda no usan cadenas */
+    if (params->buscador == LZ77_BUSCADOR_CADENA || params->buscador == LZ77_BUSCADOR_DOBLE)
+        ctx->siguiente_enlace = (unsigned int *)malloc(ctx->derived.tam_diccionario * sizeof(unsigned int));
+    if (EstrategiaEfectiva(params) == LZ77_ESTRATEGIA_OPTIMA)
+        ctx->analisis = (unsigned int *)malloc(3 * (ctx->derived.tam_sector + 1) * sizeof(unsigned int));
+    ctx->propietario = 1;
+    if (!ctx->diccionario || !ctx->hash || ReservarBuscador(ctx) != 0 ||
+        (!ctx->siguiente_enlace && (params->buscador == LZ77_BUSCADOR_CADENA || params->buscador == LZ77_BUSCADOR_DOBLE))) {
+        DestruirContexto(ctx);
+        return NULL;
+    }
+    ReiniciarContexto(ctx);
+    return ctx;
+}
+
+/* Bloques del espacio de trabajo de un contexto en bytes (0 si no se usan) */
+typedef struct TamanosContexto {
+    size_t diccionario, hash, enlace, hash_largo, hijos, analisis, tokens;
+} TamanosContexto;
+
+#define LZ77_ALINEACION 64
+static inline size_t Alinear(size_t n) {
+    return (n + LZ77_ALINEACION - 1) & ~(size_t)(LZ77_ALINEACION - 1);
+}
+
+/* Los mismos tamaños que reservan CrearContexto y ReservarBuscador */
+static TamanosContexto CalcularTamanos(const LZ77Params *params, unsigned int tam_maximo_entrada) {
+    DerivedParams derived = calculate_derived_params(params);
+    TamanosContexto t;
+    memset(&t, 0, sizeof(t));
+    t.diccionario = derived.tam_diccionario + derived.max_coincidencia + LZ77_RELLENO_DICCIONARIO;
+    t.hash = derived.tam_hash * sizeof(unsigned int);
+    if (params->buscador == LZ77_BUSCADOR_CADENA || params->buscador == LZ77_BUSCADOR_DOBLE)
+        t.enlace = derived.tam_diccionario * sizeof(unsigned int);
+    if (params->buscador == LZ77_BUSCADOR_DOBLE)
+        t.hash_largo = derived.tam_hash * sizeof(unsigned int);
+    if (params->buscador == LZ77_BUSCADOR_ARBOL)
+        t.hijos = 2 * (size_t)derived.tam_diccionario * sizeof(unsigned int);
+    if (EstrategiaEfectiva(params) == LZ77_ESTRATEGIA_OPTIMA)
+        t.analisis = 3 * (derived.tam_sector + 1) * sizeof(unsigned int);
+    if ((params->entropia != LZ77_ENTROPIA_NINGUNA || UsaCarriles(params)) && tam_maximo_entrada)
+        t.tokens = CotaCompresion(params, tam_maximo_entrada) + LZ77_MARGEN_TOKENS;
+    return t;
+}
+
+/* Hueco inicial para alinear una memoria cualquiera, el contexto y sus bloques */
+static size_t TamanoTotal(const TamanosContexto *t) {
+    if (t->tokens > 0xFFFFFFFFu)
+        return 0;
+    return LZ77_ALINEACION - 1 + Alinear(sizeof(LZ77Contexto)) + Alinear(t->diccionario) + Alinear(t->hash) +
+           Alinear(t->enlace) + Alinear(t->hash_largo) + Alinear(t->hijos) + Alinear(t->analisis) + Alinear(t->tokens);
+}
+
+/* Reparte memoria entre el contexto y los bloques de t (los de tamaño 0 quedan a NULL) */
+static LZ77Contexto *RepartirContexto(const LZ77Params *params, const TamanosContexto *t, void *memoria, size_t tam) {
+    size_t necesario = TamanoTotal(t);
+    LZ77Contexto *ctx;
+    unsigned char *p;
+
+    if (!memoria || necesario == 0 || tam < necesario)
+        return NULL;
+    p = (unsigned char *)memoria + (Alinear((size_t)memoria) - (size_t)memoria);
+    ctx = (LZ77Contexto *)p;
+    memset(ctx, 0, sizeof(LZ77Contexto));
+    p += Alinear(sizeof(LZ77Contexto));
+    ctx->params = *params;
+    ctx->derived = calculate_derived_params(params);
+    ctx->derived.ventana_grande = 1;
+
+#define LZ77_REPARTIR(campo, tipo, bytes) \
+    do { ctx->campo = (bytes) ? (tipo *)p : NULL; p += Alinear(bytes); } while (0)
+    LZ77_REPARTIR(diccionario, unsigned char, t->diccionario);
+    LZ77_REPARTIR(hash, unsigned int, t->hash);
+    LZ77_REPARTIR(siguiente_enlace, unsigned int, t->enlace);
+    LZ77_REPARTIR(hash_largo, unsigned int, t->hash_largo);
+    LZ77_REPARTIR(hijos, unsigned int, t->hijos);
+    LZ77_REPARTIR(analisis, unsigned int, t->analisis);
+    LZ77_REPARTIR(tokens, unsigned char, t->tokens);
+#undef LZ77_REPARTIR
+    ctx->tam_tokens = (unsigned int)t->tokens;
+    ReiniciarContexto(ctx);
+    return ctx;
+}
+
+size_t TamanoEspacioTrabajo(const LZ77Params *params, unsigned int tam_maximo_entrada) {
+    TamanosContexto t = CalcularTamanos(params, tam_maximo_entrada);
+    return TamanoTotal(&t);
+}
+
+LZ77Contexto *CrearContextoEn(const LZ77Params *params, unsigned int tam_maximo_entrada, void *memoria, size_t tam) {
+    TamanosContexto t = CalcularTamanos(params, tam_maximo_entrada);
+    return RepartirContexto(params, &t, memoria, tam);
+}
+
+/* DecodificarBufferCtx escribe directamente en la salida: no usa ninguna tabla */
+LZ77Contexto *CrearContextoDecodificacion(const LZ77Params *params) {
+    LZ77Contexto *ctx = (LZ77Contexto *)calloc(1, sizeof(LZ77Contexto));
+    if (!ctx)
+        return NULL;
+    ctx->params = *params;
+    ctx->derived = calculate_derived_params(params);
+    ctx->derived.ventana_grande = 1;
+    ctx->propietario = 1;
+    ReiniciarContexto(ctx);
+    return ctx;
+}
+
+size_t TamanoEspacioDecodificacion(const LZ77Params *params) {
+    TamanosContexto t;
+    memset(&t, 0, sizeof(t));
+    return TamanoTotal(&t);
+}
+
+LZ77Contexto *CrearContextoDecodificacionEn(const LZ77Params *params, void *memoria, size_t tam) {
+    TamanosContexto t;
+    memset(&t, 0, sizeof(t));
+    return RepartirContexto(params, &t, memoria, tam);
+}
+
+void ReiniciarContexto(LZ77Contexto *ctx) {
+    ctx->longitud_coincidencia = 0;
+    ctx->posicion_coincidencia = 0;
+    ctx->in_ptr = NULL;
+    ctx->in_size = ctx->in_pos = 0;
+    ctx->out_ptr = NULL;
+    ctx->out_capacity = ctx->out_pos = 0;
+    ctx->error = 0;
+    ctx->buffer_bits = ctx->bits_en = 0;
+    /* Los contextos de descompresión no tienen tablas que iniciar */
+    if (ctx->hash)
+        InicializarCodificacionCtx(ctx);
+}
+
+void DestruirContexto(LZ77Contexto *ctx) {
+    /* Los contextos de CrearContextoEn viven en memoria del llamante */
+    if (!ctx || !ctx->propietario)
+        return;
+    free(ctx->diccionario);
+    free(ctx->hash);
+    free(ctx->siguiente_enlace);
+    free(ctx->analisis);
+    free(ctx->tokens);
+    LiberarBuscador(ctx);
+    free(ctx);
+}
+
 /* Escribe múltiples bits al buffer de salida */
-void EnviarBits(unsigned int bits, unsigned int num_bits) {
-    buffer_bits |= (bits << bits_en);
-    bits_en += num_bits;
+void EnviarBitsCtx(LZ77Contexto *ctx, unsigned int bits, unsigned int num_bits) {
+    ctx->buffer_bits |= (bits << ctx->bits_en);
+    ctx->bits_en += num_bits;
 
-    while (bits_en >= 8) {
-        if (out_pos >= out_capacity) {
-            fprintf(stderr, "\nBuffer de salida lleno (compresión)");
-            exit(EXIT_FAILURE);
-        }
-        out_ptr[out_pos++] = buffer_bits & 0xFF;
-        buffer_bits >>= 8;
-        bits_en -= 8;
+    while (ctx->bits_en >= 8) {
+        /* Sin espacio: el byte se descarta y la llamada que escribe devuelve -1 */
+        if (ctx->out_pos >= ctx->out_capacity)
+            ctx->error = 1;
+        else
+            ctx->out_ptr[ctx->out_pos++] = ctx->buffer_bits & 0xFF;
+        ctx->buffer_bits >>= 8;
+        ctx->bits_en -= 8;
     }
 }
 
 /* Lee múltiples bits del buffer de entrada */
-unsigned int LeerBits(unsigned int num_bits) {
+unsigned int LeerBitsCtx(LZ77Contexto *ctx, unsigned int num_bits) {
     register unsigned int i = 0, shift = 0;
 
-    while (bits_en < num_bits) {
-        if (in_pos >= in_size) {
-            fprintf(stderr, "\nBuffer de entrada insuficiente (descompresión)");
-            exit(EXIT_FAILURE);
-        }
-        buffer_bits |= (in_ptr[in_pos++] << bits_en);
-        bits_en += 8;
+    while (ctx->bits_en < num_bits) {
+        /* Entrada agotada: se leen ceros y queda marcado el error */
+        if (ctx->in_pos >= ctx->in_size)
+            ctx->error = 1;
+        else
+            ctx->buffer_bits |= (ctx->in_ptr[ctx->in_pos++] << ctx->bits_en);
+        ctx->bits_en += 8;
     }
 
-    i = buffer_bits & mascaras[num_bits];
-    buffer_bits >>= num_bits;
-    bits_en -= num_bits;
+    i = ctx->buffer_bits & mascaras[num_bits];
+    ctx->buffer_bits >>= num_bits;
+    ctx->bits_en -= num_bits;
     return i;
 }
 
 /* EnviarCoincidencia y EnviarCaracter */
-void EnviarCoincidencia(const LZ77Params *params, const DerivedParams *derived, unsigned int longitud, unsigned int distancia) {
-    EnviarBits(1, 1);
-    EnviarBits(longitud - (params->umbral + 1), params->bits_coincidencia);
-    EnviarBits(distancia, params->bits_diccionario);
+static void EnviarCoincidenciaVariable(LZ77Contexto *ctx, unsigned int longitud, unsigned int distancia) {
+    const unsigned int escape = LongitudEscape(&ctx->params);
+    const unsigned int cubeta = distancia ? CubetaDistancia(distancia) : 0;
+    unsigned int extension, num_bits;
+    if (longitud < escape) {
+        EnviarBitsCtx(ctx, 1 | ((longitud - (ctx->params.umbral + 1)) << 1), 1 + ctx->params.bits_coincidencia);
+    } else {
+        EnviarBitsCtx(ctx, 1 | ((escape - (ctx->params.umbral + 1)) << 1), 1 + ctx->params.bits_coincidencia);
+        extension = CodificarExtension(longitud - escape, &num_bits);
+        EnviarBitsCtx(ctx, extension, num_bits);
+    }
+    EnviarBitsCtx(ctx, cubeta, BitsCubeta(ctx->params.bits_diccionario));
+    if (cubeta > 17) {
+        EnviarBitsCtx(ctx, distancia & 0xFFFF, 16);
+        EnviarBitsCtx(ctx, (distancia >> 16) & ((1u << (cubeta - 17)) - 1), cubeta - 17);
+    } else if (cubeta > 1) {
+        EnviarBitsCtx(ctx, distancia & ((1u << (cubeta - 1)) - 1), cubeta - 1);
+    }
 }
-void EnviarCaracter(const LZ77Params *params, unsigned int caracter) {
-    EnviarBits(0, 1);
-    EnviarBits(caracter, params->bits_caracter);
+void EnviarCoincidenciaCtx(LZ77Contexto *ctx, unsigned int longitud, unsigned int distancia) {
+    if (ctx->params.codigos == LZ77_CODIGOS_VARIABLES) {
+        EnviarCoincidenciaVariable(ctx, longitud, distancia);
+        return;
+    }
+    EnviarBitsCtx(ctx, 1, 1);
+    EnviarBitsCtx(ctx, longitud - (ctx->params.umbral + 1), ctx->params.bits_coincidencia);
+    if (ctx->params.bits_diccionario > 16) {
+        /* El buffer de bits es de 32 bits: las distancias largas se envían en dos partes */
+        EnviarBitsCtx(ctx, distancia & 0xFFFF, 16);
+        EnviarBitsCtx(ctx, distancia >> 16, ctx->params.bits_diccionario - 16);
+    } else {
+        EnviarBitsCtx(ctx, distancia, ctx->params.bits_diccionario);
+    }
+}
+void EnviarCaracterCtx(LZ77Contexto *ctx, unsigned int caracter) {
+    EnviarBitsCtx(ctx, 0, 1);
+    EnviarBitsCtx(ctx, caracter, ctx->params.bits_caracter);
+}
+
+/* Marca de fin: la longitud max_coincidencia + 1 o, con códigos variables, la cubeta 0 */
+void EnviarFinCtx(LZ77Contexto *ctx) {
+    if (ctx->params.codigos == LZ77_CODIGOS_VARIABLES) {
+        EnviarBitsCtx(ctx, 1, 1 + ctx->params.bits_coincidencia);
+        EnviarBitsCtx(ctx, 0, BitsCubeta(ctx->params.bits_diccionario));
+        return;
+    }
+    EnviarCoincidenciaCtx(ctx, ctx->derived.max_coincidencia + 1, 0);
 }
 
 /* Inicialización */
-void InicializarCodificacion(const DerivedParams *derived) {
+void InicializarCodificacionCtx(LZ77Contexto *ctx) {
     register unsigned int i;
-    buffer_bits = 0;
-    bits_en = 0;
+    ctx->buffer_bits = 0;
+    ctx->bits_en = 0;
 
-    for (i = 0; i < derived->tam_hash; i++)
-        hash[i] = 0xFFFF; //NULO;
-    for (i = 0; i < derived->tam_diccionario; i++)
-        siguiente_enlace[i] = 0xFFFF; //NULO;
+    if (ctx->derived.ventana_grande) {
+        /*
+         * Toda posición menor que limite está fuera de la ventana: 0 hace de NULO. Las
+         * guardadas son menores que base + tam_diccionario, así que empezar una ventana
+         * más allá (una generación nueva) las invalida todas sin tocar las tablas. Solo se
+         * borran la primera vez y cuando las posiciones se acercan al desbordamiento.
+         */
+        int borrar = !ctx->tablas_iniciadas || ctx->base >= LZ77_LIMITE_REBASE;
+        if (borrar) {
+            ctx->base = ctx->derived.tam_diccionario;
+            memset(ctx->hash, 0, ctx->derived.tam_hash * sizeof(unsigned int));
+            if (ctx->siguiente_enlace)
+                memset(ctx->siguiente_enlace, 0, ctx->derived.tam_diccionario * sizeof(unsigned int));
+            ctx->tablas_iniciadas = 1;
+        } else {
+            ctx->base += ctx->derived.tam_diccionario;
+        }
+        ctx->limite = ctx->base;
+        if (ctx->params.buscador != LZ77_BUSCADOR_CADENA)
+            InicializarBuscador(ctx, borrar);
+        return;
+    }
+    for (i = 0; i < ctx->derived.tam_hash; i++)
+        ctx->hash[i] = 0xFFFF; //NULO;
+    for (i = 0; i < ctx->derived.tam_diccionario; i++)
+        ctx->siguiente_enlace[i] = 0xFFFF; //NULO;
+}
+
+/* Pone a cero los bytes del diccionario que siguen a 'fin' y que la búsqueda puede leer */
+void LimpiarTrasDatos(LZ77Contexto *ctx, unsigned int fin) {
+    unsigned int n = ctx->derived.max_coincidencia;
+    if (fin >= ctx->derived.tam_diccionario)
+        return;
+    if (n > ctx->derived.tam_diccionario - fin)
+        n = ctx->derived.tam_diccionario - fin;
+    memset(ctx->diccionario + fin, 0, n);
 }
 
 /* Cargar datos desde el buffer de entrada */
-unsigned int CargarDiccionario(const LZ77Params *params, const DerivedParams *derived, unsigned int posicion) {
-    unsigned int bytes = (in_pos + derived->tam_sector <= in_size) ? derived->tam_sector : (in_size - in_pos);
+unsigned int CargarDiccionarioCtx(LZ77Contexto *ctx, unsigned int posicion) {
+    const DerivedParams *derived = &ctx->derived;
+    unsigned int bytes = (ctx->in_pos + derived->tam_sector <= ctx->in_size) ? derived->tam_sector : (ctx->in_size - ctx->in_pos);
     if (bytes == 0)
         return 0;
-    memcpy(&diccionario[posicion], in_ptr + in_pos, bytes);
-    in_pos += bytes;
+    memcpy(&ctx->diccionario[posicion], ctx->in_ptr + ctx->in_pos, bytes);
+    ctx->in_pos += bytes;
+    /* En la primera vuelta la búsqueda compara hasta max_coincidencia bytes más allá de
+     * lo cargado: se ponen a cero para que la salida no dependa de memoria sin iniciar */
+    if (ctx->in_pos + ctx->inicio_entrada <= derived->tam_diccionario)
+        LimpiarTrasDatos(ctx, posicion + bytes);
     if (posicion == 0)
-        memcpy(diccionario + derived->tam_diccionario, diccionario, derived->max_coincidencia);
+        memcpy(ctx->diccionario + derived->tam_diccionario, ctx->diccionario, derived->max_coincidencia);
     return bytes;
 }
 
+/*
+ * Diccionario prefijado: se coloca justo antes del primer límite de sector que lo
+ * sigue, donde empezará la entrada, y se hashea como si fuera entrada ya codificada.
+ * El hueco anterior se pone a cero y no se inserta en ningún buscador.
+ */
+void EstablecerDiccionarioCtx(LZ77Contexto *ctx, const unsigned char *datos, unsigned int tam) {
+    unsigned int maximo = ctx->derived.tam_diccionario - ctx->derived.tam_sector;
+    if (!datos)
+        tam = 0;
+    if (tam > maximo) {
+        datos += tam - maximo;
+        tam = maximo;
+    }
+    ctx->prefijo = datos;
+    ctx->tam_prefijo = tam;
+    ctx->preparado = NULL;
+}
+
+unsigned int CargarPrefijoCtx(LZ77Contexto *ctx) {
+    const DerivedParams *derived = &ctx->derived;
+    unsigned int tam = ctx->tam_prefijo, inicio;
+    if (tam == 0)
+        return 0;
+    inicio = (tam + derived->tam_sector - 1) & ~(derived->tam_sector - 1);
+    memset(ctx->diccionario, 0, inicio - tam);
+    memcpy(ctx->diccionario + inicio - tam, ctx->prefijo, tam);
+    memcpy(ctx->diccionario + derived->tam_diccionario, ctx->diccionario,
+           inicio < derived->max_coincidencia ? inicio : derived->max_coincidencia);
+    HashearDatosCtx(ctx, inicio - tam, tam);
+    if (ctx->params.buscador != LZ77_BUSCADOR_CADENA)
+        ctx->cursor = ctx->base + inicio - tam;
+    return inicio;
+}
+
 /* EliminarDatos, HashearDatos, EncontrarCoincidencia */
-void EliminarDatos(const DerivedParams *derived, unsigned int posicion) {
+/* Modo ventana grande: resta delta a todas las posiciones guardadas (una vez cada ~3 GiB) */
+static void RebasarPosiciones(LZ77Contexto *ctx, unsigned int delta) {
+    register unsigned int i;
+    if (ctx->params.buscador != LZ77_BUSCADOR_CADENA)
+        RebasarBuscador(ctx, delta);
+    for (i = 0; ctx->siguiente_enlace && i < ctx->derived.tam_diccionario; i++)
+        ctx->siguiente_enlace[i] = ctx->siguiente_enlace[i] > delta ? ctx->siguiente_enlace[i] - delta : 0;
+    for (i = 0; i < ctx->derived.tam_hash; i++)
+        ctx->hash[i] = ctx->hash[i] > delta ? ctx->hash[i] - delta : 0;
+    ctx->base -= delta;
+}
+
+void EliminarDatosCtx(LZ77Contexto *ctx, unsigned int posicion) {
     register unsigned int i;
+    const DerivedParams *derived = &ctx->derived;
+    if (derived->ventana_grande) {
+        /* No se borra nada: basta con adelantar el límite de la ventana */
+        if (posicion == 0) {
+            if (ctx->base >= LZ77_LIMITE_REBASE)
+                RebasarPosiciones(ctx, ctx->base - derived->tam_diccionario);
+            ctx->base += derived->tam_diccionario;
+        }
+        ctx->limite = ctx->base + posicion + derived->tam_sector - derived->tam_diccionario;
+        return;
+    }
     for (i = 0; i < derived->tam_diccionario; i++)
-        if ((siguiente_enlace[i] & derived->mascara_sector) == posicion)
-            siguiente_enlace[i] = 0xFFFF; //NULO;
+        if ((ctx->siguiente_enlace[i] & derived->mascara_sector) == posicion)
+            ctx->siguiente_enlace[i] = 0xFFFF; //NULO;
     for (i = 0; i < derived->tam_hash; i++)
-        if ((hash[i] & derived->mascara_sector) == posicion)
-            hash[i] = 0xFFFF; //NULO;
+        if ((ctx->hash[i] & derived->mascara_sector) == posicion)
+            ctx->hash[i] = 0xFFFF; //NULO;
 }
-void HashearDatos(const LZ77Params *params, const DerivedParams *derived, unsigned int posicion, unsigned int bytes_a_hashear) {
+void HashearDatosCtx(LZ77Contexto *ctx, unsigned int posicion, unsigned int bytes_a_hashear) {
     register unsigned int i, j, k;
+    const LZ77Params *params = &ctx->params;
+    const DerivedParams *derived = &ctx->derived;
+    unsigned char *dic = ctx->diccionario;
+    unsigned int *enlace = ctx->siguiente_enlace;
+    /* En modo ventana grande se guardan posiciones absolutas y 0 hace de NULO */
+    const unsigned int nulo = derived->ventana_grande ? 0 : 0xFFFF;
+    const unsigned int base = derived->ventana_grande ? ctx->base : 0;
+    if (params->buscador != LZ77_BUSCADOR_CADENA) {
+        HashearBuscador(ctx, posicion, bytes_a_hashear);
+        if (params->buscador != LZ77_BUSCADOR_DOBLE)
+            return;
+    }
     if (bytes_a_hashear <= params->umbral) {
         for (i = 0; i < bytes_a_hashear; i++)
-            siguiente_enlace[posicion + i] = 0xFFFF; //NULO;
+            enlace[posicion + i] = nulo; //NULO;
     } else {
         for (i = bytes_a_hashear - params->umbral; i < bytes_a_hashear; i++)
-            siguiente_enlace[posicion + i] = 0xFFFF; //NULO;
-        j = (((unsigned int)diccionario[posicion]) << derived->bits_desplazamiento) ^ diccionario[posicion + 1];
+            enlace[posicion + i] = nulo; //NULO;
+        j = (((unsigned int)dic[posicion]) << derived->bits_desplazamiento) ^ dic[posicion + 1];
         k = posicion + bytes_a_hashear - params->umbral;
         for (i = posicion; i < k; i++) {
-            siguiente_enlace[i] = hash[j = (((j << derived->bits_desplazamiento) & (derived->tam_hash - 1)) ^ diccionario[i + params->umbral])];
-            hash[j] = i;
+            enlace[i] = ctx->hash[j = (((j << derived->bits_desplazamiento) & (derived->tam_hash - 1)) ^ dic[i + params->umbral])];
+            ctx->hash[j] = base + i;
         }
     }
 }
-void EncontrarCoincidencia(const LZ77Params *params, const DerivedParams *derived, unsigned int posicion, unsigned int longitud_inicial) {
+/* Modo ventana grande: los enlaces son absolutos y la cadena termina al salir de la ventana */
+void EncontrarCoincidenciaGrande(LZ77Contexto *ctx, unsigned int posicion, unsigned int longitud_inicial, unsigned int max_comparaciones) {
     register unsigned int i, j, k;
     unsigned char l;
+    const unsigned char *dic = ctx->diccionario;
+    const unsigned int *enlace = ctx->siguiente_enlace;
+    const unsigned int max_coincidencia = ctx->derived.max_coincidencia;
+    const unsigned int mascara = ctx->derived.tam_diccionario - 1;
+    const unsigned int limite = ctx->limite;
+    const unsigned int suficiente = LongitudSuficiente(ctx);
+    unsigned int longitud = longitud_inicial, candidato;
+    LZ77_ESTADISTICA(unsigned int candidatos = 0);
+    if (longitud >= suficiente) {
+        /* Ninguna búsqueda la mejoraría (el análisis perezoso lo pregunta a menudo) */
+        ctx->longitud_coincidencia = longitud;
+        return;
+    }
     i = posicion;
-    longitud_coincidencia = longitud_inicial;
-    k = params->max_comparaciones;
-    l = diccionario[posicion + longitud_coincidencia];
+    k = max_comparaciones;
+    l = dic[posicion + longitud];
     do {
-        if ((i = siguiente_enlace[i]) == 0xFFFF) //NULO)
-            return;
-        if (diccionario[i + longitud_coincidencia] == l) {
-            for (j = 0; j < derived->max_coincidencia; j++)
-                if (diccionario[posicion + j] != diccionario[i + j])
+        if ((candidato = enlace[i]) < limite)
+            break;
+        LZ77_ESTADISTICA(candidatos++);
+        i = candidato & mascara;
+        if (dic[i + longitud] == l) {
+            j = LongitudComun(dic + posicion, dic + i, max_coincidencia);
+            if (j > longitud) {
+                longitud = j;
+                ctx->posicion_coincidencia = i;
+                if (longitud >= suficiente)
+                    break;
+                l = dic[posicion + longitud];
+            }
+        }
+    } while (--k);
+    LZ77_ESTADISTICA(RegistrarBusqueda(&ctx->estadisticas, candidatos, k == 0));
+    ctx->longitud_coincidencia = longitud;
+}
+
+/*
+ * Compresión con varios hilos: responde con la búsqueda desde umbral ya hecha en la
+ * posición (si falta y no hay que registrarla, devuelve 0 y se busca sin más). Desde
+ * una longitud inicial mayor el recorrido de la cadena pasa por los mismos candidatos
+ * y termina en el mismo, así que basta con compararla con la guardada; con
+ * longitud_inicial >= LongitudSuficiente EncontrarCoincidenciaGrande ni siquiera busca.
+ */
+static inline int ConsultarPrecalculadas(LZ77Contexto *ctx, unsigned int posicion, unsigned int longitud_inicial) {
+    const unsigned int p = posicion - ctx->primera_precalculada;
+    unsigned int *guardada;
+    if (p >= ctx->num_precalculadas || longitud_inicial >= LongitudSuficiente(ctx))
+        return 0;
+    guardada = ctx->precalculadas + 2 * p;
+    if (guardada[0] == LZ77_NO_CALCULADA) {
+        if (!ctx->registrar_precalculadas)
+            return 0;
+        EncontrarCoincidenciaGrande(ctx, posicion, ctx->params.umbral, ctx->params.max_comparaciones);
+        guardada[0] = ctx->longitud_coincidencia;
+        guardada[1] = ctx->posicion_coincidencia;
+    }
+    ctx->longitud_coincidencia = longitud_inicial;
+    if (guardada[0] > longitud_inicial) {
+        ctx->longitud_coincidencia = guardada[0];
+        ctx->posicion_coincidencia = guardada[1];
+    }
+    return 1;
+}
+
+void EncontrarCoincidenciaCtx(LZ77Contexto *ctx, unsigned int posicion, unsigned int longitud_inicial) {
+    register unsigned int i, j, k;
+    unsigned char l;
+    const unsigned char *dic = ctx->diccionario;
+    const unsigned int *enlace = ctx->siguiente_enlace;
+    const unsigned int max_coincidencia = ctx->derived.max_coincidencia;
+    const unsigned int suficiente = LongitudSuficiente(ctx);
+    unsigned int longitud = longitud_inicial;
+    LZ77_ESTADISTICA(unsigned int candidatos = 0);
+    if (ctx->precalculadas && ConsultarPrecalculadas(ctx, posicion, longitud_inicial))
+        return;
+    if (ctx->params.buscador != LZ77_BUSCADOR_CADENA) {
+        EncontrarBuscador(ctx, posicion, longitud_inicial);
+        return;
+    }
+    if (ctx->derived.ventana_grande) {
+        EncontrarCoincidenciaGrande(ctx, posicion, longitud_inicial, ctx->params.max_comparaciones);
+        return;
+    }
+    i = posicion;
+    k = ctx->params.max_comparaciones;
+    l = dic[posicion + longitud];
+    do {
+        if ((i = enlace[i]) == 0xFFFF) //NULO)
+            break;
+        LZ77_ESTADISTICA(candidatos++);
+        if (dic[i + longitud] == l) {
+            j = LongitudComun(dic + posicion, dic + i, max_coincidencia);
+            if (j > longitud) {
+                longitud = j;
+                ctx->posicion_coincidencia = i;
+                if (longitud >= suficiente)
                     break;
-            if (j > longitud_coincidencia) {
-                longitud_coincidencia = j;
-                posicion_coincidencia = i;
-                if (longitud_coincidencia == derived->max_coincidencia)
-                    return;
-                l = diccionario[posicion + longitud_coincidencia];
+                l = dic[posicion + longitud];
             }
         }
     } while (--k);
+    LZ77_ESTADISTICA(RegistrarBusqueda(&ctx->estadisticas, candidatos, k == 0));
+    ctx->longitud_coincidencia = longitud;
+}
+
+/*
+ * Escritor de bits del bucle de búsqueda.
+ *
+ * Cada token (bandera + campos) se añade de una vez a un acumulador de 64 bits. Si
+ * la salida tiene sitio para el peor caso del sector completo, el acumulador se
+ * vuelca con una escritura de 8 bytes por token y solo se avanzan los bytes
+ * completos, sin comprobar la capacidad; si no, se vuelca byte a byte comprobándola.
+ * El flujo de bits resultante es idéntico al de EnviarCaracterCtx/EnviarCoincidenciaCtx.
+ */
+typedef struct EscritorBits {
+    unsigned long long acumulador;
+    unsigned int num_bits;
+    unsigned char *out;
+    unsigned int pos, capacidad;
+    int rapido, desbordado;
+    /* Formato de los tokens */
+    unsigned int bits_literal, bits_longitud, bits_coincidencia, longitud_minima;
+    unsigned int codigos, bits_cubeta, longitud_escape;
+#ifdef LZ77_ESTADISTICAS
+    LZ77Estadisticas *estadisticas;
+#endif
+} EscritorBits;
+
+static inline void IniciarEscritor(LZ77Contexto *ctx, EscritorBits *e, unsigned int bytes_a_comprimir) {
+    e->acumulador = ctx->buffer_bits;
+    e->num_bits = ctx->bits_en;
+    e->out = ctx->out_ptr;
+    e->pos = ctx->out_pos;
+    e->capacidad = ctx->out_capacity;
+    e->desbordado = 0;
+    e->rapido = ctx->out_pos <= ctx->out_capacity &&
+                ctx->out_capacity - ctx->out_pos >= CotaCompresion(&ctx->params, bytes_a_comprimir) + 8;
+    e->bits_literal = 1 + ctx->params.bits_caracter;
+    e->bits_longitud = 1 + ctx->params.bits_coincidencia;
+    e->bits_coincidencia = e->bits_longitud + ctx->params.bits_diccionario;
+    e->longitud_minima = ctx->params.umbral + 1;
+    e->codigos = (unsigned int)ctx->params.codigos;
+    e->bits_cubeta = BitsCubeta(ctx->params.bits_diccionario);
+    e->longitud_escape = LongitudEscape(&ctx->params);
+    LZ77_ESTADISTICA(e->estadisticas = &ctx->estadisticas);
+}
+
+static inline void TerminarEscritor(LZ77Contexto *ctx, const EscritorBits *e) {
+    ctx->buffer_bits = (unsigned int)e->acumulador;
+    ctx->bits_en = e->num_bits;
+    ctx->out_pos = e->pos;
+    if (e->desbordado)
+        ctx->error = 1;
+}
+
+static inline void EscribirToken(EscritorBits *e, unsigned long long valor, unsigned int num_bits) {
+    e->acumulador |= valor << e->num_bits;
+    e->num_bits += num_bits;
+    if (e->rapido) {
+        Escribir64(e->out + e->pos, e->acumulador);
+        e->pos += e->num_bits >> 3;
+        e->acumulador >>= e->num_bits & ~7u;
+        e->num_bits &= 7;
+        return;
+    }
+    while (e->num_bits >= 8) {
+        if (e->pos >= e->capacidad)
+            e->desbordado = 1;
+        else
+            e->out[e->pos++] = e->acumulador & 0xFF;
+        e->acumulador >>= 8;
+        e->num_bits -= 8;
+    }
+}
+
+/* Token de literal: bandera 0 seguida del carácter */
+static inline void EscribirCaracter(EscritorBits *e, unsigned int caracter) {
+    LZ77_ESTADISTICA(RegistrarToken(e->estadisticas, 0, 0));
+    EscribirToken(e, (unsigned long long)caracter << 1, e->bits_literal);
+}
+
+/* Con códigos variables el token puede pasar de los 57 bits que admite EscribirToken:
+ * si hay extensión, la distancia va en una segunda escritura */
+static inline void EscribirCoincidenciaVariable(EscritorBits *e, unsigned int longitud, unsigned int distancia) {
+    const unsigned int cubeta = CubetaDistancia(distancia);
+    const unsigned long long d = (unsigned long long)cubeta | ((unsigned long long)(distancia ^ (1u << (cubeta - 1))) << e->bits_cubeta);
+    unsigned int extension, num_bits;
+    if (longitud < e->longitud_escape) {
+        EscribirToken(e, 1 | ((unsigned long long)(longitud - e->longitud_minima) << 1) | (d << e->bits_longitud),
+                      e->bits_longitud + e->bits_cubeta + cubeta - 1);
+        return;
+    }
+    extension = CodificarExtension(longitud - e->longitud_escape, &num_bits);
+    EscribirToken(e, 1 | ((unsigned long long)(e->longitud_escape - e->longitud_minima) << 1) |
+                  ((unsigned long long)extension << e->bits_longitud), e->bits_longitud + num_bits);
+    EscribirToken(e, d, e->bits_cubeta + cubeta - 1);
+}
+
+/* Token de coincidencia: bandera 1, longitud - (umbral + 1) y distancia */
+static inline void EscribirCoincidencia(EscritorBits *e, unsigned int longitud, unsigned int distancia) {
+    LZ77_ESTADISTICA(RegistrarToken(e->estadisticas, longitud, distancia));
+    if (e->codigos == LZ77_CODIGOS_VARIABLES) {
+        EscribirCoincidenciaVariable(e, longitud, distancia);
+        return;
+    }
+    EscribirToken(e, 1 | ((unsigned long long)(longitud - e->longitud_minima) << 1) |
+                  ((unsigned long long)distancia << e->bits_longitud), e->bits_coincidencia);
+}
+
+/* Coste en bits de cada token, usado por el análisis óptimo */
+static inline unsigned int CosteCaracter(const EscritorBits *e, unsigned int caracter) {
+    return e->bits_literal;
+}
+static inline unsigned int CosteCoincidencia(const EscritorBits *e, unsigned int longitud, unsigned int distancia) {
+    unsigned int coste, num_bits;
+    if (e->codigos != LZ77_CODIGOS_VARIABLES)
+        return e->bits_coincidencia;
+    coste = e->bits_longitud + e->bits_cubeta + CubetaDistancia(distancia) - 1;
+    if (longitud >= e->longitud_escape) {
+        CodificarExtension(longitud - e->longitud_escape, &num_bits);
+        coste += num_bits;
+    }
+    return coste;
+}
+
+/*
+ * Análisis perezoso de dos pasos: antes de aceptar una coincidencia en i se prueba
+ * en i + 1 (un literal de más) y en i + 2 (dos literales de más), y se avanza si
+ * la coincidencia posterior compensa los literales.
+ */
+/*
+ * Aceleración al estilo de LZ4: número de literales que se emiten tras una búsqueda
+ * fallida antes de volver a buscar (siempre 1 con aceleracion = 0)
+ */
+#define LZ77_ACELERACION_BITS 6
+static inline unsigned int PasoTrasFallo(LZ77Contexto *ctx, unsigned int restantes) {
+    unsigned int paso = 1 + ((ctx->fallos++ * (unsigned int)ctx->params.aceleracion) >> LZ77_ACELERACION_BITS);
+    return paso < restantes ? paso : restantes;
+}
+
+static void AnalisisPerezoso2(LZ77Contexto *ctx, EscritorBits *e, unsigned int posicion, unsigned int bytes_a_comprimir) {
+    register unsigned int i = posicion, j = bytes_a_comprimir;
+    const unsigned int umbral = ctx->params.umbral;
+    const unsigned int mascara_diccionario = ctx->derived.tam_diccionario - 1;
+    const unsigned int suficiente = LongitudSuficiente(ctx);
+    const unsigned char *dic = ctx->diccionario;
+    unsigned int longitud, origen, siguiente, paso;
+
+    while (j) {
+        EncontrarCoincidenciaCtx(ctx, i, umbral);
+        longitud = ctx->longitud_coincidencia < j ? ctx->longitud_coincidencia : j;
+        if (longitud <= umbral) {
+            for (paso = PasoTrasFallo(ctx, j); paso; paso--, j--)
+                EscribirCaracter(e, dic[i++]);
+            continue;
+        }
+        ctx->fallos = 0;
+        origen = ctx->posicion_coincidencia;
+        for (;;) {
+            if (longitud >= suficiente)
+                break;
+            if (j > 1) {
+                EncontrarCoincidenciaCtx(ctx, i + 1, longitud);
+                siguiente = ctx->longitud_coincidencia < j - 1 ? ctx->longitud_coincidencia : j - 1;
+                LZ77_ESTADISTICA(ctx->estadisticas.intentos_perezosos++);
+                if (siguiente > longitud) {
+                    LZ77_ESTADISTICA(ctx->estadisticas.perezosas_ganadas++);
+                    EscribirCaracter(e, dic[i++]);
+                    j--;
+                    longitud = siguiente;
+                    origen = ctx->posicion_coincidencia;
+                    continue;
+                }
+            }
+            if (j > 2) {
+                EncontrarCoincidenciaCtx(ctx, i + 2, longitud + 1);
+                siguiente = ctx->longitud_coincidencia < j - 2 ? ctx->longitud_coincidencia : j - 2;
+                LZ77_ESTADISTICA(ctx->estadisticas.intentos_perezosos++);
+                if (siguiente > longitud + 1) {
+                    LZ77_ESTADISTICA(ctx->estadisticas.perezosas_ganadas++);
+                    EscribirCaracter(e, dic[i++]);
+                    EscribirCaracter(e, dic[i++]);
+                    j -= 2;
+                    longitud = siguiente;
+                    origen = ctx->posicion_coincidencia;
+                    continue;
+                }
+            }
+            break;
+        }
+        EscribirCoincidencia(e, longitud, (i - origen) & mascara_diccionario);
+        i += longitud;
+        j -= longitud;
+    }
+}
+
+/*
+ * Análisis óptimo: se busca la coincidencia más larga en cada posición del tramo y
+ * después se elige, de atrás hacia delante, la secuencia de tokens de menor coste
+ * total en bits. Cualquier longitud entre umbral + 1 y la más larga encontrada sirve
+ * con el mismo origen, por lo que basta una búsqueda por posición. Con códigos
+ * variables, tras una coincidencia de LongitudSuficiente bytes o más no se busca en las
+ * posiciones que cubre: se sigue la misma, con el origen desplazado.
+ *
+ * analisis debe tener sitio para 3 * (bytes_a_comprimir + 1) enteros.
+ */
+static void AnalisisOptimo(LZ77Contexto *ctx, EscritorBits *e, unsigned int posicion, unsigned int bytes_a_comprimir,
+                           unsigned int *analisis) {
+    register unsigned int p, l;
+    const unsigned int n = bytes_a_comprimir;
+    const unsigned int umbral = ctx->params.umbral;
+    const unsigned int mascara_diccionario = ctx->derived.tam_diccionario - 1;
+    const unsigned char *dic = ctx->diccionario;
+    unsigned int *coste = analisis;              /* Coste mínimo desde p hasta el final */
+    unsigned int *longitud = analisis + (n + 1); /* Longitud más larga en p, luego longitud elegida */
+    unsigned int *distancia = analisis + 2 * (n + 1);
+    const unsigned int suficiente = LongitudSuficiente(ctx);
+    unsigned int hasta = 0;
+
+    for (p = 0; p < n; p++) {
+        if (p < hasta) {
+            longitud[p] = longitud[p - 1] - 1;
+            distancia[p] = distancia[p - 1];
+            continue;
+        }
+        EncontrarCoincidenciaCtx(ctx, posicion + p, umbral);
+        longitud[p] = ctx->longitud_coincidencia < n - p ? ctx->longitud_coincidencia : n - p;
+        distancia[p] = (posicion + p - ctx->posicion_coincidencia) & mascara_diccionario;
+        if (longitud[p] >= suficiente && suficiente < ctx->derived.max_coincidencia)
+            hasta = p + longitud[p];
+    }
+
+    coste[n] = 0;
+    for (p = n; p-- > 0;) {
+        unsigned int mejor = CosteCaracter(e, dic[posicion + p]) + coste[p + 1], elegida = 1;
+        if (longitud[p] > umbral) {
+            /* Las longitudes más largas van primero: a igual coste, menos tokens */
+            for (l = longitud[p]; l > umbral; l--) {
+                unsigned int c = CosteCoincidencia(e, l, distancia[p]) + coste[p + l];
+                if (c < mejor) {
+                    mejor = c;
+                    elegida = l;
+                }
+                /* Con escape el coste apenas depende de la longitud: tras la más larga
+                 * se pasa directamente a las que no lo necesitan */
+                if (l > e->longitud_escape)
+                    l = e->longitud_escape;
+            }
+        }
+        coste[p] = mejor;
+        longitud[p] = elegida;
+    }
+
+    for (p = 0; p < n;) {
+        if (longitud[p] > 1) {
+            EscribirCoincidencia(e, longitud[p], distancia[p]);
+            p += longitud[p];
+        } else {
+            EscribirCaracter(e, dic[posicion + p]);
+            p++;
+        }
+    }
 }
 
 /* BuscarEnDiccionario */
-void BuscarEnDiccionario(const LZ77Params *params, const DerivedParams *derived, unsigned int posicion, unsigned int bytes_a_comprimir) {
+void BuscarEnDiccionarioCtx(LZ77Contexto *ctx, unsigned int posicion, unsigned int bytes_a_comprimir) {
     register unsigned int i, j;
-    
-    if (params->codicia == 0){
+    const LZ77Params *params = &ctx->params;
+    const unsigned int mascara_diccionario = ctx->derived.tam_diccionario - 1;
+    const unsigned char *dic = ctx->diccionario;
+    int estrategia = EstrategiaEfectiva(params);
+    unsigned int paso;
+    EscritorBits e;
+
+    IniciarEscritor(ctx, &e, bytes_a_comprimir);
+    if (estrategia == LZ77_ESTRATEGIA_OPTIMA) {
+        unsigned int *analisis = ctx->analisis;
+        if (!analisis || bytes_a_comprimir > ctx->derived.tam_sector)
+            analisis = (unsigned int *)malloc(3 * (bytes_a_comprimir + 1) * sizeof(unsigned int));
+        if (analisis) {
+            AnalisisOptimo(ctx, &e, posicion, bytes_a_comprimir, analisis);
+            if (analisis != ctx->analisis)
+                free(analisis);
+            TerminarEscritor(ctx, &e);
+            return;
+        }
+        estrategia = LZ77_ESTRATEGIA_PEREZOSA2;    /* Sin memoria para el análisis */
+    }
+    if (estrategia == LZ77_ESTRATEGIA_PEREZOSA2) {
+        AnalisisPerezoso2(ctx, &e, posicion, bytes_a_comprimir);
+    } else if (estrategia == LZ77_ESTRATEGIA_PEREZOSA){
         unsigned int longitud1, posicion1;
         i = posicion;
         j = bytes_a_comprimir;
         while (j) {
-            EncontrarCoincidencia(params, derived, i, params->umbral);
-            if (longitud_coincidencia > params->umbral) {
-                longitud1 = longitud_coincidencia;
-                posicion1 = posicion_coincidencia;
+            EncontrarCoincidenciaCtx(ctx, i, params->umbral);
+            if (ctx->longitud_coincidencia > params->umbral) {
+                ctx->fallos = 0;
+                longitud1 = ctx->longitud_coincidencia;
+                posicion1 = ctx->posicion_coincidencia;
                 for (;;) {
-                    EncontrarCoincidencia(params, derived, i + 1, longitud1);
-                    if (longitud_coincidencia > longitud1) {
-                        longitud1 = longitud_coincidencia;
-                        posicion1 = posicion_coincidencia;
-                        EnviarCaracter(params, diccionario[i++]);
+                    /* En el último byte del sector no hay posición siguiente que probar */
+                    if (j > 1)
+                        EncontrarCoincidenciaCtx(ctx, i + 1, longitud1);
+                    else
+                        ctx->longitud_coincidencia = longitud1;
+                    LZ77_ESTADISTICA(ctx->estadisticas.intentos_perezosos++);
+                    if (ctx->longitud_coincidencia > longitud1) {
+                        LZ77_ESTADISTICA(ctx->estadisticas.perezosas_ganadas++);
+                        longitud1 = ctx->longitud_coincidencia;
+                        posicion1 = ctx->posicion_coincidencia;
+                        EscribirCaracter(&e, dic[i++]);
                         j--;
                     } else {
                         if (longitud1 > j) {
                             longitud1 = j;
                             if (longitud1 <= params->umbral) {
-                                EnviarCaracter(params, diccionario[i++]);
+                                EscribirCaracter(&e, dic[i++]);
                                 j--;
                                 break;
                             }
                         }
-                        EnviarCoincidencia(params, derived, longitud1, (i - posicion1) & (derived->tam_diccionario - 1));
+                        EscribirCoincidencia(&e, longitud1, (i - posicion1) & mascara_diccionario);
                         i += longitud1;
                         j -= longitud1;
                         break;
                     }
                 }
             } else {
-                EnviarCaracter(params, diccionario[i++]);
-                j--;
+                for (paso = PasoTrasFallo(ctx, j); paso; paso--, j--)
+                    EscribirCaracter(&e, dic[i++]);
             }
         }
     }else {
         i = posicion;
         j = bytes_a_comprimir;
         while (j) {
-            EncontrarCoincidencia(params, derived, i, params->umbral);
-            if (longitud_coincidencia > j)
-                longitud_coincidencia = j;
-            if (longitud_coincidencia > params->umbral) {
-                EnviarCoincidencia(params, derived, longitud_coincidencia, (i - posicion_coincidencia) & (derived->tam_diccionario - 1));
-                i += longitud_coincidencia;
-                j -= longitud_coincidencia;
+            EncontrarCoincidenciaCtx(ctx, i, params->umbral);
+            if (ctx->longitud_coincidencia > j)
+                ctx->longitud_coincidencia = j;
+            if (ctx->longitud_coincidencia > params->umbral) {
+                ctx->fallos = 0;
+                EscribirCoincidencia(&e, ctx->longitud_coincidencia, (i - ctx->posicion_coincidencia) & mascara_diccionario);
+                i += ctx->longitud_coincidencia;
+                j -= ctx->longitud_coincidencia;
             } else {
-                EnviarCaracter(params, diccionario[i++]);
-                j--;
+                for (paso = PasoTrasFallo(ctx, j); paso; paso--, j--)
+                    EscribirCaracter(&e, dic[i++]);
             }
         }
     }
+    TerminarEscritor(ctx, &e);
 }
 
-/* Compresión en memoria */
-int CodificarBuffer(const LZ77Params *params, const DerivedParams *derived, const unsigned char *input, unsigned int input_size, unsigned char *output, unsigned int output_capacity) {
-    in_ptr = input;
-    in_size = input_size;
-    in_pos = 0;
-    out_ptr = output;
-    out_capacity = output_capacity;
-    out_pos = 0;
+/* Compresión en memoria, tokens sin recodificar */
+static int CodificarTokensCtx(LZ77Contexto *ctx, const unsigned char *input, unsigned int input_size, unsigned char *output, unsigned int output_capacity) {
+    const DerivedParams *derived = &ctx->derived;
+    ctx->in_ptr = input;
+    ctx->in_size = input_size;
+    ctx->in_pos = 0;
+    ctx->out_ptr = output;
+    ctx->out_capacity = output_capacity;
+    ctx->out_pos = 0;
+    ctx->error = 0;
+    ctx->fallos = 0;
 
-    unsigned int posicion_diccionario = 0, marcar_para_eliminar = 0, longitud_sector;
-    InicializarCodificacion(derived);
+    unsigned int posicion_diccionario, marcar_para_eliminar = 0, longitud_sector;
+    if (UsarParalelo(ctx, input_size) && CodificarSectoresParalelo(ctx) == 0)
+        goto terminar;
+    if (ctx->preparado) {
+        posicion_diccionario = RestaurarDiccionarioPreparado(ctx);
+    } else {
+        InicializarCodificacionCtx(ctx);
+        posicion_diccionario = CargarPrefijoCtx(ctx);
+    }
+    ctx->inicio_entrada = posicion_diccionario;
 
     while (1) {
         if (marcar_para_eliminar)
-            EliminarDatos(derived, posicion_diccionario);
-        if ((longitud_sector = CargarDiccionario(params, derived, posicion_diccionario)) == 0)
+            LZ77_CRONOMETRAR(ctx, ns_eliminar, EliminarDatosCtx(ctx, posicion_diccionario));
+        if ((longitud_sector = CargarDiccionarioCtx(ctx, posicion_diccionario)) == 0)
             break;
-        HashearDatos(params, derived, posicion_diccionario, longitud_sector);
-        BuscarEnDiccionario(params, derived, posicion_diccionario, longitud_sector);
+        LZ77_CRONOMETRAR(ctx, ns_hashear, HashearDatosCtx(ctx, posicion_diccionario, longitud_sector));
+        LZ77_CRONOMETRAR(ctx, ns_busqueda, BuscarEnDiccionarioCtx(ctx, posicion_diccionario, longitud_sector));
+        if (ctx->error)
+            break;                  /* Salida llena: no merece la pena seguir */
         posicion_diccionario += derived->tam_sector;
         if (posicion_diccionario == derived->tam_diccionario) {
             posicion_diccionario = 0;
             marcar_para_eliminar = 1;
         }
     }
-    EnviarCoincidencia(params, derived, derived->max_coincidencia + 1, 0);
-    if (bits_en)
-        EnviarBits(0, 8 - bits_en);
-    return out_pos; // Tamaño de los datos comprimidos
+terminar:
+    EnviarFinCtx(ctx);
+    if (ctx->bits_en)
+        EnviarBitsCtx(ctx, 0, 8 - ctx->bits_en);
+    if (ctx->error) {
+        fprintf(stderr, "\nBuffer de salida lleno (compresión)");
+        return -1;
+    }
+    return ctx->out_pos; // Tamaño de los datos comprimidos
 }
 
-/* Descompresión en memoria */
-int DecodificarBuffer(const LZ77Params *params, const DerivedParams *derived, const unsigned char *input, unsigned int input_size, unsigned char *output, unsigned int output_capacity) {
-    in_ptr = input;
-    in_size = input_size;
-    in_pos = 0;
-    out_ptr = output;
-    out_capacity = output_capacity;
-    out_pos = 0;
-    bits_en = 0;
-    buffer_bits = 0;
-    unsigned int i = 0;
-    for (;;) {
-        if (LeerBits(1) == 0) {
-            if (i >= derived->tam_diccionario + derived->max_coincidencia) {
-                fprintf(stderr, "Desbordamiento de diccionario\n");
-                return -1;
+/*
+ * Campos del LZ77Params que fijan el formato de los tokens. Se pasan por valor a
+ * DecodificarConFormato: con valores literales (núcleos especializados) el compilador
+ * pliega los desplazamientos, las máscaras y la longitud máxima; con los del contexto
+ * se obtiene la versión genérica.
+ */
+typedef struct FormatoTokens {
+    unsigned int bits_caracter, umbral, bits_coincidencia, bits_diccionario, codigos, carriles;
+} FormatoTokens;
+
+static inline FormatoTokens FormatoDe(const LZ77Params *params) {
+    FormatoTokens f = {params->bits_caracter, params->umbral, params->bits_coincidencia, params->bits_diccionario,
+                       (unsigned int)params->codigos, (unsigned int)UsaCarriles(params)};
+    return f;
+}
+
+/*
+ * Descompresión en memoria.
+ *
+ * Decodifica directamente sobre el buffer de salida (las coincidencias se copian
+ * desde la propia salida, sin pasar por el diccionario circular). Los bits se leen
+ * de un acumulador de 64 bits que se recarga de 8 en 8 bytes: cada recarga deja al
+ * menos 56 bits disponibles, suficientes para cualquier token. El bucle rápido solo
+ * comprueba los límites una vez por token; cerca del final de la entrada o de la
+ * salida continúa un bucle seguro que comprueba cada lectura y cada escritura.
+ *
+ * Con códigos variables una coincidencia con extensión puede pasar de 56 bits: se
+ * recarga otra vez antes de la distancia (de ahí el margen de 16 bytes de entrada) y
+ * las coincidencias más largas que el margen de salida se copian byte a byte.
+ */
+LZ77_EN_LINEA int DecodificarConFormato(LZ77Contexto *ctx, const unsigned char *input, unsigned int input_size,
+                                        unsigned char *output, unsigned int output_capacity, const FormatoTokens f) {
+    const unsigned int bits_caracter = f.bits_caracter;
+    const unsigned int bits_longitud = 1 + f.bits_coincidencia;
+    const unsigned int bits_distancia = f.bits_diccionario;
+    const unsigned long long mascara_caracter = (1ULL << bits_caracter) - 1;
+    const unsigned long long mascara_longitud = (1ULL << f.bits_coincidencia) - 1;
+    const unsigned long long mascara_distancia = (1ULL << bits_distancia) - 1;
+    const unsigned int longitud_minima = f.umbral + 1;
+    const unsigned int max_coincidencia = (1u << f.bits_coincidencia) + f.umbral - 1;
+    const unsigned int marca_fin = max_coincidencia + 1;
+    const int variables = f.codigos == LZ77_CODIGOS_VARIABLES;
+    const unsigned int bits_cubeta = BitsCubeta(bits_distancia);
+    const unsigned int mascara_cubeta = (1u << bits_cubeta) - 1;
+    const unsigned int margen_entrada = variables ? 16 : 8;
+
+    const unsigned char *in = input, *in_fin = input + input_size;
+    unsigned char *out = output, *out_fin = output + output_capacity;
+    /* Límites del bucle rápido: bytes legibles para cada recarga y sitio para la coincidencia
+     * más larga sin extensión */
+    const unsigned char *in_rapido = input_size >= margen_entrada ? in_fin - margen_entrada : input;
+    unsigned char *out_rapido = output_capacity >= max_coincidencia + LZ77_MARGEN_COPIA ?
+                                out_fin - (max_coincidencia + LZ77_MARGEN_COPIA) : output;
+    unsigned long long bits = 0;
+    unsigned int num_bits = 0, k, distancia, c, extension;
+
+    ctx->in_ptr = input;
+    ctx->in_size = input_size;
+    ctx->out_ptr = output;
+    ctx->out_capacity = output_capacity;
+    ctx->bits_en = 0;
+    ctx->buffer_bits = 0;
+
+    /* Bucle rápido */
+    while (in < in_rapido && out < out_rapido) {
+        bits |= Leer64(in) << num_bits;
+        in += (63 - num_bits) >> 3;
+        num_bits |= 56;
+
+        if ((bits & 1) == 0) {
+            LZ77_ESTADISTICA(ctx->estadisticas.literales++);
+            *out++ = (unsigned char)((bits >> 1) & mascara_caracter);
+            bits >>= 1 + bits_caracter;
+            num_bits -= 1 + bits_caracter;
+            continue;
+        }
+        k = (unsigned int)((bits >> 1) & mascara_longitud) + longitud_minima;
+        if (variables) {
+            bits >>= bits_longitud;
+            num_bits -= bits_longitud;
+            if (k == marca_fin) {
+                c = DecodificarExtension(bits, &extension);
+                if (c == 0)
+                    goto longitud_no_valida;
+                k += extension;
+                bits >>= c;
+                num_bits -= c;
             }
-            diccionario[i++] = LeerBits(params->bits_caracter);
-            if (i == derived->tam_diccionario) {
-                if (out_pos + derived->tam_diccionario > out_capacity) {
-                    fprintf(stderr, "Buffer de salida lleno (descompresión)\n");
-                    return -1;
+            bits |= Leer64(in) << num_bits;
+            in += (63 - num_bits) >> 3;
+            num_bits |= 56;
+            c = (unsigned int)bits & mascara_cubeta;
+            if (c == 0)
+                goto fin;
+            if (c > bits_distancia)
+                goto distancia_no_valida;
+            distancia = (1u << (c - 1)) | (unsigned int)((bits >> bits_cubeta) & ((1ULL << (c - 1)) - 1));
+            bits >>= bits_cubeta + c - 1;
+            num_bits -= bits_cubeta + c - 1;
+            if (k > max_coincidencia) {
+                /* Más larga que el margen del bucle rápido: se comprueba aparte */
+                if (k > (unsigned int)(out_fin - out))
+                    goto salida_llena;
+                LZ77_ESTADISTICA(RegistrarToken(&ctx->estadisticas, k, distancia));
+                if (distancia > (unsigned int)(out - output)) {
+                    if (CopiarDesdePrefijo(out, (unsigned int)(out - output), ctx->prefijo, ctx->tam_prefijo, distancia, k) != 0)
+                        goto distancia_no_valida;
+                    out += k;
+                    continue;
+                }
+                if ((unsigned int)(out_fin - out) >= k + LZ77_MARGEN_COPIA) {
+                    CopiarCoincidencia(out, distancia, k);
+                    out += k;
+                    continue;
                 }
-                memcpy(out_ptr + out_pos, diccionario, derived->tam_diccionario);
-                out_pos += derived->tam_diccionario;
-                i = 0;
+                do {
+                    *out = *(out - distancia);
+                    out++;
+                } while (--k);
+                continue;
             }
         } else {
-            unsigned int k = (params->umbral + 1) + LeerBits(params->bits_coincidencia);
-            if (k == (derived->max_coincidencia + 1)) {
-                if (out_pos + i > out_capacity) {
-                    fprintf(stderr, "Buffer de salida lleno (descompresión)\n");
-                    return -1;
-                }
-                memcpy(out_ptr + out_pos, diccionario, i);
-                out_pos += i;
-                return out_pos;
+            if (k == marca_fin)
+                goto fin;
+            distancia = (unsigned int)((bits >> bits_longitud) & mascara_distancia);
+            bits >>= bits_longitud + bits_distancia;
+            num_bits -= bits_longitud + bits_distancia;
+            if (distancia == 0)
+                goto distancia_no_valida;
+        }
+        LZ77_ESTADISTICA(RegistrarToken(&ctx->estadisticas, k, distancia));
+        if (distancia <= (unsigned int)(out - output))
+            CopiarCoincidencia(out, distancia, k);
+        else if (CopiarDesdePrefijo(out, (unsigned int)(out - output), ctx->prefijo, ctx->tam_prefijo, distancia, k) != 0)
+            goto distancia_no_valida;
+        out += k;
+    }
+
+    /* Bucle seguro: los bytes de la recarga rápida que no se consumieron se devuelven */
+    in -= num_bits >> 3;
+    num_bits &= 7;
+    bits &= (1ULL << num_bits) - 1;
+    for (;;) {
+        while (num_bits <= 56 && in < in_fin) {
+            bits |= (unsigned long long)*in++ << num_bits;
+            num_bits += 8;
+        }
+        if (num_bits < 1 + bits_caracter && (num_bits < 1 || (bits & 1) == 0))
+            goto entrada_insuficiente;
+
+        if ((bits & 1) == 0) {
+            if (out >= out_fin)
+                goto salida_llena;
+            LZ77_ESTADISTICA(ctx->estadisticas.literales++);
+            *out++ = (unsigned char)((bits >> 1) & mascara_caracter);
+            bits >>= 1 + bits_caracter;
+            num_bits -= 1 + bits_caracter;
+            continue;
+        }
+        if (num_bits < bits_longitud)
+            goto entrada_insuficiente;
+        k = (unsigned int)((bits >> 1) & mascara_longitud) + longitud_minima;
+        if (variables) {
+            bits >>= bits_longitud;
+            num_bits -= bits_longitud;
+            if (k == marca_fin) {
+                c = DecodificarExtension(bits, &extension);
+                if (c == 0)
+                    goto longitud_no_valida;
+                if (c > num_bits)
+                    goto entrada_insuficiente;
+                k += extension;
+                bits >>= c;
+                num_bits -= c;
             }
-            unsigned int j = ((i - LeerBits(params->bits_diccionario)) & (derived->tam_diccionario - 1));
-            if ((i + k) >= derived->tam_diccionario) {
+            while (num_bits <= 56 && in < in_fin) {
+                bits |= (unsigned long long)*in++ << num_bits;
+                num_bits += 8;
+            }
+            if (num_bits < bits_cubeta)
+                goto entrada_insuficiente;
+            c = (unsigned int)bits & mascara_cubeta;
+            if (c == 0)
+                goto fin;
+            if (c > bits_distancia)
+                goto distancia_no_valida;
+            if (num_bits < bits_cubeta + c - 1)
+                goto entrada_insuficiente;
+            distancia = (1u << (c - 1)) | (unsigned int)((bits >> bits_cubeta) & ((1ULL << (c - 1)) - 1));
+            bits >>= bits_cubeta + c - 1;
+            num_bits -= bits_cubeta + c - 1;
+        } else {
+            if (k == marca_fin)
+                goto fin;
+            if (num_bits < bits_longitud + bits_distancia)
+                goto entrada_insuficiente;
+            distancia = (unsigned int)((bits >> bits_longitud) & mascara_distancia);
+            bits >>= bits_longitud + bits_distancia;
+            num_bits -= bits_longitud + bits_distancia;
+        }
+        if (distancia == 0 || distancia > (unsigned int)(out - output) + ctx->tam_prefijo)
+            goto distancia_no_valida;
+        if (k > (unsigned int)(out_fin - out))
+            goto salida_llena;
+        LZ77_ESTADISTICA(RegistrarToken(&ctx->estadisticas, k, distancia));
+        if (distancia > (unsigned int)(out - output)) {
+            CopiarDesdePrefijo(out, (unsigned int)(out - output), ctx->prefijo, ctx->tam_prefijo, distancia, k);
+            out += k;
+            continue;
+        }
+        do {
+            *out = *(out - distancia);
+            out++;
+        } while (--k);
+    }
+
+fin:
+    ctx->in_pos = input_size;
+    ctx->out_pos = (unsigned int)(out - output);
+    return ctx->out_pos;
+
+entrada_insuficiente:
+    fprintf(stderr, "\nBuffer de entrada insuficiente (descompresión)");
+    return -1;
+salida_llena:
+    fprintf(stderr, "Buffer de salida lleno (descompresión)\n");
+    return -1;
+distancia_no_valida:
+    fprintf(stderr, "Distancia no válida (descompresión)\n");
+    return -1;
+longitud_no_valida:
+    fprintf(stderr, "Longitud no válida (descompresión)\n");
+    return -1;
+}
+
+/* Lector de un carril: como el acumulador de DecodificarConFormato */
+typedef struct LectorCarril {
+    const unsigned char *p, *fin;
+    unsigned long long bits;
+    unsigned int num_bits;
+} LectorCarril;
+
+static inline void IniciarCarril(LectorCarril *l, const unsigned char *p, unsigned int tam) {
+    l->p = p;
+    l->fin = p + tam;
+    l->bits = 0;
+    l->num_bits = 0;
+}
+
+/* Deja al menos 56 bits; el llamante garantiza 8 bytes legibles en p */
+static inline void RecargarCarril(LectorCarril *l) {
+    l->bits |= Leer64(l->p) << l->num_bits;
+    l->p += (63 - l->num_bits) >> 3;
+    l->num_bits |= 56;
+}
+
+/* Byte a byte sin pasar del final del carril */
+static inline void RecargarCarrilSeguro(LectorCarril *l) {
+    while (l->num_bits <= 56 && l->p < l->fin) {
+        l->bits |= (unsigned long long)*l->p++ << l->num_bits;
+        l->num_bits += 8;
+    }
+}
+
+/* Devuelve los bytes completos que cargó RecargarCarril sin consumirlos */
+static inline void DevolverCarril(LectorCarril *l) {
+    l->p -= l->num_bits >> 3;
+    l->num_bits &= 7;
+    l->bits &= (1ULL << l->num_bits) - 1;
+}
+
+static inline void ConsumirCarril(LectorCarril *l, unsigned int n) {
+    l->bits >>= n;
+    l->num_bits -= n;
+}
+
+/*
+ * Descompresión de los tokens en carriles (params.carriles). Los mismos campos que en
+ * DecodificarConFormato, cada uno de su carril: la cadena de dependencias de cada
+ * lector solo incluye los campos de su carril, así que las lecturas de un token se
+ * solapan con las del siguiente. El bucle rápido lee de 8 en 8 bytes (16 en las
+ * rachas de literales) sin mirar el final de cada carril, solo que quede margen en la
+ * entrada: pasarse de un carril solo puede ocurrir con datos corruptos y lee bytes
+ * del siguiente. Cada carril se comprueba antes de empezar un token que lo use, así
+ * que se puede pasar al bucle seguro entre dos tokens cualesquiera.
+ */
+LZ77_EN_LINEA int DecodificarCarrilesConFormato(LZ77Contexto *ctx, const unsigned char *input, unsigned int input_size,
+                                                unsigned char *output, unsigned int output_capacity,
+                                                const FormatoTokens f) {
+    const unsigned int bits_caracter = f.bits_caracter;
+    const unsigned int bits_longitud = 1 + f.bits_coincidencia;
+    const unsigned int bits_distancia = f.bits_diccionario;
+    const unsigned long long mascara_caracter = (1ULL << bits_caracter) - 1;
+    const unsigned long long mascara_longitud = (1ULL << f.bits_coincidencia) - 1;
+    const unsigned long long mascara_distancia = (1ULL << bits_distancia) - 1;
+    const unsigned int longitud_minima = f.umbral + 1;
+    const unsigned int max_coincidencia = (1u << f.bits_coincidencia) + f.umbral - 1;
+    const unsigned int marca_fin = max_coincidencia + 1;
+    const int variables = f.codigos == LZ77_CODIGOS_VARIABLES;
+    const unsigned int bits_cubeta = BitsCubeta(bits_distancia);
+    const unsigned int mascara_cubeta = (1u << bits_cubeta) - 1;
+
+    const unsigned char *in_fin = input + input_size;
+    const unsigned char *in_rapido = input_size >= 16 ? in_fin - 16 : input;
+    unsigned char *out = output, *out_fin = output + output_capacity;
+    unsigned char *out_rapido = output_capacity >= max_coincidencia + LZ77_MARGEN_COPIA ?
+                                out_fin - (max_coincidencia + LZ77_MARGEN_COPIA) : output;
+    LectorCarril control, literales, distancias;
+    unsigned int tam_control, tam_literales, k, distancia, c, extension;
+
+    ctx->in_ptr = input;
+    ctx->in_size = input_size;
+    ctx->out_ptr = output;
+    ctx->out_capacity = output_capacity;
+    ctx->bits_en = 0;
+    ctx->buffer_bits = 0;
+
+    if (input_size < LZ77_CARRILES_CABECERA)
+        goto entrada_insuficiente;
+    tam_control = Leer32(input);
+    tam_literales = Leer32(input + 4);
+    if (tam_control > input_size - LZ77_CARRILES_CABECERA ||
+        tam_literales > input_size - LZ77_CARRILES_CABECERA - tam_control)
+        goto entrada_insuficiente;
+    IniciarCarril(&control, input + LZ77_CARRILES_CABECERA, tam_control);
+    IniciarCarril(&literales, control.fin, tam_literales);
+    IniciarCarril(&distancias, literales.fin, (unsigned int)(in_fin - literales.fin));
+
+    /* Bucle rápido */
+    while (control.p < in_rapido && out < out_rapido) {
+        RecargarCarril(&control);
+
+        if ((control.bits & 1) == 0) {
+            if (literales.p >= in_rapido)
+                break;
+            if (bits_caracter == 8) {
+                /* El carril de literales son los propios bytes: la racha (hasta 16) de una vez */
+                k = (unsigned int)__builtin_ctzll(control.bits | (1ULL << 16));
+                LZ77_ESTADISTICA(ctx->estadisticas.literales += k);
+                memcpy(out, literales.p, 16);
+                out += k;
+                literales.p += k;
+                ConsumirCarril(&control, k);
+                continue;
+            }
+            RecargarCarril(&literales);
+            LZ77_ESTADISTICA(ctx->estadisticas.literales++);
+            *out++ = (unsigned char)(literales.bits & mascara_caracter);
+            ConsumirCarril(&literales, bits_caracter);
+            ConsumirCarril(&control, 1);
+            continue;
+        }
+        k = (unsigned int)((control.bits >> 1) & mascara_longitud) + longitud_minima;
+        if (!variables && k == marca_fin)
+            goto fin;
+        if (distancias.p >= in_rapido)
+            break;
+        ConsumirCarril(&control, bits_longitud);
+        RecargarCarril(&distancias);
+        if (variables) {
+            if (k == marca_fin) {
+                c = DecodificarExtension(control.bits, &extension);
+                if (c == 0)
+                    goto longitud_no_valida;
+                k += extension;
+                ConsumirCarril(&control, c);
+            }
+            c = (unsigned int)distancias.bits & mascara_cubeta;
+            if (c == 0)
+                goto fin;
+            if (c > bits_distancia)
+                goto distancia_no_valida;
+            distancia = (1u << (c - 1)) | (unsigned int)((distancias.bits >> bits_cubeta) & ((1ULL << (c - 1)) - 1));
+            ConsumirCarril(&distancias, bits_cubeta + c - 1);
+            if (k > max_coincidencia) {
+                /* Más larga que el margen del bucle rápido: se comprueba aparte */
+                if (k > (unsigned int)(out_fin - out))
+                    goto salida_llena;
+                LZ77_ESTADISTICA(RegistrarToken(&ctx->estadisticas, k, distancia));
+                if (distancia > (unsigned int)(out - output)) {
+                    if (CopiarDesdePrefijo(out, (unsigned int)(out - output), ctx->prefijo, ctx->tam_prefijo, distancia, k) != 0)
+                        goto distancia_no_valida;
+                    out += k;
+                    continue;
+                }
+                if ((unsigned int)(out_fin - out) >= k + LZ77_MARGEN_COPIA) {
+                    CopiarCoincidencia(out, distancia, k);
+                    out += k;
+                    continue;
+                }
                 do {
-                    diccionario[i++] = diccionario[j++];
-                    j &= (derived->tam_diccionario - 1);
-                    if (i == derived->tam_diccionario) {
-                        if (out_pos + derived->tam_diccionario > out_capacity) {
-                            fprintf(stderr, "Buffer de salida lleno (descompresión)\n");
-                            return -1;
-                        }
-                        memcpy(out_ptr + out_pos, diccionario, derived->tam_diccionario);
-                        out_pos += derived->tam_diccionario;
-                        i = 0;
-                    }
+                    *out = *(out - distancia);
+                    out++;
                 } while (--k);
-            } else {
-                if ((j + k) >= derived->tam_diccionario) {
-                    do {
-                        diccionario[i++] = diccionario[j++];
-                        j &= (derived->tam_diccionario - 1);
-                    } while (--k);
-                } else {
-                    do {
-                        diccionario[i++] = diccionario[j++];
-                    } while (--k);
-                }
+                continue;
             }
+        } else {
+            distancia = (unsigned int)(distancias.bits & mascara_distancia);
+            ConsumirCarril(&distancias, bits_distancia);
+            if (distancia == 0)
+                goto distancia_no_valida;
+        }
+        LZ77_ESTADISTICA(RegistrarToken(&ctx->estadisticas, k, distancia));
+        if (distancia <= (unsigned int)(out - output))
+            CopiarCoincidencia(out, distancia, k);
+        else if (CopiarDesdePrefijo(out, (unsigned int)(out - output), ctx->prefijo, ctx->tam_prefijo, distancia, k) != 0)
+            goto distancia_no_valida;
+        out += k;
+    }
+
+    /* Bucle seguro */
+    DevolverCarril(&control);
+    DevolverCarril(&literales);
+    DevolverCarril(&distancias);
+    for (;;) {
+        RecargarCarrilSeguro(&control);
+        if (control.num_bits < 1)
+            goto entrada_insuficiente;
+
+        if ((control.bits & 1) == 0) {
+            RecargarCarrilSeguro(&literales);
+            if (literales.num_bits < bits_caracter)
+                goto entrada_insuficiente;
+            if (out >= out_fin)
+                goto salida_llena;
+            LZ77_ESTADISTICA(ctx->estadisticas.literales++);
+            *out++ = (unsigned char)(literales.bits & mascara_caracter);
+            ConsumirCarril(&literales, bits_caracter);
+            ConsumirCarril(&control, 1);
+            continue;
+        }
+        if (control.num_bits < bits_longitud)
+            goto entrada_insuficiente;
+        k = (unsigned int)((control.bits >> 1) & mascara_longitud) + longitud_minima;
+        if (!variables && k == marca_fin)
+            goto fin;
+        ConsumirCarril(&control, bits_longitud);
+        RecargarCarrilSeguro(&distancias);
+        if (variables) {
+            if (k == marca_fin) {
+                c = DecodificarExtension(control.bits, &extension);
+                if (c == 0)
+                    goto longitud_no_valida;
+                if (c > control.num_bits)
+                    goto entrada_insuficiente;
+                k += extension;
+                ConsumirCarril(&control, c);
+            }
+            if (distancias.num_bits < bits_cubeta)
+                goto entrada_insuficiente;
+            c = (unsigned int)distancias.bits & mascara_cubeta;
+            if (c == 0)
+                goto fin;
+            if (c > bits_distancia)
+                goto distancia_no_valida;
+            if (distancias.num_bits < bits_cubeta + c - 1)
+                goto entrada_insuficiente;
+            distancia = (1u << (c - 1)) | (unsigned int)((distancias.bits >> bits_cubeta) & ((1ULL << (c - 1)) - 1));
+            ConsumirCarril(&distancias, bits_cubeta + c - 1);
+        } else {
+            if (distancias.num_bits < bits_distancia)
+                goto entrada_insuficiente;
+            distancia = (unsigned int)(distancias.bits & mascara_distancia);
+            ConsumirCarril(&distancias, bits_distancia);
+        }
+        if (distancia == 0 || distancia > (unsigned int)(out - output) + ctx->tam_prefijo)
+            goto distancia_no_valida;
+        if (k > (unsigned int)(out_fin - out))
+            goto salida_llena;
+        LZ77_ESTADISTICA(RegistrarToken(&ctx->estadisticas, k, distancia));
+        if (distancia > (unsigned int)(out - output)) {
+            CopiarDesdePrefijo(out, (unsigned int)(out - output), ctx->prefijo, ctx->tam_prefijo, distancia, k);
+            out += k;
+            continue;
+        }
+        do {
+            *out = *(out - distancia);
+            out++;
+        } while (--k);
+    }
+
+fin:
+    ctx->in_pos = input_size;
+    ctx->out_pos = (unsigned int)(out - output);
+    return ctx->out_pos;
+
+entrada_insuficiente:
+    fprintf(stderr, "\nBuffer de entrada insuficiente (descompresión)");
+    return -1;
+salida_llena:
+    fprintf(stderr, "Buffer de salida lleno (descompresión)\n");
+    return -1;
+distancia_no_valida:
+    fprintf(stderr, "Distancia no válida (descompresión)\n");
+    return -1;
+longitud_no_valida:
+    fprintf(stderr, "Longitud no válida (descompresión)\n");
+    return -1;
+}
+
+LZ77_EN_LINEA int DecodificarFormato(LZ77Contexto *ctx, const unsigned char *input, unsigned int input_size,
+                                     unsigned char *output, unsigned int output_capacity, const FormatoTokens f) {
+    if (f.carriles)
+        return DecodificarCarrilesConFormato(ctx, input, input_size, output, output_capacity, f);
+    return DecodificarConFormato(ctx, input, input_size, output, output_capacity, f);
+}
+
+/*
+ * Núcleos especializados del decodificador para los formatos más comunes: el de
+ * default_params con ventanas de 12 a 16 bits, y el mismo con códigos variables en las
+ * ventanas de 13 y 16 bits; con carriles, las ventanas de 13 y 16 bits con los dos
+ * códigos. Cada llamada busca el suyo por el
+ * formato y, si no hay ninguno, usa la versión genérica. -DLZ77_SIN_NUCLEOS deja solo
+ * la genérica (para comparar).
+ *
+ * El bucle de búsqueda del codificador no se especializa: está dominado por el
+ * recorrido de las cadenas y fijar el formato no lo aceleró de forma medible.
+ */
+typedef struct NucleoLZ77 {
+    FormatoTokens formato;
+    int (*decodificar)(LZ77Contexto *ctx, const unsigned char *input, unsigned int input_size,
+                       unsigned char *output, unsigned int output_capacity);
+} NucleoLZ77;
+
+#define LZ77_NUCLEO(bc, u, bco, bd, cod, car)                                                                     \
+    static int Decodificar_##bc##_##u##_##bco##_##bd##_##cod##_##car(LZ77Contexto *ctx, const unsigned char *input, \
+                                                                     unsigned int input_size, unsigned char *output, \
+                                                                     unsigned int output_capacity) {             \
+        return DecodificarFormato(ctx, input, input_size, output, output_capacity,                                \
+                                  (FormatoTokens){bc, u, bco, bd, cod, car});                                     \
+    }
+#define LZ77_ENTRADA_NUCLEO(bc, u, bco, bd, cod, car) \
+    {{bc, u, bco, bd, cod, car}, Decodificar_##bc##_##u##_##bco##_##bd##_##cod##_##car}
+
+#ifndef LZ77_SIN_NUCLEOS
+LZ77_NUCLEO(8, 2, 4, 12, 0, 0)
+LZ77_NUCLEO(8, 2, 4, 13, 0, 0)
+LZ77_NUCLEO(8, 2, 4, 15, 0, 0)
+LZ77_NUCLEO(8, 2, 4, 16, 0, 0)
+LZ77_NUCLEO(8, 2, 4, 13, 1, 0)
+LZ77_NUCLEO(8, 2, 4, 16, 1, 0)
+LZ77_NUCLEO(8, 2, 4, 13, 0, 1)
+LZ77_NUCLEO(8, 2, 4, 16, 0, 1)
+LZ77_NUCLEO(8, 2, 4, 13, 1, 1)
+LZ77_NUCLEO(8, 2, 4, 16, 1, 1)
+
+static const NucleoLZ77 nucleos[] = {
+    LZ77_ENTRADA_NUCLEO(8, 2, 4, 12, 0, 0),
+    LZ77_ENTRADA_NUCLEO(8, 2, 4, 13, 0, 0),
+    LZ77_ENTRADA_NUCLEO(8, 2, 4, 15, 0, 0),
+    LZ77_ENTRADA_NUCLEO(8, 2, 4, 16, 0, 0),
+    LZ77_ENTRADA_NUCLEO(8, 2, 4, 13, 1, 0),
+    LZ77_ENTRADA_NUCLEO(8, 2, 4, 16, 1, 0),
+    LZ77_ENTRADA_NUCLEO(8, 2, 4, 13, 0, 1),
+    LZ77_ENTRADA_NUCLEO(8, 2, 4, 16, 0, 1),
+    LZ77_ENTRADA_NUCLEO(8, 2, 4, 13, 1, 1),
+    LZ77_ENTRADA_NUCLEO(8, 2, 4, 16, 1, 1),
+};
+#endif
+
+static const NucleoLZ77 *BuscarNucleo(const LZ77Params *params) {
+#ifndef LZ77_SIN_NUCLEOS
+    unsigned int i;
+    for (i = 0; i < sizeof(nucleos) / sizeof(nucleos[0]); i++) {
+        if (nucleos[i].formato.bits_caracter == (unsigned int)params->bits_caracter &&
+            nucleos[i].formato.umbral == (unsigned int)params->umbral &&
+            nucleos[i].formato.bits_coincidencia == (unsigned int)params->bits_coincidencia &&
+            nucleos[i].formato.bits_diccionario == (unsigned int)params->bits_diccionario &&
+            nucleos[i].formato.codigos == (unsigned int)params->codigos &&
+            nucleos[i].formato.carriles == (unsigned int)UsaCarriles(params))
+            return &nucleos[i];
+    }
+#endif
+    return NULL;
+}
+
+static int DecodificarTokensCtx(LZ77Contexto *ctx, const unsigned char *input, unsigned int input_size, unsigned char *output, unsigned int output_capacity) {
+    const NucleoLZ77 *nucleo = BuscarNucleo(&ctx->params);
+    if (nucleo)
+        return nucleo->decodificar(ctx, input, input_size, output, output_capacity);
+    return DecodificarFormato(ctx, input, input_size, output, output_capacity, FormatoDe(&ctx->params));
+}
+
+/* La entrada tal cual tras el byte de modo; a partir de este tamaño se muestrea antes de comprimir */
+#define LZ77_MIN_MUESTREO_ALMACENADO (1u << 16)
+
+static int AlmacenarCtx(LZ77Contexto *ctx, const unsigned char *input, unsigned int input_size, unsigned char *output, unsigned int output_capacity) {
+    if (input_size > output_capacity - 1) {
+        fprintf(stderr, "\nBuffer de salida lleno (compresión)");
+        ctx->error = 1;
+        return -1;
+    }
+    output[0] = LZ77_MODO_ALMACENADO;
+    memcpy(output + 1, input, input_size);
+    ctx->error = 0;
+    ctx->out_ptr = output;
+    ctx->out_capacity = output_capacity;
+    ctx->out_pos = input_size + 1;
+    return ctx->out_pos;
+}
+
+/*
+ * Compresión con etapa de entropía: los tokens se generan primero en el espacio de
+ * trabajo del contexto y después se recodifican sobre la salida; si la recodificación
+ * no los reduce se copian tal cual, y si ni así bajan del tamaño de la entrada se
+ * almacena esta. Las entradas grandes que el muestreo da por incompresibles se
+ * almacenan sin pasar por el buscador.
+ */
+static int CodificarConEntropiaCtx(LZ77Contexto *ctx, const unsigned char *input, unsigned int input_size, unsigned char *output, unsigned int output_capacity) {
+    unsigned long long necesario;
+    int tam_tokens, r;
+
+    if (output_capacity < 1) {
+        fprintf(stderr, "\nBuffer de salida lleno (compresión)");
+        return -1;
+    }
+    if (input_size >= LZ77_MIN_MUESTREO_ALMACENADO && input_size <= output_capacity - 1 &&
+        PareceIncompresible(&ctx->params, input, input_size))
+        return AlmacenarCtx(ctx, input, input_size, output, output_capacity);
+    necesario = CotaCompresion(&ctx->params, input_size) + LZ77_MARGEN_TOKENS;
+    if (necesario > ctx->tam_tokens) {
+        /* La memoria de un contexto de CrearContextoEn no se puede ampliar */
+        unsigned char *tokens = ctx->propietario && necesario <= 0xFFFFFFFFu ?
+                                (unsigned char *)realloc(ctx->tokens, necesario) : NULL;
+        if (!tokens) {
+            /* Sin espacio de trabajo: tokens sin recodificar directamente en la salida */
+            output[0] = LZ77_MODO_TOKENS;
+            r = CodificarTokensCtx(ctx, input, input_size, output + 1, output_capacity - 1);
+            if ((r < 0 || (unsigned int)r >= input_size) && input_size <= output_capacity - 1)
+                return AlmacenarCtx(ctx, input, input_size, output, output_capacity);
+            return r < 0 ? r : r + 1;
+        }
+        ctx->tokens = tokens;
+        ctx->tam_tokens = (unsigned int)necesario;
+    }
+    tam_tokens = CodificarTokensCtx(ctx, input, input_size, ctx->tokens, ctx->tam_tokens);
+    if (tam_tokens < 0)
+        return -1;
+    memset(ctx->tokens + tam_tokens, 0, LZ77_MARGEN_TOKENS);
+
+    output[0] = LZ77_MODO_HUFFMAN;
+    r = CodificarEntropia(ctx, ctx->tokens, output + 1,
+                          output_capacity - 1 < (unsigned int)tam_tokens ? output_capacity - 1 : (unsigned int)tam_tokens);
+    if ((r < 0 || (unsigned int)r >= input_size) && (unsigned int)tam_tokens >= input_size)
+        return AlmacenarCtx(ctx, input, input_size, output, output_capacity);
+    if (r < 0 || r >= tam_tokens) {
+        if ((unsigned int)tam_tokens > output_capacity - 1) {
+            fprintf(stderr, "\nBuffer de salida lleno (compresión)");
+            return -1;
+        }
+        output[0] = LZ77_MODO_TOKENS;
+        memcpy(output + 1, ctx->tokens, tam_tokens);
+        r = tam_tokens;
+    }
+    ctx->out_ptr = output;
+    ctx->out_capacity = output_capacity;
+    ctx->out_pos = (unsigned int)r + 1;
+    return ctx->out_pos;
+}
+
+/* Descompresión con etapa de entropía: el primer byte indica el formato */
+static int DecodificarConEntropiaCtx(LZ77Contexto *ctx, const unsigned char *input, unsigned int input_size, unsigned char *output, unsigned int output_capacity) {
+    if (input_size < 1) {
+        fprintf(stderr, "\nBuffer de entrada insuficiente (descompresión)");
+        return -1;
+    }
+    ctx->in_ptr = input;
+    ctx->in_size = input_size;
+    ctx->out_ptr = output;
+    ctx->out_capacity = output_capacity;
+    if (input[0] == LZ77_MODO_TOKENS)
+        return DecodificarTokensCtx(ctx, input + 1, input_size - 1, output, output_capacity);
+    if (input[0] == LZ77_MODO_HUFFMAN)
+        return DecodificarEntropia(ctx, input + 1, input_size - 1, output, output_capacity);
+    if (input[0] == LZ77_MODO_ALMACENADO) {
+        if (input_size - 1 > output_capacity) {
+            fprintf(stderr, "Buffer de salida lleno (descompresión)\n");
+            return -1;
+        }
+        memcpy(output, input + 1, input_size - 1);
+        return (int)(input_size - 1);
+    }
+    fprintf(stderr, "Modo de entropía no válido (descompresión)\n");
+    return -1;
+}
+
+/* Escritor de un carril para RepartirCarriles; sin out solo cuenta los bits */
+typedef struct EscritorCarril {
+    unsigned long long acumulador, total;
+    unsigned int num_bits;
+    unsigned char *out;
+} EscritorCarril;
+
+static inline void PonerCarril(EscritorCarril *e, unsigned long long valor, unsigned int num_bits) {
+    e->total += num_bits;
+    if (!e->out)
+        return;
+    e->acumulador |= (valor & ((1ULL << num_bits) - 1)) << e->num_bits;
+    e->num_bits += num_bits;
+    while (e->num_bits >= 8) {
+        *e->out++ = (unsigned char)e->acumulador;
+        e->acumulador >>= 8;
+        e->num_bits -= 8;
+    }
+}
+
+/*
+ * Recorre los tokens de un solo flujo (con la marca de fin y LZ77_MARGEN_TOKENS ceros
+ * detrás) y pone cada campo en su carril: 0 control, 1 literales, 2 distancias. Con
+ * códigos fijos la marca de fin se queda en el campo de longitud, sin distancia.
+ */
+static int RecorrerTokens(const LZ77Params *params, const unsigned char *tokens, EscritorCarril *carril) {
+    const unsigned int bits_caracter = params->bits_caracter;
+    const unsigned int bits_longitud = 1 + params->bits_coincidencia;
+    const unsigned int bits_distancia = params->bits_diccionario;
+    const unsigned int bits_cubeta = BitsCubeta(bits_distancia);
+    const unsigned long long todo_unos = (1ULL << params->bits_coincidencia) - 1;
+    const int variables = params->codigos == LZ77_CODIGOS_VARIABLES;
+    const unsigned char *p = tokens;
+    unsigned long long bits = 0, campo;
+    unsigned int num_bits = 0, c, n, extension;
+
+    for (;;) {
+        bits |= Leer64(p) << num_bits;
+        p += (63 - num_bits) >> 3;
+        num_bits |= 56;
+        if ((bits & 1) == 0) {
+            PonerCarril(&carril[0], 0, 1);
+            PonerCarril(&carril[1], bits >> 1, bits_caracter);
+            bits >>= 1 + bits_caracter;
+            num_bits -= 1 + bits_caracter;
+            continue;
         }
+        campo = (bits >> 1) & todo_unos;
+        PonerCarril(&carril[0], bits, bits_longitud);
+        bits >>= bits_longitud;
+        num_bits -= bits_longitud;
+        if (!variables) {
+            if (campo == todo_unos)
+                return 0;
+            PonerCarril(&carril[2], bits, bits_distancia);
+            bits >>= bits_distancia;
+            num_bits -= bits_distancia;
+            continue;
+        }
+        if (campo == todo_unos) {
+            if ((c = DecodificarExtension(bits, &extension)) == 0)
+                return -1;
+            PonerCarril(&carril[0], bits, c);
+            bits >>= c;
+            num_bits -= c;
+        }
+        bits |= Leer64(p) << num_bits;
+        p += (63 - num_bits) >> 3;
+        num_bits |= 56;
+        c = (unsigned int)bits & ((1u << bits_cubeta) - 1);
+        n = bits_cubeta + (c ? c - 1 : 0);
+        PonerCarril(&carril[2], bits, n);
+        bits >>= n;
+        num_bits -= n;
+        if (c == 0)
+            return 0;
     }
 }
 
+/* Escribe los tokens de un solo flujo en carriles: una pasada para medirlos y otra
+ * para escribir cada uno en su sitio */
+static int RepartirCarriles(const LZ77Params *params, const unsigned char *tokens, unsigned char *output,
+                            unsigned int output_capacity) {
+    EscritorCarril carril[LZ77_CARRILES];
+    unsigned long long tam[LZ77_CARRILES], total = LZ77_CARRILES_CABECERA;
+    register unsigned int i;
+
+    memset(carril, 0, sizeof(carril));
+    if (RecorrerTokens(params, tokens, carril) != 0)
+        return -1;
+    for (i = 0; i < LZ77_CARRILES; i++)
+        total += tam[i] = (carril[i].total + 7) / 8;
+    if (total > output_capacity) {
+        fprintf(stderr, "\nBuffer de salida lleno (compresión)");
+        return -1;
+    }
+    Escribir32(output, (unsigned int)tam[0]);
+    Escribir32(output + 4, (unsigned int)tam[1]);
+
+    memset(carril, 0, sizeof(carril));
+    carril[0].out = output + LZ77_CARRILES_CABECERA;
+    for (i = 1; i < LZ77_CARRILES; i++)
+        carril[i].out = carril[i - 1].out + tam[i - 1];
+    RecorrerTokens(params, tokens, carril);
+    for (i = 0; i < LZ77_CARRILES; i++)
+        if (carril[i].num_bits)
+            *carril[i].out = (unsigned char)carril[i].acumulador;
+    return (int)total;
+}
+
+/*
+ * Compresión en carriles: como con la etapa de entropía, los tokens se generan
+ * primero en un solo flujo en el espacio de trabajo del contexto y después se
+ * reparten sobre la salida. Sin espacio de trabajo no hay forma de comprimir.
+ */
+static int CodificarEnCarrilesCtx(LZ77Contexto *ctx, const unsigned char *input, unsigned int input_size, unsigned char *output, unsigned int output_capacity) {
+    unsigned long long necesario = CotaCompresion(&ctx->params, input_size) + LZ77_MARGEN_TOKENS;
+    int tam_tokens, r;
+
+    if (necesario > ctx->tam_tokens) {
+        unsigned char *tokens = ctx->propietario && necesario <= 0xFFFFFFFFu ?
+                                (unsigned char *)realloc(ctx->tokens, necesario) : NULL;
+        if (!tokens) {
+            fprintf(stderr, "\nSin espacio para los tokens (carriles)");
+            ctx->error = 1;
+            return -1;
+        }
+        ctx->tokens = tokens;
+        ctx->tam_tokens = (unsigned int)necesario;
+    }
+    tam_tokens = CodificarTokensCtx(ctx, input, input_size, ctx->tokens, ctx->tam_tokens);
+    if (tam_tokens < 0)
+        return -1;
+    memset(ctx->tokens + tam_tokens, 0, LZ77_MARGEN_TOKENS);
+
+    r = RepartirCarriles(&ctx->params, ctx->tokens, output, output_capacity);
+    if (r < 0) {
+        ctx->error = 1;
+        return -1;
+    }
+    ctx->out_ptr = output;
+    ctx->out_capacity = output_capacity;
+    ctx->out_pos = (unsigned int)r;
+    return r;
+}
+
+/* Compresión en memoria */
+int CodificarBufferCtx(LZ77Contexto *ctx, const unsigned char *input, unsigned int input_size, unsigned char *output, unsigned int output_capacity) {
+    int r;
+    if (!ctx->hash) {
+        fprintf(stderr, "Contexto solo de descompresión (compresión)\n");
+        return -1;
+    }
+    LZ77_ESTADISTICA(ReiniciarEstadisticasCtx(ctx));
+    LZ77_CRONOMETRAR(ctx, ns_total, r = ctx->params.entropia != LZ77_ENTROPIA_NINGUNA ?
+                     CodificarConEntropiaCtx(ctx, input, input_size, output, output_capacity) :
+                     ctx->params.carriles ? CodificarEnCarrilesCtx(ctx, input, input_size, output, output_capacity) :
+                     CodificarTokensCtx(ctx, input, input_size, output, output_capacity));
+    return r;
+}
+
+/* Descompresión en memoria */
+int DecodificarBufferCtx(LZ77Contexto *ctx, const unsigned char *input, unsigned int input_size, unsigned char *output, unsigned int output_capacity) {
+    int r;
+    LZ77_ESTADISTICA(ReiniciarEstadisticasCtx(ctx));
+    LZ77_CRONOMETRAR(ctx, ns_total, r = ctx->params.entropia == LZ77_ENTROPIA_NINGUNA ?
+                     DecodificarTokensCtx(ctx, input, input_size, output, output_capacity) :
+                     DecodificarConEntropiaCtx(ctx, input, input_size, output, output_capacity));
+    return r;
+}
+
+#ifdef LZ77_ESTADISTICAS
+const LZ77Estadisticas *EstadisticasCtx(const LZ77Contexto *ctx) {
+    return &ctx->estadisticas;
+}
+
+void ReiniciarEstadisticasCtx(LZ77Contexto *ctx) {
+    memset(&ctx->estadisticas, 0, sizeof(ctx->estadisticas));
+}
+#endif
+
+/*
+ * API clásica: cada función construye un contexto temporal que apunta a las
+ * estructuras globales y vuelca el estado modificado al terminar.
+ */
+static void ContextoDesdeGlobales(LZ77Contexto *ctx, const LZ77Params *params, const DerivedParams *derived) {
+    memset(ctx, 0, sizeof(*ctx));
+    if (params)
+        ctx->params = *params;
+    /* Las estructuras globales solo contienen las tablas de la cadena hash */
+    ctx->params.buscador = LZ77_BUSCADOR_CADENA;
+    ctx->params.entropia = LZ77_ENTROPIA_NINGUNA;
+    ctx->params.carriles = 0;
+    if (derived)
+        ctx->derived = *derived;
+    ctx->diccionario = diccionario;
+    ctx->hash = hash;
+    ctx->siguiente_enlace = siguiente_enlace;
+    ctx->longitud_coincidencia = longitud_coincidencia;
+    ctx->posicion_coincidencia = posicion_coincidencia;
+    ctx->buffer_bits = buffer_bits;
+    ctx->bits_en = bits_en;
+    ctx->in_ptr = in_ptr;
+    ctx->in_size = in_size;
+    ctx->in_pos = in_pos;
+    ctx->out_ptr = out_ptr;
+    ctx->out_capacity = out_capacity;
+    ctx->out_pos = out_pos;
+    ctx->base = base_ventana;
+    ctx->limite = limite_ventana;
+}
+
+static void ContextoAGlobales(const LZ77Contexto *ctx) {
+    longitud_coincidencia = ctx->longitud_coincidencia;
+    posicion_coincidencia = ctx->posicion_coincidencia;
+    buffer_bits = ctx->buffer_bits;
+    bits_en = ctx->bits_en;
+    in_ptr = ctx->in_ptr;
+    in_size = ctx->in_size;
+    in_pos = ctx->in_pos;
+    out_ptr = ctx->out_ptr;
+    out_capacity = ctx->out_capacity;
+    out_pos = ctx->out_pos;
+    base_ventana = ctx->base;
+    limite_ventana = ctx->limite;
+}
+
+void EnviarBits(unsigned int bits, unsigned int num_bits) {
+    LZ77Contexto ctx;
+    ContextoDesdeGlobales(&ctx, NULL, NULL);
+    EnviarBitsCtx(&ctx, bits, num_bits);
+    ContextoAGlobales(&ctx);
+}
+unsigned int LeerBits(unsigned int num_bits) {
+    LZ77Contexto ctx;
+    unsigned int r;
+    ContextoDesdeGlobales(&ctx, NULL, NULL);
+    r = LeerBitsCtx(&ctx, num_bits);
+    ContextoAGlobales(&ctx);
+    return r;
+}
+void EnviarCoincidencia(const LZ77Params *params, const DerivedParams *derived, unsigned int longitud, unsigned int distancia) {
+    LZ77Contexto ctx;
+    ContextoDesdeGlobales(&ctx, params, derived);
+    EnviarCoincidenciaCtx(&ctx, longitud, distancia);
+    ContextoAGlobales(&ctx);
+}
+void EnviarCaracter(const LZ77Params *params, unsigned int caracter) {
+    LZ77Contexto ctx;
+    ContextoDesdeGlobales(&ctx, params, NULL);
+    EnviarCaracterCtx(&ctx, caracter);
+    ContextoAGlobales(&ctx);
+}
+void InicializarCodificacion(const DerivedParams *derived) {
+    LZ77Contexto ctx;
+    ContextoDesdeGlobales(&ctx, NULL, derived);
+    InicializarCodificacionCtx(&ctx);
+    ContextoAGlobales(&ctx);
+}
+unsigned int CargarDiccionario(const LZ77Params *params, const DerivedParams *derived, unsigned int posicion) {
+    LZ77Contexto ctx;
+    unsigned int r;
+    ContextoDesdeGlobales(&ctx, params, derived);
+    r = CargarDiccionarioCtx(&ctx, posicion);
+    ContextoAGlobales(&ctx);
+    return r;
+}
+void EliminarDatos(const DerivedParams *derived, unsigned int posicion) {
+    LZ77Contexto ctx;
+    ContextoDesdeGlobales(&ctx, NULL, derived);
+    EliminarDatosCtx(&ctx, posicion);
+    ContextoAGlobales(&ctx);
+}
+void HashearDatos(const LZ77Params *params, const DerivedParams *derived, unsigned int posicion, unsigned int bytes_a_hashear) {
+    LZ77Contexto ctx;
+    ContextoDesdeGlobales(&ctx, params, derived);
+    HashearDatosCtx(&ctx, posicion, bytes_a_hashear);
+}
+void EncontrarCoincidencia(const LZ77Params *params, const DerivedParams *derived, unsigned int posicion, unsigned int longitud_inicial) {
+    LZ77Contexto ctx;
+    ContextoDesdeGlobales(&ctx, params, derived);
+    EncontrarCoincidenciaCtx(&ctx, posicion, longitud_inicial);
+    ContextoAGlobales(&ctx);
+}
+void BuscarEnDiccionario(const LZ77Params *params, const DerivedParams *derived, unsigned int posicion, unsigned int bytes_a_comprimir) {
+    LZ77Contexto ctx;
+    ContextoDesdeGlobales(&ctx, params, derived);
+    BuscarEnDiccionarioCtx(&ctx, posicion, bytes_a_comprimir);
+    ContextoAGlobales(&ctx);
+}
+int CodificarBuffer(const LZ77Params *params, const DerivedParams *derived, const unsigned char *input, unsigned int input_size, unsigned char *output, unsigned int output_capacity) {
+    LZ77Contexto ctx;
+    int r;
+    ContextoDesdeGlobales(&ctx, params, derived);
+    r = CodificarBufferCtx(&ctx, input, input_size, output, output_capacity);
+    ContextoAGlobales(&ctx);
+    return r;
+}
+int DecodificarBuffer(const LZ77Params *params, const DerivedParams *derived, const unsigned char *input, unsigned int input_size, unsigned char *output, unsigned int output_capacity) {
+    LZ77Contexto ctx;
+    int r;
+    ContextoDesdeGlobales(&ctx, params, derived);
+    r = DecodificarBufferCtx(&ctx, input, input_size, output, output_capacity);
+    ContextoAGlobales(&ctx);
+    return r;
+}
+
 
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,218 @@
+/* Ajuste automático de los parámetros de formato a partir de la entrada */
+
+#ifndef LZ77_AJUSTE_C
+#define LZ77_AJUSTE_C
+#include "lz77.h"
+#include "lz77_interno.h"
+
+/*
+ * Se recorre una muestra del principio de la entrada con un buscador voraz de una
+ * sola sonda (clave de 3 bytes) y se anotan las coincidencias en un histograma por
+ * longitud y bits de distancia. Después se estima el coste en bits de cada formato
+ * candidato: una coincidencia fuera de la ventana, o más corta que umbral + 1, se
+ * paga como literales y una más larga que max_coincidencia se parte en varias. Con
+ * códigos variables la distancia cuesta la cubeta y sus bits, y la longitud no se
+ * parte: a partir del escape se añaden los grupos de la extensión.
+ */
+#define LZ77_AJUSTE_MUESTRA        (1u << 17)
+#define LZ77_AJUSTE_BITS_HASH      15
+#define LZ77_AJUSTE_MAX_LONGITUD   512
+#define LZ77_AJUSTE_MIN_DICCIONARIO 10
+#define LZ77_AJUSTE_MAX_DICCIONARIO 17
+#define LZ77_AJUSTE_MAX_COINCIDENCIA 8
+
+/* Un formato solo se prefiere a otro con menos bits_diccionario si ahorra más de 1/50:
+ * una ventana mayor alarga las cadenas hash y frena al codificador */
+#define LZ77_AJUSTE_TOLERANCIA     50
+
+typedef struct Histograma {
+    /* cuentas[longitud][bits de la distancia]; la última longitud agrupa las mayores */
+    unsigned int cuentas[LZ77_AJUSTE_MAX_LONGITUD + 1][LZ77_AJUSTE_MAX_DICCIONARIO + 1];
+    unsigned long long literales;
+} Histograma;
+
+static unsigned int BitsNecesarios(unsigned int v) {
+    return v ? 32 - __builtin_clz(v) : 1;
+}
+
+static void Muestrear(const unsigned char *datos, unsigned int tam, unsigned int *tabla, unsigned int bits_tabla, Histograma *h) {
+    unsigned int i = 0, j;
+    memset(tabla, 0xFF, (1u << bits_tabla) * sizeof(unsigned int));
+    while (i + 3 <= tam) {
+        unsigned int clave = ((unsigned int)datos[i] | ((unsigned int)datos[i + 1] << 8) | ((unsigned int)datos[i + 2] << 16));
+        unsigned int k = (clave * 2654435761u) >> (32 - bits_tabla);
+        unsigned int candidato = tabla[k], longitud = 0;
+        tabla[k] = i;
+        if (candidato != 0xFFFFFFFFu) {
+            unsigned int max = tam - i < LZ77_AJUSTE_MAX_LONGITUD ? tam - i : LZ77_AJUSTE_MAX_LONGITUD;
+            longitud = LongitudComun(datos + candidato, datos + i, max);
+        }
+        if (longitud < 3) {
+            h->literales++;
+            i++;
+            continue;
+        }
+        h->cuentas[longitud][BitsNecesarios(i - candidato)]++;
+        for (j = 1; j < longitud && i + j + 3 <= tam; j++) {
+            const unsigned char *p = datos + i + j;
+            tabla[(((unsigned int)p[0] | ((unsigned int)p[1] << 8) | ((unsigned int)p[2] << 16)) * 2654435761u) >>
+                  (32 - bits_tabla)] = i + j;
+        }
+        i += longitud;
+    }
+    h->literales += tam - i;
+}
+
+/* Coste estimado en bits de la muestra con un formato */
+static unsigned long long Coste(const Histograma *h, unsigned int bits_caracter, unsigned int umbral,
+                                unsigned int bits_coincidencia, unsigned int bits_diccionario, int codigos) {
+    const unsigned long long literal = 1 + bits_caracter, token = 1 + bits_coincidencia + bits_diccionario;
+    const unsigned int max_coincidencia = (1u << bits_coincidencia) + umbral - 1;
+    const unsigned int escape = max_coincidencia + 1, bits_cubeta = BitsCubeta(bits_diccionario);
+    unsigned long long coste = h->literales * literal;
+    unsigned int l, d;
+    for (l = 3; l <= LZ77_AJUSTE_MAX_LONGITUD; l++) {
+        for (d = 0; d <= LZ77_AJUSTE_MAX_DICCIONARIO; d++) {
+            unsigned long long n = h->cuentas[l][d], resto;
+            if (!n)
+                continue;
+            if (d > bits_diccionario || l <= umbral) {
+                coste += n * l * literal;
+                continue;
+            }
+            if (codigos == LZ77_CODIGOS_VARIABLES) {
+                unsigned int grupos = l < escape ? 0 : l - escape < 128 ? 1 : 2;
+                coste += n * (bits_coincidencia + bits_cubeta + d + 8 * grupos);
+                continue;
+            }
+            resto = l % max_coincidencia;
+            coste += n * ((l / max_coincidencia) * token + (resto > umbral ? token : resto * literal));
+        }
+    }
+    return coste;
+}
+
+void AjustarParametros(LZ77Params *params, const unsigned char *datos, size_t tam) {
+    unsigned int tam_muestra = tam < LZ77_AJUSTE_MUESTRA ? (unsigned int)tam : LZ77_AJUSTE_MUESTRA;
+    unsigned int max_diccionario = LZ77_AJUSTE_MAX_DICCIONARIO, umbral, bc, bd, mejor_bd = 0;
+    unsigned long long coste, minimo = ~0ULL, costes[LZ77_AJUSTE_MAX_DICCIONARIO + 1];
+    unsigned int mejores[LZ77_AJUSTE_MAX_DICCIONARIO + 1][2];
+    unsigned int *tabla;
+    Histograma *h;
+    unsigned char todos = 0;
+    size_t i;
+
+    /* bits_caracter debe cubrir todos los bytes, no solo los de la muestra */
+    for (i = 0; i < tam; i++)
+        todos |= datos[i];
+    params->bits_caracter = (int)BitsNecesarios(todos);
+
+    tabla = (unsigned int *)malloc((1u << LZ77_AJUSTE_BITS_HASH) * sizeof(unsigned int));
+    h = (Histograma *)calloc(1, sizeof(Histograma));
+    if (!tabla || !h || tam_muestra < 3) {
+        free(tabla);
+        free(h);
+        return;                         /* Se quedan los demás campos como estaban */
+    }
+    Muestrear(datos, tam_muestra, tabla, LZ77_AJUSTE_BITS_HASH, h);
+
+    /* La ventana no necesita ser mayor que la muestra (ni que la entrada) */
+    while (max_diccionario > LZ77_AJUSTE_MIN_DICCIONARIO && (1u << (max_diccionario - 1)) >= tam_muestra)
+        max_diccionario--;
+    for (bd = LZ77_AJUSTE_MIN_DICCIONARIO; bd <= max_diccionario; bd++) {
+        costes[bd] = ~0ULL;
+        for (umbral = 2; umbral <= 3; umbral++) {
+            for (bc = 2; bc <= LZ77_AJUSTE_MAX_COINCIDENCIA; bc++) {
+                coste = Coste(h, params->bits_caracter, umbral, bc, bd, params->codigos);
+                if (coste < costes[bd]) {
+                    costes[bd] = coste;
+                    mejores[bd][0] = umbral;
+                    mejores[bd][1] = bc;
+                }
+            }
+        }
+        if (costes[bd] < minimo)
+            minimo = costes[bd];
+    }
+    /* La ventana más pequeña que quede cerca del mínimo: menos memoria y más velocidad */
+    for (bd = LZ77_AJUSTE_MIN_DICCIONARIO; bd <= max_diccionario; bd++) {
+        if (costes[bd] <= minimo + minimo / LZ77_AJUSTE_TOLERANCIA) {
+            mejor_bd = bd;
+            break;
+        }
+    }
+    params->umbral = (int)mejores[mejor_bd][0];
+    params->bits_coincidencia = (int)mejores[mejor_bd][1];
+    params->bits_diccionario = (int)mejor_bd;
+    if (params->bit_sector > params->bits_diccionario - 2)
+        params->bit_sector = params->bits_diccionario - 2;
+    free(tabla);
+    free(h);
+}
+
+/*
+ * Detección de datos incompresibles: se miran varios trozos repartidos por la entrada
+ * y basta con que uno parezca compresible para descartarlo. Un trozo es incompresible
+ * si con el formato de params los tokens no bajan de 8 bits por byte y, cuando hay
+ * etapa de entropía, la entropía de orden 0 de sus bytes tampoco baja del umbral.
+ */
+#define LZ77_INCOMPRESIBLE_TROZO     (1u << 13)
+#define LZ77_INCOMPRESIBLE_TROZOS    4
+#define LZ77_INCOMPRESIBLE_BITS_HASH 13
+#define LZ77_INCOMPRESIBLE_ENTROPIA  (31u << 14)   /* 7,75 bits por byte en Q16 */
+
+/* log2 en coma fija Q16 con la mantisa interpolada linealmente (error < 0,09) */
+static unsigned int Log2Q16(unsigned int v) {
+    unsigned int e = 31 - __builtin_clz(v);
+    return (e << 16) | (((v << (31 - e)) & 0x7FFFFFFFu) >> 15);
+}
+
+static int TrozoCompresible(const LZ77Params *params, const unsigned char *datos, unsigned int tam,
+                            unsigned int *tabla, Histograma *h) {
+    unsigned int cuentas[256] = {0}, i;
+    unsigned long long bits = 0;
+
+    memset(h, 0, sizeof(Histograma));
+    Muestrear(datos, tam, tabla, LZ77_INCOMPRESIBLE_BITS_HASH, h);
+    if (Coste(h, params->bits_caracter, params->umbral, params->bits_coincidencia, params->bits_diccionario,
+              params->codigos) <
+        8ULL * tam)
+        return 1;
+    if (params->entropia == LZ77_ENTROPIA_NINGUNA)
+        return 0;
+    for (i = 0; i < tam; i++)
+        cuentas[datos[i]]++;
+    for (i = 0; i < 256; i++) {
+        if (cuentas[i])
+            bits += (unsigned long long)cuentas[i] * (Log2Q16(tam) - Log2Q16(cuentas[i]));
+    }
+    return bits < (unsigned long long)LZ77_INCOMPRESIBLE_ENTROPIA * tam;
+}
+
+int PareceIncompresible(const LZ77Params *params, const unsigned char *datos, size_t tam) {
+    unsigned int trozo = tam < LZ77_INCOMPRESIBLE_TROZO ? (unsigned int)tam : LZ77_INCOMPRESIBLE_TROZO;
+    unsigned int n = (unsigned int)(tam / LZ77_INCOMPRESIBLE_TROZO), k;
+    unsigned int *tabla;
+    Histograma *h;
+    int incompresible = 1;
+
+    if (trozo < 3)
+        return 0;
+    if (n > LZ77_INCOMPRESIBLE_TROZOS)
+        n = LZ77_INCOMPRESIBLE_TROZOS;
+    if (n == 0)
+        n = 1;
+    tabla = (unsigned int *)malloc((1u << LZ77_INCOMPRESIBLE_BITS_HASH) * sizeof(unsigned int));
+    h = (Histograma *)malloc(sizeof(Histograma));
+    if (!tabla || !h)
+        incompresible = 0;
+    for (k = 0; incompresible && k < n; k++) {
+        size_t inicio = n > 1 ? (tam - trozo) / (n - 1) * k : 0;
+        incompresible = !TrozoCompresible(params, datos + inicio, trozo, tabla, h);
+    }
+    free(tabla);
+    free(h);
+    return incompresible;
+}
+
+#endif
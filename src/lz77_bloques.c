@@ -0,0 +1,440 @@
+/* Compresión/descompresión por bloques independientes en paralelo */
+
+#ifndef LZ77_BLOQUES_C
+#define LZ77_BLOQUES_C
+#include "lz77_bloques.h"
+#include "lz77_hilos.h"
+#include "lz77_interno.h"
+
+static unsigned int NumeroBloques(size_t input_size, unsigned int tam_bloque) {
+    return (unsigned int)((input_size + tam_bloque - 1) / tam_bloque);
+}
+
+/*
+ * Tamaño máximo de los datos de un bloque. Con autoajuste vale el formato más caro
+ * que puede elegir AjustarParametros (umbral >= 2 y como mucho 8 + 8 + 17 bits por
+ * coincidencia, más la cubeta con códigos variables), que se conserva en peor.
+ */
+static size_t CotaBloque(const LZ77Params *params, unsigned int tam_bloque) {
+    LZ77Params peor = *params;
+    if (!params->autoajuste)
+        return (size_t)CotaCompresion(params, tam_bloque);
+    peor.bits_caracter = 8;
+    peor.umbral = 2;
+    peor.bits_coincidencia = 8;
+    peor.bits_diccionario = 17;
+    return LZ77_BLOQUES_FORMATO + (size_t)CotaCompresion(&peor, tam_bloque);
+}
+
+size_t CotaBloques(const LZ77Params *params, size_t input_size, unsigned int tam_bloque) {
+    if (tam_bloque == 0)
+        tam_bloque = LZ77_BLOQUE_POR_DEFECTO;
+    /* Incluye el índice, aunque solo lo escriba CodificarBloquesIndexados */
+    return LZ77_BLOQUES_CABECERA + LZ77_BLOQUES_PIE +
+           (size_t)NumeroBloques(input_size, tam_bloque) * (LZ77_BLOQUES_CABECERA_BLOQUE + 8 + CotaBloque(params, tam_bloque));
+}
+
+/* Estado compartido por las tareas de compresión/descompresión */
+typedef struct TrabajoBloques {
+    LZ77Contexto **contextos;   /* Un contexto por hilo, creado bajo demanda */
+    LZ77Params params;
+    const unsigned char *input;
+    size_t tam_datos;           /* Tamaño total sin comprimir */
+    unsigned char *output;
+    unsigned int tam_bloque;
+    unsigned int num_bloques;
+    size_t tam_hueco;           /* Compresión: tamaño reservado a cada bloque */
+    /* Descompresión: la tarea i es el bloque primero + i y output recibe los bytes
+     * [inicio, fin) de los datos originales */
+    unsigned int primero;
+    unsigned long long inicio, fin;
+    size_t *desplazamientos;    /* Inicio de los datos de cada bloque */
+    unsigned int *tam_comprimidos;
+    unsigned char **temporales; /* Un bloque por hilo para los bloques cubiertos en parte */
+    int autoajuste;             /* Cada bloque empieza con su formato */
+    int almacenados;            /* Los bloques con tam_comprimido == tam_original van sin comprimir */
+    int hilos_por_bloque;       /* Compresión: los que sobran con pocos bloques (EstablecerHilosCtx) */
+} TrabajoBloques;
+
+/* Contexto del hilo para params; con autoajuste se vuelve a crear si cambia el formato.
+ * Para descomprimir basta uno sin tablas */
+static LZ77Contexto *ContextoDelHilo(TrabajoBloques *t, unsigned int hilo, const LZ77Params *params, int codificando) {
+    LZ77Contexto *ctx = t->contextos[hilo];
+    if (ctx && memcmp(&ctx->params, params, sizeof(LZ77Params)) == 0)
+        return ctx;
+    DestruirContexto(ctx);
+    return t->contextos[hilo] = codificando ? CrearContexto(params) : CrearContextoDecodificacion(params);
+}
+
+static unsigned int TamanoBloque(const TrabajoBloques *t, unsigned int bloque) {
+    size_t inicio = (size_t)bloque * t->tam_bloque;
+    return (unsigned int)(t->tam_datos - inicio < t->tam_bloque ? t->tam_datos - inicio : t->tam_bloque);
+}
+
+/* Lee y valida los 4 bytes de formato (bits_caracter, umbral, bits_coincidencia, bits_diccionario) */
+static int LeerFormato(const unsigned char *p, LZ77Params *params) {
+    params->bits_caracter = p[0];
+    params->umbral = p[1];
+    params->bits_coincidencia = p[2];
+    params->bits_diccionario = p[3];
+    params->bit_sector = params->bits_diccionario;
+    if (params->bits_caracter < 1 || params->bits_caracter > 16 || params->umbral < 1 ||
+        params->bits_coincidencia < 1 || params->bits_coincidencia > 16 ||
+        params->bits_diccionario < 1 || params->bits_diccionario > LZ77_MAX_BITS_DICCIONARIO)
+        return -1;
+    return 0;
+}
+
+static int ComprimirBloque(void *datos, unsigned int hilo, unsigned int bloque) {
+    TrabajoBloques *t = (TrabajoBloques *)datos;
+    const unsigned char *entrada = t->input + (size_t)bloque * t->tam_bloque;
+    unsigned int tam = TamanoBloque(t, bloque), formato = 0;
+    unsigned char *hueco = t->output + LZ77_BLOQUES_CABECERA + (size_t)bloque * t->tam_hueco;
+    LZ77Params params = t->params;
+    LZ77Contexto *ctx;
+    int r;
+
+    if (PareceIncompresible(&params, entrada, tam))
+        goto almacenar;
+    if (params.autoajuste) {
+        AjustarParametros(&params, entrada, tam);
+        hueco[LZ77_BLOQUES_CABECERA_BLOQUE] = (unsigned char)params.bits_caracter;
+        hueco[LZ77_BLOQUES_CABECERA_BLOQUE + 1] = (unsigned char)params.umbral;
+        hueco[LZ77_BLOQUES_CABECERA_BLOQUE + 2] = (unsigned char)params.bits_coincidencia;
+        hueco[LZ77_BLOQUES_CABECERA_BLOQUE + 3] = (unsigned char)params.bits_diccionario;
+        formato = LZ77_BLOQUES_FORMATO;
+    }
+    if (!(ctx = ContextoDelHilo(t, hilo, &params, 1)))
+        return -1;
+    EstablecerHilosCtx(ctx, t->hilos_por_bloque);
+    r = CodificarBufferCtx(ctx, entrada, tam, hueco + LZ77_BLOQUES_CABECERA_BLOQUE + formato,
+                           (unsigned int)(t->tam_hueco - LZ77_BLOQUES_CABECERA_BLOQUE - formato));
+    if (r < 0)
+        return -1;
+    r += formato;
+    if ((unsigned int)r >= tam) {
+almacenar:
+        /* tam_comprimido == tam_original identifica al bloque almacenado */
+        memcpy(hueco + LZ77_BLOQUES_CABECERA_BLOQUE, entrada, tam);
+        r = (int)tam;
+    }
+    Escribir32(hueco, (unsigned int)r);
+    Escribir32(hueco + 4, tam);
+    t->tam_comprimidos[bloque] = (unsigned int)r;
+    return 0;
+}
+
+static int DescomprimirBloque(void *datos, unsigned int hilo, unsigned int tarea) {
+    TrabajoBloques *t = (TrabajoBloques *)datos;
+    const unsigned char *entrada = t->input + t->desplazamientos[tarea];
+    unsigned int tam_comprimido = t->tam_comprimidos[tarea];
+    LZ77Params params = t->params;
+    LZ77Contexto *ctx;
+    unsigned int bloque = t->primero + tarea;
+    unsigned int tam = TamanoBloque(t, bloque);
+    unsigned long long origen = (unsigned long long)bloque * t->tam_bloque;
+    unsigned long long desde = origen > t->inicio ? origen : t->inicio;
+    unsigned long long hasta = origen + tam < t->fin ? origen + tam : t->fin;
+    unsigned char *destino = t->output + (desde - t->inicio);
+    int r;
+
+    if (t->almacenados && tam_comprimido == tam) {
+        memcpy(destino, entrada + (desde - origen), (size_t)(hasta - desde));
+        return 0;
+    }
+    if (t->autoajuste) {
+        if (tam_comprimido < LZ77_BLOQUES_FORMATO || LeerFormato(entrada, &params) != 0)
+            return -1;
+        entrada += LZ77_BLOQUES_FORMATO;
+        tam_comprimido -= LZ77_BLOQUES_FORMATO;
+    }
+    if (!(ctx = ContextoDelHilo(t, hilo, &params, 0)))
+        return -1;
+    if (desde == origen && hasta == origen + tam) {
+        r = DecodificarBufferCtx(ctx, entrada, tam_comprimido, destino, tam);
+        return r == (int)tam ? 0 : -1;
+    }
+    /* Bloque cubierto en parte: se descomprime entero aparte y se copia el trozo */
+    if (!t->temporales[hilo] && !(t->temporales[hilo] = (unsigned char *)malloc(t->tam_bloque)))
+        return -1;
+    r = DecodificarBufferCtx(ctx, entrada, tam_comprimido, t->temporales[hilo], tam);
+    if (r != (int)tam)
+        return -1;
+    memcpy(destino, t->temporales[hilo] + (desde - origen), (size_t)(hasta - desde));
+    return 0;
+}
+
+static void LiberarContextos(LZ77Contexto **contextos, int num_hilos) {
+    int i;
+    if (!contextos)
+        return;
+    for (i = 0; i < num_hilos; i++)
+        DestruirContexto(contextos[i]);
+    free(contextos);
+}
+
+static void LiberarTemporales(unsigned char **temporales, int num_hilos) {
+    int i;
+    if (!temporales)
+        return;
+    for (i = 0; i < num_hilos; i++)
+        free(temporales[i]);
+    free(temporales);
+}
+
+static long long Codificar(const LZ77Params *params, const unsigned char *input, size_t input_size,
+                           unsigned char *output, size_t output_capacity, unsigned int tam_bloque, int num_hilos, int indice);
+
+long long CodificarBloques(const LZ77Params *params, const unsigned char *input, size_t input_size,
+                           unsigned char *output, size_t output_capacity, unsigned int tam_bloque, int num_hilos) {
+    return Codificar(params, input, input_size, output, output_capacity, tam_bloque, num_hilos, 0);
+}
+
+long long CodificarBloquesIndexados(const LZ77Params *params, const unsigned char *input, size_t input_size,
+                                    unsigned char *output, size_t output_capacity, unsigned int tam_bloque, int num_hilos) {
+    return Codificar(params, input, input_size, output, output_capacity, tam_bloque, num_hilos, 1);
+}
+
+static long long Codificar(const LZ77Params *params, const unsigned char *input, size_t input_size,
+                           unsigned char *output, size_t output_capacity, unsigned int tam_bloque, int num_hilos, int indice) {
+    TrabajoBloques t;
+    register unsigned int i;
+    size_t pos;
+    int r, almacenados = 0;
+
+    if (tam_bloque == 0)
+        tam_bloque = LZ77_BLOQUE_POR_DEFECTO;
+    if (tam_bloque < LZ77_BLOQUE_MINIMO || tam_bloque > LZ77_BLOQUE_MAXIMO || output_capacity < CotaBloques(params, input_size, tam_bloque)) {
+        fprintf(stderr, "Buffer de salida insuficiente o tamaño de bloque no válido (bloques)\n");
+        return -1;
+    }
+
+    memset(&t, 0, sizeof(t));
+    t.params = *params;
+    t.input = input;
+    t.tam_datos = input_size;
+    t.output = output;
+    t.tam_bloque = tam_bloque;
+    t.num_bloques = NumeroBloques(input_size, tam_bloque);
+    t.tam_hueco = LZ77_BLOQUES_CABECERA_BLOQUE + CotaBloque(params, tam_bloque);
+
+    t.hilos_por_bloque = LZ77HilosEfectivos(num_hilos, 0);
+    num_hilos = LZ77HilosEfectivos(num_hilos, t.num_bloques);
+    t.hilos_por_bloque /= num_hilos;
+    t.contextos = (LZ77Contexto **)calloc(num_hilos, sizeof(LZ77Contexto *));
+    t.tam_comprimidos = (unsigned int *)malloc((t.num_bloques + 1) * sizeof(unsigned int));
+    if (!t.contextos || !t.tam_comprimidos) {
+        free(t.contextos);
+        free(t.tam_comprimidos);
+        return -1;
+    }
+
+    r = LZ77EjecutarParalelo(num_hilos, t.num_bloques, ComprimirBloque, &t);
+    LiberarContextos(t.contextos, num_hilos);
+    if (r != 0) {
+        free(t.tam_comprimidos);
+        return -1;
+    }
+
+    for (i = 0; i < t.num_bloques; i++)
+        almacenados |= t.tam_comprimidos[i] == TamanoBloque(&t, i);
+
+    /* Cabecera del contenedor */
+    memcpy(output, LZ77_BLOQUES_MAGIA, 4);
+    output[4] = LZ77_BLOQUES_VERSION;
+    output[5] = (params->entropia != LZ77_ENTROPIA_NINGUNA ? LZ77_BLOQUES_ENTROPIA : 0) |
+                (indice ? LZ77_BLOQUES_INDICE : 0) | (params->autoajuste ? LZ77_BLOQUES_AUTOAJUSTE : 0) |
+                (almacenados ? LZ77_BLOQUES_ALMACENADOS : 0) |
+                (params->codigos == LZ77_CODIGOS_VARIABLES ? LZ77_BLOQUES_VARIABLES : 0) |
+                (params->carriles && params->entropia == LZ77_ENTROPIA_NINGUNA ? LZ77_BLOQUES_CARRILES : 0);
+    output[6] = (unsigned char)params->bits_caracter;
+    output[7] = (unsigned char)params->umbral;
+    output[8] = (unsigned char)params->bits_coincidencia;
+    output[9] = (unsigned char)params->bits_diccionario;
+    output[10] = output[11] = 0;
+    Escribir32(output + 12, tam_bloque);
+    Escribir64(output + 16, input_size);
+    Escribir32(output + 24, t.num_bloques);
+
+    /* Compactar los bloques: el destino nunca adelanta al origen */
+    pos = LZ77_BLOQUES_CABECERA;
+    for (i = 0; i < t.num_bloques; i++) {
+        size_t tam = LZ77_BLOQUES_CABECERA_BLOQUE + t.tam_comprimidos[i];
+        memmove(output + pos, output + LZ77_BLOQUES_CABECERA + (size_t)i * t.tam_hueco, tam);
+        pos += tam;
+    }
+
+    /* Índice: ya no queda nada por mover detrás de pos */
+    if (indice) {
+        size_t inicio_indice = pos, desplazamiento = LZ77_BLOQUES_CABECERA;
+        for (i = 0; i < t.num_bloques; i++) {
+            Escribir64(output + pos, desplazamiento);
+            desplazamiento += LZ77_BLOQUES_CABECERA_BLOQUE + t.tam_comprimidos[i];
+            pos += 8;
+        }
+        Escribir64(output + pos, inicio_indice);
+        Escribir32(output + pos + 8, t.num_bloques);
+        memcpy(output + pos + 12, LZ77_BLOQUES_MAGIA_INDICE, 4);
+        pos += LZ77_BLOQUES_PIE;
+    }
+    free(t.tam_comprimidos);
+    return (long long)pos;
+}
+
+/* Valida la cabecera y rellena los parámetros de decodificación */
+static int LeerCabeceraBloques(const unsigned char *input, size_t input_size, LZ77Params *params,
+                               unsigned int *tam_bloque, unsigned long long *tam_original, unsigned int *num_bloques) {
+    if (input_size < LZ77_BLOQUES_CABECERA || memcmp(input, LZ77_BLOQUES_MAGIA, 4) != 0 || input[4] != LZ77_BLOQUES_VERSION ||
+        (input[5] & ~(LZ77_BLOQUES_ENTROPIA | LZ77_BLOQUES_INDICE | LZ77_BLOQUES_AUTOAJUSTE |
+                      LZ77_BLOQUES_ALMACENADOS | LZ77_BLOQUES_VARIABLES | LZ77_BLOQUES_CARRILES)) != 0)
+        return -1;
+    *params = default_params;
+    params->entropia = (input[5] & LZ77_BLOQUES_ENTROPIA) ? LZ77_ENTROPIA_HUFFMAN : LZ77_ENTROPIA_NINGUNA;
+    params->codigos = (input[5] & LZ77_BLOQUES_VARIABLES) ? LZ77_CODIGOS_VARIABLES : LZ77_CODIGOS_FIJOS;
+    params->carriles = (input[5] & LZ77_BLOQUES_CARRILES) != 0;
+    if (LeerFormato(input + 6, params) != 0)
+        return -1;
+    *tam_bloque = Leer32(input + 12);
+    *tam_original = Leer64(input + 16);
+    *num_bloques = Leer32(input + 24);
+    if (*tam_bloque == 0 || *num_bloques != (*tam_original + *tam_bloque - 1) / *tam_bloque)
+        return -1;
+    return 0;
+}
+
+long long TamanoOriginalBloques(const unsigned char *input, size_t input_size) {
+    LZ77Params params;
+    unsigned int tam_bloque, num_bloques;
+    unsigned long long tam_original;
+    if (LeerCabeceraBloques(input, input_size, &params, &tam_bloque, &tam_original, &num_bloques) != 0)
+        return -1;
+    return (long long)tam_original;
+}
+
+/* Comprueba la cabecera del bloque que empieza en pos y devuelve dónde están sus datos */
+static int LeerBloque(const TrabajoBloques *t, const unsigned char *input, size_t fin, size_t pos, unsigned int bloque,
+                      size_t *datos, unsigned int *tam_comprimido) {
+    if (pos > fin || fin - pos < LZ77_BLOQUES_CABECERA_BLOQUE || Leer32(input + pos + 4) != TamanoBloque(t, bloque))
+        return -1;
+    *tam_comprimido = Leer32(input + pos);
+    *datos = pos + LZ77_BLOQUES_CABECERA_BLOQUE;
+    return *tam_comprimido > fin - *datos ? -1 : 0;
+}
+
+/*
+ * Localiza los bloques [primero, primero + num). Con índice se leen sus entradas; si
+ * no lo hay (o el pie no está al final de la entrada) se recorren las cabeceras.
+ */
+static int LocalizarBloques(TrabajoBloques *t, const unsigned char *input, size_t input_size, unsigned int num) {
+    unsigned int i;
+    size_t pos, datos;
+    unsigned int tam;
+
+    t->desplazamientos = (size_t *)malloc((num + 1) * sizeof(size_t));
+    t->tam_comprimidos = (unsigned int *)malloc((num + 1) * sizeof(unsigned int));
+    if (!t->desplazamientos || !t->tam_comprimidos)
+        return -1;
+
+    if ((input[5] & LZ77_BLOQUES_INDICE) && input_size >= LZ77_BLOQUES_CABECERA + LZ77_BLOQUES_PIE &&
+        memcmp(input + input_size - 4, LZ77_BLOQUES_MAGIA_INDICE, 4) == 0 &&
+        Leer32(input + input_size - 8) == t->num_bloques) {
+        unsigned long long inicio_indice = Leer64(input + input_size - LZ77_BLOQUES_PIE);
+        if (inicio_indice >= LZ77_BLOQUES_CABECERA && inicio_indice <= input_size - LZ77_BLOQUES_PIE &&
+            input_size - LZ77_BLOQUES_PIE - inicio_indice == 8 * (unsigned long long)t->num_bloques) {
+            for (i = 0; i < num; i++) {
+                pos = (size_t)Leer64(input + inicio_indice + 8 * (size_t)(t->primero + i));
+                if (LeerBloque(t, input, (size_t)inicio_indice, pos, t->primero + i,
+                               &t->desplazamientos[i], &t->tam_comprimidos[i]) != 0)
+                    return -1;
+            }
+            return 0;
+        }
+    }
+
+    pos = LZ77_BLOQUES_CABECERA;
+    for (i = 0; i < t->primero + num; i++) {
+        if (LeerBloque(t, input, input_size, pos, i, &datos, &tam) != 0)
+            return -1;
+        if (i >= t->primero) {
+            t->desplazamientos[i - t->primero] = datos;
+            t->tam_comprimidos[i - t->primero] = tam;
+        }
+        pos = datos + tam;
+    }
+    return 0;
+}
+
+/* Descomprime los bloques [primero, primero + num) ya fijados en t */
+static long long DescomprimirBloques(TrabajoBloques *t, const unsigned char *input, size_t input_size,
+                                     unsigned int num, int num_hilos) {
+    int r = -1;
+    if (LocalizarBloques(t, input, input_size, num) != 0) {
+        fprintf(stderr, "Contenedor de bloques truncado o corrupto\n");
+        goto fin;
+    }
+    num_hilos = LZ77HilosEfectivos(num_hilos, num);
+    t->contextos = (LZ77Contexto **)calloc(num_hilos, sizeof(LZ77Contexto *));
+    t->temporales = (unsigned char **)calloc(num_hilos, sizeof(unsigned char *));
+    if (t->contextos && t->temporales)
+        r = LZ77EjecutarParalelo(num_hilos, num, DescomprimirBloque, t);
+    LiberarContextos(t->contextos, num_hilos);
+    LiberarTemporales(t->temporales, num_hilos);
+fin:
+    free(t->desplazamientos);
+    free(t->tam_comprimidos);
+    return r == 0 ? (long long)(t->fin - t->inicio) : -1;
+}
+
+long long DecodificarBloques(const unsigned char *input, size_t input_size,
+                             unsigned char *output, size_t output_capacity, int num_hilos) {
+    TrabajoBloques t;
+    unsigned long long tam_original;
+
+    memset(&t, 0, sizeof(t));
+    if (LeerCabeceraBloques(input, input_size, &t.params, &t.tam_bloque, &tam_original, &t.num_bloques) != 0) {
+        fprintf(stderr, "Cabecera de bloques no válida\n");
+        return -1;
+    }
+    if (tam_original > output_capacity) {
+        fprintf(stderr, "Buffer de salida lleno (descompresión)\n");
+        return -1;
+    }
+    t.input = input;
+    t.tam_datos = (size_t)tam_original;
+    t.output = output;
+    t.fin = tam_original;
+    t.autoajuste = (input[5] & LZ77_BLOQUES_AUTOAJUSTE) != 0;
+    t.almacenados = (input[5] & LZ77_BLOQUES_ALMACENADOS) != 0;
+    return DescomprimirBloques(&t, input, input_size, t.num_bloques, num_hilos);
+}
+
+long long DecodificarRangoBloques(const unsigned char *input, size_t input_size, unsigned long long desplazamiento,
+                                  size_t longitud, unsigned char *output, size_t output_capacity, int num_hilos) {
+    TrabajoBloques t;
+    unsigned long long tam_original;
+
+    memset(&t, 0, sizeof(t));
+    if (LeerCabeceraBloques(input, input_size, &t.params, &t.tam_bloque, &tam_original, &t.num_bloques) != 0) {
+        fprintf(stderr, "Cabecera de bloques no válida\n");
+        return -1;
+    }
+    if (desplazamiento >= tam_original || longitud == 0)
+        return 0;
+    if (longitud > tam_original - desplazamiento)
+        longitud = (size_t)(tam_original - desplazamiento);
+    if (longitud > output_capacity) {
+        fprintf(stderr, "Buffer de salida lleno (descompresión)\n");
+        return -1;
+    }
+    t.input = input;
+    t.tam_datos = (size_t)tam_original;
+    t.output = output;
+    t.inicio = desplazamiento;
+    t.fin = desplazamiento + longitud;
+    t.autoajuste = (input[5] & LZ77_BLOQUES_AUTOAJUSTE) != 0;
+    t.almacenados = (input[5] & LZ77_BLOQUES_ALMACENADOS) != 0;
+    t.primero = (unsigned int)(desplazamiento / t.tam_bloque);
+    return DescomprimirBloques(&t, input, input_size, (unsigned int)((t.fin - 1) / t.tam_bloque) - t.primero + 1, num_hilos);
+}
+
+#endif
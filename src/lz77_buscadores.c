@@ -0,0 +1,312 @@
+/*
+ * Buscadores de coincidencias alternativos a la cadena hash clásica.
+ *
+ * Todos trabajan con posiciones absolutas (modo ventana grande): 0 hace de NULO y
+ * cualquier candidato anterior a ctx->limite está fuera de la ventana.
+ *
+ * La cadena hash inserta un sector completo antes de buscar en él. La tabla de una
+ * sola sonda y el árbol binario, en cambio, insertan cada posición en el momento de
+ * buscarla (la tabla debe devolver la aparición anterior y el árbol se reordena al
+ * insertar): ctx->cursor es la siguiente posición por insertar y, al buscar en p, se
+ * insertan antes las posiciones que se saltaron (las cubiertas por coincidencias).
+ * Como los analizadores pueden repetir la consulta de una posición, los resultados
+ * de las últimas posiciones se guardan en una pequeña caché.
+ */
+
+#ifndef LZ77_BUSCADORES_C
+#define LZ77_BUSCADORES_C
+#include "lz77.h"
+#include "lz77_interno.h"
+
+/* Hash multiplicativo de los primeros 'bytes' bytes (hasta 8) */
+static inline unsigned int HashDirecto(const unsigned char *p, unsigned int bytes, unsigned int bits_hash) {
+    unsigned long long v = Leer64(p);
+    if (bytes < 8)
+        v &= (1ULL << (8 * bytes)) - 1;
+    return (unsigned int)((v * 0x9E3779B97F4A7C15ULL) >> (64 - bits_hash));
+}
+
+static inline unsigned int ClaveLarga(const LZ77Contexto *ctx) {
+    return ctx->derived.max_coincidencia < LZ77_CLAVE_LARGA ? ctx->derived.max_coincidencia : LZ77_CLAVE_LARGA;
+}
+
+static inline int LeerCache(LZ77Contexto *ctx, unsigned int absoluta, unsigned int *longitud, unsigned int *origen) {
+    unsigned int i = absoluta & 3;
+    if (ctx->cache_posicion[i] != absoluta)
+        return 0;
+    *longitud = ctx->cache_longitud[i];
+    *origen = ctx->cache_origen[i];
+    return 1;
+}
+
+static inline void GuardarCache(LZ77Contexto *ctx, unsigned int absoluta, unsigned int longitud, unsigned int origen) {
+    unsigned int i = absoluta & 3;
+    ctx->cache_posicion[i] = absoluta;
+    ctx->cache_longitud[i] = longitud;
+    ctx->cache_origen[i] = origen;
+}
+
+static inline void VaciarCache(LZ77Contexto *ctx) {
+    memset(ctx->cache_posicion, 0, sizeof(ctx->cache_posicion));
+}
+
+/* Publica el resultado respetando la semántica de EncontrarCoincidenciaCtx */
+static inline void Resultado(LZ77Contexto *ctx, unsigned int longitud_inicial, unsigned int longitud, unsigned int origen) {
+    if (longitud > longitud_inicial) {
+        ctx->longitud_coincidencia = longitud;
+        ctx->posicion_coincidencia = origen;
+    } else {
+        ctx->longitud_coincidencia = longitud_inicial;
+    }
+}
+
+int ReservarBuscador(LZ77Contexto *ctx) {
+    if (ctx->params.buscador == LZ77_BUSCADOR_DOBLE) {
+        ctx->hash_largo = (unsigned int *)malloc(ctx->derived.tam_hash * sizeof(unsigned int));
+        return ctx->hash_largo ? 0 : -1;
+    }
+    if (ctx->params.buscador == LZ77_BUSCADOR_ARBOL) {
+        ctx->hijos = (unsigned int *)malloc(2 * (size_t)ctx->derived.tam_diccionario * sizeof(unsigned int));
+        return ctx->hijos ? 0 : -1;
+    }
+    return 0;
+}
+
+void LiberarBuscador(LZ77Contexto *ctx) {
+    free(ctx->hash_largo);
+    free(ctx->hijos);
+    ctx->hash_largo = ctx->hijos = NULL;
+}
+
+/* Sin borrar_tablas las entradas viejas quedan por debajo del nuevo límite (generación nueva) */
+void InicializarBuscador(LZ77Contexto *ctx, int borrar_tablas) {
+    if (ctx->hash_largo && borrar_tablas)
+        memset(ctx->hash_largo, 0, ctx->derived.tam_hash * sizeof(unsigned int));
+    if (ctx->hijos && borrar_tablas)
+        memset(ctx->hijos, 0, 2 * (size_t)ctx->derived.tam_diccionario * sizeof(unsigned int));
+    ctx->cursor = ctx->fin_datos = ctx->base;
+    VaciarCache(ctx);
+}
+
+void RebasarBuscador(LZ77Contexto *ctx, unsigned int delta) {
+    register unsigned int i;
+    for (i = 0; ctx->hash_largo && i < ctx->derived.tam_hash; i++)
+        ctx->hash_largo[i] = ctx->hash_largo[i] > delta ? ctx->hash_largo[i] - delta : 0;
+    for (i = 0; ctx->hijos && i < 2 * ctx->derived.tam_diccionario; i++)
+        ctx->hijos[i] = ctx->hijos[i] > delta ? ctx->hijos[i] - delta : 0;
+    ctx->cursor = ctx->cursor > delta ? ctx->cursor - delta : 0;
+    ctx->fin_datos = ctx->fin_datos > delta ? ctx->fin_datos - delta : 0;
+    VaciarCache(ctx);
+}
+
+/* Solo registra hasta dónde hay datos cargados: la inserción se hace al buscar */
+void HashearBuscador(LZ77Contexto *ctx, unsigned int posicion, unsigned int bytes_a_hashear) {
+    ctx->fin_datos = ctx->base + posicion + bytes_a_hashear;
+    VaciarCache(ctx);
+}
+
+/* Tabla de una sola sonda: la cabeza del hash es la aparición anterior más reciente */
+static void EncontrarRapido(LZ77Contexto *ctx, unsigned int posicion, unsigned int longitud_inicial) {
+    const unsigned char *dic = ctx->diccionario;
+    const unsigned int mascara = ctx->derived.tam_diccionario - 1;
+    const unsigned int clave = ctx->params.umbral + 1;
+    const unsigned int bits_hash = ctx->params.bits_hash;
+    const unsigned int absoluta = ctx->base + posicion;
+    unsigned int candidato, h, longitud = 0, origen = 0;
+
+    if (ctx->cursor < ctx->limite)
+        ctx->cursor = ctx->limite;
+    while (ctx->cursor < absoluta && ctx->cursor + clave <= ctx->fin_datos) {
+        ctx->hash[HashDirecto(dic + (ctx->cursor & mascara), clave, bits_hash)] = ctx->cursor;
+        ctx->cursor++;
+    }
+    if (!LeerCache(ctx, absoluta, &longitud, &origen) && absoluta + clave <= ctx->fin_datos) {
+        h = HashDirecto(dic + posicion, clave, bits_hash);
+        candidato = ctx->hash[h];
+        if (ctx->cursor == absoluta) {
+            ctx->hash[h] = absoluta;
+            ctx->cursor++;
+        }
+        if (candidato >= ctx->limite && candidato < absoluta) {
+            origen = candidato & mascara;
+            longitud = LongitudComun(dic + posicion, dic + origen, ctx->derived.max_coincidencia);
+        }
+        GuardarCache(ctx, absoluta, longitud, origen);
+    }
+    Resultado(ctx, longitud_inicial, longitud, origen);
+}
+
+/* Doble hash: la tabla de la clave larga se consulta antes de recorrer la cadena corta */
+static void EncontrarDoble(LZ77Contexto *ctx, unsigned int posicion, unsigned int longitud_inicial) {
+    const unsigned char *dic = ctx->diccionario;
+    const unsigned int mascara = ctx->derived.tam_diccionario - 1;
+    const unsigned int clave = ClaveLarga(ctx);
+    const unsigned int bits_hash = ctx->params.bits_hash;
+    const unsigned int absoluta = ctx->base + posicion;
+    unsigned int candidato, h, longitud = longitud_inicial, comparaciones = ctx->params.max_comparaciones;
+
+    if (ctx->cursor < ctx->limite)
+        ctx->cursor = ctx->limite;
+    while (ctx->cursor < absoluta && ctx->cursor + clave <= ctx->fin_datos) {
+        ctx->hash_largo[HashDirecto(dic + (ctx->cursor & mascara), clave, bits_hash)] = ctx->cursor;
+        ctx->cursor++;
+    }
+    if (absoluta + clave <= ctx->fin_datos) {
+        h = HashDirecto(dic + posicion, clave, bits_hash);
+        candidato = ctx->hash_largo[h];
+        if (ctx->cursor == absoluta) {
+            ctx->hash_largo[h] = absoluta;
+            ctx->cursor++;
+        }
+        if (candidato >= ctx->limite && candidato < absoluta) {
+            unsigned int l = LongitudComun(dic + posicion, dic + (candidato & mascara), ctx->derived.max_coincidencia);
+            if (l > longitud) {
+                longitud = l;
+                ctx->posicion_coincidencia = candidato & mascara;
+            }
+            /* Con una coincidencia larga asegurada basta un recorrido corto de la cadena */
+            if (l >= clave && comparaciones > 4)
+                comparaciones /= 4;
+        }
+    }
+    if (longitud >= LongitudSuficiente(ctx)) {
+        ctx->longitud_coincidencia = longitud;
+        return;
+    }
+    EncontrarCoincidenciaGrande(ctx, posicion, longitud, comparaciones);
+}
+
+/*
+ * Árbol binario (estilo bt4 de LZMA): cada cubeta del hash es la raíz de un árbol de
+ * sufijos ordenados. Al insertar p se desciende desde la raíz partiendo el árbol en
+ * los sufijos menores y mayores que p, que pasan a ser sus hijos; las comparaciones
+ * del descenso dan las coincidencias. min(len0, len1) bytes ya se sabe que coinciden.
+ * Solo se inserta con el límite completo (LongitudSuficiente bytes cargados) para que
+ * el orden del árbol no dependa de datos aún no cargados; la coincidencia que llega al
+ * límite se alarga después fuera del árbol.
+ */
+static unsigned int ArbolInsertar(LZ77Contexto *ctx, unsigned int absoluta, unsigned int *origen) {
+    const unsigned char *dic = ctx->diccionario;
+    const unsigned int mascara = ctx->derived.tam_diccionario - 1;
+    const unsigned int limite = ctx->limite;
+    const unsigned int limite_longitud = LongitudSuficiente(ctx);
+    const unsigned char *actual = dic + (absoluta & mascara);
+    unsigned int *hijos = ctx->hijos;
+    unsigned int h = HashDirecto(actual, ctx->params.umbral + 1, ctx->params.bits_hash);
+    unsigned int candidato = ctx->hash[h];
+    unsigned int *ptr0 = hijos + 2 * (absoluta & mascara) + 1, *ptr1 = hijos + 2 * (absoluta & mascara);
+    unsigned int len0 = 0, len1 = 0, mejor = 0, profundidad = ctx->params.max_comparaciones;
+
+    ctx->hash[h] = absoluta;
+    for (;;) {
+        unsigned int *par, len;
+        const unsigned char *pb;
+        if (candidato < limite || candidato >= absoluta || profundidad-- == 0) {
+            *ptr0 = *ptr1 = 0;
+            return mejor;
+        }
+        par = hijos + 2 * (candidato & mascara);
+        pb = dic + (candidato & mascara);
+        len = len0 < len1 ? len0 : len1;
+        if (pb[len] == actual[len]) {
+            len += LongitudComun(pb + len, actual + len, limite_longitud - len);
+            if (len > mejor) {
+                mejor = len;
+                *origen = candidato & mascara;
+            }
+            if (len == limite_longitud) {
+                *ptr1 = par[0];
+                *ptr0 = par[1];
+                return mejor;
+            }
+        }
+        if (pb[len] < actual[len]) {
+            *ptr1 = candidato;
+            ptr1 = par + 1;
+            candidato = *ptr1;
+            len1 = len;
+        } else {
+            *ptr0 = candidato;
+            ptr0 = par;
+            candidato = *ptr0;
+            len0 = len;
+        }
+    }
+}
+
+/* Descenso de solo lectura, para posiciones que aún no se pueden insertar */
+static unsigned int ArbolBuscar(LZ77Contexto *ctx, unsigned int absoluta, unsigned int limite_longitud, unsigned int *origen) {
+    const unsigned char *dic = ctx->diccionario;
+    const unsigned int mascara = ctx->derived.tam_diccionario - 1;
+    const unsigned char *actual = dic + (absoluta & mascara);
+    unsigned int candidato = ctx->hash[HashDirecto(actual, ctx->params.umbral + 1, ctx->params.bits_hash)];
+    unsigned int len0 = 0, len1 = 0, mejor = 0, profundidad = ctx->params.max_comparaciones;
+
+    while (candidato >= ctx->limite && candidato < absoluta && profundidad--) {
+        const unsigned int *par = ctx->hijos + 2 * (candidato & mascara);
+        const unsigned char *pb = dic + (candidato & mascara);
+        unsigned int len = len0 < len1 ? len0 : len1;
+        if (pb[len] == actual[len]) {
+            len += LongitudComun(pb + len, actual + len, limite_longitud - len);
+            if (len > mejor) {
+                mejor = len;
+                *origen = candidato & mascara;
+            }
+            if (len == limite_longitud)
+                break;
+        }
+        if (pb[len] < actual[len]) {
+            candidato = par[1];
+            len1 = len;
+        } else {
+            candidato = par[0];
+            len0 = len;
+        }
+    }
+    return mejor;
+}
+
+static void EncontrarArbol(LZ77Contexto *ctx, unsigned int posicion, unsigned int longitud_inicial) {
+    const unsigned int limite_longitud = LongitudSuficiente(ctx);
+    const unsigned int absoluta = ctx->base + posicion;
+    unsigned int longitud = 0, origen = 0, tope;
+
+    if (ctx->cursor < ctx->limite)
+        ctx->cursor = ctx->limite;
+    while (ctx->cursor < absoluta && ctx->cursor + limite_longitud <= ctx->fin_datos) {
+        ArbolInsertar(ctx, ctx->cursor, &origen);
+        ctx->cursor++;
+    }
+    if (!LeerCache(ctx, absoluta, &longitud, &origen)) {
+        longitud = 0;
+        tope = ctx->fin_datos - absoluta < ctx->derived.max_coincidencia ?
+               ctx->fin_datos - absoluta : ctx->derived.max_coincidencia;
+        if (ctx->cursor == absoluta && absoluta + limite_longitud <= ctx->fin_datos) {
+            longitud = ArbolInsertar(ctx, absoluta, &origen);
+            ctx->cursor++;
+        } else if (absoluta + ctx->params.umbral + 1 <= ctx->fin_datos) {
+            longitud = ArbolBuscar(ctx, absoluta, tope < limite_longitud ? tope : limite_longitud, &origen);
+        }
+        if (longitud == limite_longitud && longitud < tope)
+            longitud += LongitudComun(ctx->diccionario + (absoluta & (ctx->derived.tam_diccionario - 1)) + longitud,
+                                      ctx->diccionario + origen + longitud, tope - longitud);
+        GuardarCache(ctx, absoluta, longitud, origen);
+    }
+    Resultado(ctx, longitud_inicial, longitud, origen);
+}
+
+void EncontrarBuscador(LZ77Contexto *ctx, unsigned int posicion, unsigned int longitud_inicial) {
+    switch (ctx->params.buscador) {
+    case LZ77_BUSCADOR_DOBLE:
+        EncontrarDoble(ctx, posicion, longitud_inicial);
+        break;
+    case LZ77_BUSCADOR_ARBOL:
+        EncontrarArbol(ctx, posicion, longitud_inicial);
+        break;
+    default:
+        EncontrarRapido(ctx, posicion, longitud_inicial);
+        break;
+    }
+}
+
+#endif
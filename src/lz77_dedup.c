@@ -0,0 +1,279 @@
+/* Deduplicación de repeticiones lejanas antes de la compresión por bloques */
+
+#ifndef LZ77_DEDUP_C
+#define LZ77_DEDUP_C
+#include "lz77_dedup.h"
+#include "lz77_interno.h"
+
+/* Enteros de 7 bits por byte, con el octavo a 1 si sigue otro byte */
+static size_t EscribirVarint(unsigned char *p, unsigned long long v) {
+    size_t n = 0;
+    while (v >= 0x80) {
+        p[n++] = (unsigned char)(v | 0x80);
+        v >>= 7;
+    }
+    p[n++] = (unsigned char)v;
+    return n;
+}
+
+/* Devuelve los bytes leídos o 0 si el entero está truncado o no cabe en 64 bits */
+static size_t LeerVarint(const unsigned char *p, const unsigned char *fin, unsigned long long *v) {
+    unsigned long long r = 0;
+    size_t n;
+    for (n = 0; n < 10 && p + n < fin; n++) {
+        r |= (unsigned long long)(p[n] & 0x7F) << (7 * n);
+        if (!(p[n] & 0x80)) {
+            *v = r;
+            return n + 1;
+        }
+    }
+    return 0;
+}
+
+#define LZ77_DEDUP_MAX_REFERENCIA 30    /* Tres enteros de como mucho 10 bytes */
+
+/* Tabla del hash gear: 256 valores pseudoaleatorios (splitmix64) */
+static void TablaGear(unsigned long long gear[256]) {
+    unsigned long long x = 0;
+    register unsigned int i;
+    for (i = 0; i < 256; i++) {
+        unsigned long long z = (x += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        gear[i] = z ^ (z >> 31);
+    }
+}
+
+/* Hash de los LZ77_DEDUP_VENTANA_HASH bytes anteriores a p */
+static inline unsigned long long HashVentana(const unsigned long long gear[256], const unsigned char *p) {
+    unsigned long long h = 0;
+    register unsigned int i;
+    for (i = LZ77_DEDUP_VENTANA_HASH; i > 0; i--)
+        h = (h << 1) + gear[p[-(int)i]];
+    return h;
+}
+
+/* LongitudComun sin el límite de unsigned int */
+static size_t LongitudComunLarga(const unsigned char *a, const unsigned char *b, size_t max) {
+    size_t total = 0;
+    for (;;) {
+        unsigned int tramo = max - total < (1u << 30) ? (unsigned int)(max - total) : (1u << 30);
+        unsigned int n = LongitudComun(a + total, b + total, tramo);
+        total += n;
+        if (n < tramo || total == max)
+            return total;
+    }
+}
+
+/* Referencias encontradas y residuo (los bytes que no cubren) */
+typedef struct Referencias {
+    unsigned char *datos;
+    size_t tam, capacidad;
+    unsigned char *residuo;
+    size_t tam_residuo;
+} Referencias;
+
+static int AnadirReferencia(Referencias *r, const unsigned char *literales, size_t num_literales,
+                            size_t distancia, size_t longitud) {
+    if (r->capacidad - r->tam < LZ77_DEDUP_MAX_REFERENCIA) {
+        size_t nueva = r->capacidad ? r->capacidad * 2 : 4096;
+        unsigned char *d = (unsigned char *)realloc(r->datos, nueva);
+        if (!d)
+            return -1;
+        r->datos = d;
+        r->capacidad = nueva;
+    }
+    r->tam += EscribirVarint(r->datos + r->tam, num_literales);
+    r->tam += EscribirVarint(r->datos + r->tam, distancia);
+    r->tam += EscribirVarint(r->datos + r->tam, longitud);
+    memcpy(r->residuo + r->tam_residuo, literales, num_literales);
+    r->tam_residuo += num_literales;
+    return 0;
+}
+
+/*
+ * Recorre la entrada con el hash rodante. La tabla guarda posición + 1 (0 = vacío)
+ * de la última ancla con cada hash; tras una referencia el hash se recalcula sobre
+ * los bytes anteriores a su final, así que las anclas siguen dependiendo solo del
+ * contenido.
+ */
+static int BuscarReferencias(const unsigned char *input, size_t input_size, Referencias *r) {
+    const unsigned long long mascara = ~0ULL << (64 - LZ77_DEDUP_BITS_SEPARACION);
+    unsigned long long gear[256], h = 0;
+    unsigned long long *anclas;
+    size_t i, inicio = 0;     /* inicio: primer byte aún sin asignar al residuo */
+
+    anclas = (unsigned long long *)calloc((size_t)1 << LZ77_DEDUP_BITS_ANCLAS, sizeof(unsigned long long));
+    if (!anclas)
+        return -1;
+    TablaGear(gear);
+    for (i = 0; i < input_size && i < LZ77_DEDUP_VENTANA_HASH; i++)
+        h = (h << 1) + gear[input[i]];
+
+    /* En i el hash cubre los bytes [i - LZ77_DEDUP_VENTANA_HASH, i) */
+    while (i < input_size) {
+        if ((h & mascara) == 0) {
+            unsigned long long *hueco = &anclas[(h * 0x9E3779B97F4A7C15ULL) >> (64 - LZ77_DEDUP_BITS_ANCLAS)];
+            size_t candidata = (size_t)*hueco;
+            *hueco = (unsigned long long)i + 1;
+            if (candidata--) {
+                size_t adelante = LongitudComunLarga(input + candidata, input + i, input_size - i), atras = 0;
+                while (atras < candidata && i - atras > inicio && input[candidata - atras - 1] == input[i - atras - 1])
+                    atras++;
+                if (atras + adelante >= LZ77_DEDUP_MINIMO) {
+                    if (AnadirReferencia(r, input + inicio, i - atras - inicio, i - candidata, atras + adelante) != 0) {
+                        free(anclas);
+                        return -1;
+                    }
+                    inicio = i += adelante;
+                    if (i >= input_size)
+                        break;
+                    if (i >= LZ77_DEDUP_VENTANA_HASH)
+                        h = HashVentana(gear, input + i);
+                }
+            }
+        }
+        h = (h << 1) + gear[input[i++]];
+    }
+    free(anclas);
+
+    memcpy(r->residuo + r->tam_residuo, input + inicio, input_size - inicio);
+    r->tam_residuo += input_size - inicio;
+    return 0;
+}
+
+size_t CotaDedup(const LZ77Params *params, size_t input_size, unsigned int tam_bloque) {
+    return LZ77_DEDUP_CABECERA + CotaBloques(params, input_size, tam_bloque);
+}
+
+long long CodificarDedup(const LZ77Params *params, const unsigned char *input, size_t input_size,
+                         unsigned char *output, size_t output_capacity, unsigned int tam_bloque, int num_hilos) {
+    Referencias r;
+    const unsigned char *residuo = input;
+    size_t tam_residuo = input_size, tam_referencias = 0;
+    long long comprimido;
+
+    if (output_capacity < CotaDedup(params, input_size, tam_bloque)) {
+        fprintf(stderr, "Buffer de salida insuficiente (deduplicación)\n");
+        return -1;
+    }
+    memset(&r, 0, sizeof(r));
+    if (input_size && !(r.residuo = (unsigned char *)malloc(input_size)))
+        return -1;
+    if (BuscarReferencias(input, input_size, &r) != 0) {
+        free(r.datos);
+        free(r.residuo);
+        return -1;
+    }
+
+    /* Las referencias van si caben en la cota: casi siempre, porque cada una ahorra
+     * al menos LZ77_DEDUP_MINIMO bytes de residuo; si no, solo el residuo */
+    if (r.tam && LZ77_DEDUP_CABECERA + r.tam + CotaBloques(params, r.tam_residuo, tam_bloque) <= output_capacity) {
+        memcpy(output + LZ77_DEDUP_CABECERA, r.datos, r.tam);
+        residuo = r.residuo;
+        tam_residuo = r.tam_residuo;
+        tam_referencias = r.tam;
+    }
+    free(r.datos);
+
+    comprimido = CodificarBloques(params, residuo, tam_residuo, output + LZ77_DEDUP_CABECERA + tam_referencias,
+                                  output_capacity - LZ77_DEDUP_CABECERA - tam_referencias, tam_bloque, num_hilos);
+    free(r.residuo);
+    if (comprimido < 0)
+        return -1;
+
+    memcpy(output, LZ77_DEDUP_MAGIA, 4);
+    output[4] = LZ77_DEDUP_VERSION;
+    output[5] = output[6] = output[7] = 0;
+    Escribir64(output + 8, input_size);
+    Escribir64(output + 16, tam_referencias);
+    return LZ77_DEDUP_CABECERA + (long long)tam_referencias + comprimido;
+}
+
+/* Valida la cabecera y devuelve el tamaño original y el de las referencias */
+static int LeerCabeceraDedup(const unsigned char *input, size_t input_size, unsigned long long *tam_original,
+                             unsigned long long *tam_referencias) {
+    if (input_size < LZ77_DEDUP_CABECERA || memcmp(input, LZ77_DEDUP_MAGIA, 4) != 0 ||
+        input[4] != LZ77_DEDUP_VERSION || input[5] || input[6] || input[7])
+        return -1;
+    *tam_original = Leer64(input + 8);
+    *tam_referencias = Leer64(input + 16);
+    if (*tam_referencias > input_size - LZ77_DEDUP_CABECERA)
+        return -1;
+    return 0;
+}
+
+long long TamanoOriginalDedup(const unsigned char *input, size_t input_size) {
+    unsigned long long tam_original, tam_referencias;
+    if (LeerCabeceraDedup(input, input_size, &tam_original, &tam_referencias) != 0)
+        return -1;
+    return (long long)tam_original;
+}
+
+long long DecodificarDedup(const unsigned char *input, size_t input_size,
+                           unsigned char *output, size_t output_capacity, int num_hilos) {
+    unsigned long long tam_original, tam_referencias;
+    const unsigned char *p, *fin;
+    size_t producidos = 0, leidos;
+    long long tam_residuo;
+
+    if (LeerCabeceraDedup(input, input_size, &tam_original, &tam_referencias) != 0) {
+        fprintf(stderr, "Cabecera de deduplicación no válida\n");
+        return -1;
+    }
+    if (tam_original > output_capacity) {
+        fprintf(stderr, "Buffer de salida lleno (descompresión)\n");
+        return -1;
+    }
+    p = input + LZ77_DEDUP_CABECERA;
+    fin = p + tam_referencias;
+    tam_residuo = TamanoOriginalBloques(fin, input_size - LZ77_DEDUP_CABECERA - (size_t)tam_referencias);
+    if (tam_residuo < 0 || (unsigned long long)tam_residuo > tam_original) {
+        fprintf(stderr, "Residuo de deduplicación no válido\n");
+        return -1;
+    }
+
+    /* El residuo, al final de la salida; entre producidos y leidos quedan exactamente
+     * los bytes de las referencias que faltan, así que nada pisa lo aún no leído */
+    leidos = (size_t)(tam_original - (unsigned long long)tam_residuo);
+    if (DecodificarBloques(fin, input_size - LZ77_DEDUP_CABECERA - (size_t)tam_referencias, output + leidos,
+                           (size_t)tam_residuo, num_hilos) != tam_residuo)
+        return -1;
+
+    while (p < fin) {
+        unsigned long long literales, distancia, longitud;
+        const unsigned char *origen;
+        size_t n;
+        if (!(n = LeerVarint(p, fin, &literales)) || !(p += n, n = LeerVarint(p, fin, &distancia)) ||
+            !(p += n, n = LeerVarint(p, fin, &longitud)))
+            goto no_valido;
+        p += n;
+        if (literales > tam_original - leidos)
+            goto no_valido;
+        memmove(output + producidos, output + leidos, (size_t)literales);
+        producidos += (size_t)literales;
+        leidos += (size_t)literales;
+        if (distancia == 0 || distancia > producidos || longitud > leidos - producidos)
+            goto no_valido;
+        /* Con solapamiento, lo ya copiado repite el patrón: cada copia duplica el tramo */
+        origen = output + producidos - distancia;
+        while (longitud) {
+            n = (size_t)(output + producidos - origen);
+            if (n > longitud)
+                n = (size_t)longitud;
+            memcpy(output + producidos, origen, n);
+            producidos += n;
+            longitud -= n;
+        }
+    }
+    /* Los últimos bytes del residuo ya están en su sitio */
+    if (producidos != leidos)
+        goto no_valido;
+    return (long long)tam_original;
+
+no_valido:
+    fprintf(stderr, "Referencias de deduplicación no válidas\n");
+    return -1;
+}
+
+#endif
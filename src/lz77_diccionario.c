@@ -0,0 +1,224 @@
+/* Diccionarios prefijados: preparación y entrenamiento */
+
+#ifndef LZ77_DICCIONARIO_C
+#define LZ77_DICCIONARIO_C
+#include "lz77_diccionario.h"
+#include "lz77_interno.h"
+
+LZ77DiccionarioPreparado *PrepararDiccionario(const LZ77Params *params, const unsigned char *datos, unsigned int tam) {
+    LZ77DiccionarioPreparado *d = (LZ77DiccionarioPreparado *)calloc(1, sizeof(LZ77DiccionarioPreparado));
+    LZ77Contexto *ctx = CrearContexto(params);
+    if (!d || !ctx)
+        goto error;
+    d->params = *params;
+
+    EstablecerDiccionarioCtx(ctx, datos, tam);
+    d->tam = ctx->tam_prefijo;
+    d->datos = (unsigned char *)malloc(d->tam ? d->tam : 1);
+    if (!d->datos)
+        goto error;
+    memcpy(d->datos, ctx->prefijo, d->tam);
+
+    /* Mismo estado que construiría CodificarBufferCtx antes de cargar la entrada */
+    ctx->prefijo = d->datos;
+    InicializarCodificacionCtx(ctx);
+    d->inicio = CargarPrefijoCtx(ctx);
+    if (params->buscador == LZ77_BUSCADOR_CADENA) {
+        d->ventana = (unsigned char *)malloc(d->inicio ? d->inicio : 1);
+        d->hash = (unsigned int *)malloc(ctx->derived.tam_hash * sizeof(unsigned int));
+        d->enlace = (unsigned int *)malloc((d->inicio ? d->inicio : 1) * sizeof(unsigned int));
+        if (!d->ventana || !d->hash || !d->enlace)
+            goto error;
+        memcpy(d->ventana, ctx->diccionario, d->inicio);
+        memcpy(d->hash, ctx->hash, ctx->derived.tam_hash * sizeof(unsigned int));
+        memcpy(d->enlace, ctx->siguiente_enlace, d->inicio * sizeof(unsigned int));
+    }
+    DestruirContexto(ctx);
+    return d;
+
+error:
+    DestruirContexto(ctx);
+    LiberarDiccionarioPreparado(d);
+    return NULL;
+}
+
+void LiberarDiccionarioPreparado(LZ77DiccionarioPreparado *diccionario) {
+    if (!diccionario)
+        return;
+    free(diccionario->datos);
+    free(diccionario->ventana);
+    free(diccionario->hash);
+    free(diccionario->enlace);
+    free(diccionario);
+}
+
+int UsarDiccionarioPreparadoCtx(LZ77Contexto *ctx, const LZ77DiccionarioPreparado *diccionario) {
+    const LZ77Params *p;
+    if (!diccionario) {
+        EstablecerDiccionarioCtx(ctx, NULL, 0);
+        return 0;
+    }
+    p = &diccionario->params;
+    if (p->bits_diccionario != ctx->params.bits_diccionario || p->bits_hash != ctx->params.bits_hash ||
+        p->umbral != ctx->params.umbral || p->bit_sector != ctx->params.bit_sector ||
+        p->buscador != ctx->params.buscador)
+        return -1;
+    ctx->prefijo = diccionario->datos;
+    ctx->tam_prefijo = diccionario->tam;
+    ctx->preparado = diccionario->hash ? diccionario : NULL;
+    return 0;
+}
+
+/*
+ * Sustituye a InicializarCodificacionCtx + CargarPrefijoCtx. Las entradas de
+ * siguiente_enlace a partir de inicio no se restauran: ninguna cadena llega a ellas
+ * antes de que HashearDatosCtx las vuelva a escribir.
+ */
+unsigned int RestaurarDiccionarioPreparado(LZ77Contexto *ctx) {
+    const LZ77DiccionarioPreparado *d = ctx->preparado;
+    const DerivedParams *derived = &ctx->derived;
+    ctx->buffer_bits = 0;
+    ctx->bits_en = 0;
+    ctx->base = ctx->limite = derived->tam_diccionario;
+    memcpy(ctx->diccionario, d->ventana, d->inicio);
+    memcpy(ctx->diccionario + derived->tam_diccionario, ctx->diccionario,
+           d->inicio < derived->max_coincidencia ? d->inicio : derived->max_coincidencia);
+    memcpy(ctx->hash, d->hash, derived->tam_hash * sizeof(unsigned int));
+    memcpy(ctx->siguiente_enlace, d->enlace, d->inicio * sizeof(unsigned int));
+    return d->inicio;
+}
+
+/* Entrenamiento */
+#define LZ77_ENTRENAR_BITS_TABLA 20
+
+typedef struct {
+    unsigned long long puntuacion;
+    size_t inicio;
+    unsigned int longitud;
+} Fragmento;
+
+static inline unsigned int HashClave(const unsigned char *p) {
+    unsigned long long v = 0;
+    unsigned int i;
+    for (i = 0; i < LZ77_ENTRENAR_CLAVE; i++)
+        v |= (unsigned long long)p[i] << (8 * i);
+    return (unsigned int)((v * 0x9E3779B97F4A7C15ULL) >> (64 - LZ77_ENTRENAR_BITS_TABLA));
+}
+
+/* Suma, para cada clave del fragmento, el número de muestras en que aparece (si son varias) */
+static unsigned long long PuntuarFragmento(const unsigned char *muestras, const Fragmento *f, const unsigned int *cuentas) {
+    unsigned long long puntuacion = 0;
+    unsigned int i, c;
+    for (i = 0; i + LZ77_ENTRENAR_CLAVE <= f->longitud; i++) {
+        c = cuentas[HashClave(muestras + f->inicio + i)];
+        if (c > 1)
+            puntuacion += c;
+    }
+    return puntuacion;
+}
+
+/* Montículo de máximos por puntuación */
+static void Hundir(Fragmento *m, unsigned int n, unsigned int i) {
+    Fragmento f = m[i];
+    unsigned int h;
+    while ((h = 2 * i + 1) < n) {
+        if (h + 1 < n && m[h + 1].puntuacion > m[h].puntuacion)
+            h++;
+        if (m[h].puntuacion <= f.puntuacion)
+            break;
+        m[i] = m[h];
+        i = h;
+    }
+    m[i] = f;
+}
+
+long long EntrenarDiccionario(const unsigned char *muestras, const size_t *tamanos, unsigned int num_muestras,
+                              unsigned char *diccionario, unsigned int capacidad) {
+    const unsigned int tam_tabla = 1u << LZ77_ENTRENAR_BITS_TABLA;
+    unsigned int *cuentas, *ultima, num_fragmentos = 0, m, i, libre = capacidad;
+    Fragmento *fragmentos;
+    size_t inicio, desplazamiento, total = 0;
+
+    if (!muestras || !tamanos || !diccionario)
+        return -1;
+    for (m = 0; m < num_muestras; m++)
+        total += tamanos[m];
+    cuentas = (unsigned int *)calloc(tam_tabla, sizeof(unsigned int));
+    ultima = (unsigned int *)malloc(tam_tabla * sizeof(unsigned int));
+    fragmentos = (Fragmento *)malloc((total / (LZ77_ENTRENAR_FRAGMENTO / 2) + num_muestras + 1) * sizeof(Fragmento));
+    if (!cuentas || !ultima || !fragmentos) {
+        free(cuentas);
+        free(ultima);
+        free(fragmentos);
+        return -1;
+    }
+
+    /* Cada clave cuenta una vez por muestra en la que aparece */
+    memset(ultima, 0xFF, tam_tabla * sizeof(unsigned int));
+    for (m = 0, inicio = 0; m < num_muestras; inicio += tamanos[m++]) {
+        for (desplazamiento = 0; desplazamiento + LZ77_ENTRENAR_CLAVE <= tamanos[m]; desplazamiento++) {
+            unsigned int h = HashClave(muestras + inicio + desplazamiento);
+            if (ultima[h] != m) {
+                ultima[h] = m;
+                cuentas[h]++;
+            }
+        }
+    }
+
+    /* Candidatos: fragmentos de cada muestra solapados a medias */
+    for (m = 0, inicio = 0; m < num_muestras; inicio += tamanos[m++]) {
+        for (desplazamiento = 0; desplazamiento + LZ77_ENTRENAR_CLAVE <= tamanos[m];
+             desplazamiento += LZ77_ENTRENAR_FRAGMENTO / 2) {
+            Fragmento *f = &fragmentos[num_fragmentos];
+            f->inicio = inicio + desplazamiento;
+            f->longitud = tamanos[m] - desplazamiento < LZ77_ENTRENAR_FRAGMENTO ?
+                          (unsigned int)(tamanos[m] - desplazamiento) : LZ77_ENTRENAR_FRAGMENTO;
+            f->puntuacion = PuntuarFragmento(muestras, f, cuentas);
+            if (f->puntuacion)
+                num_fragmentos++;
+        }
+    }
+    for (i = num_fragmentos / 2; i-- > 0;)
+        Hundir(fragmentos, num_fragmentos, i);
+
+    /*
+     * Voraz con evaluación perezosa: elegir un fragmento anula sus claves, así que la
+     * puntuación de los demás solo baja. Se recalcula la del mejor y, si sigue por
+     * delante del siguiente, se elige; si no, vuelve al montículo.
+     */
+    while (libre && num_fragmentos) {
+        Fragmento f = fragmentos[0];
+        f.puntuacion = PuntuarFragmento(muestras, &f, cuentas);
+        if (f.puntuacion == 0) {
+            fragmentos[0] = fragmentos[--num_fragmentos];
+            Hundir(fragmentos, num_fragmentos, 0);
+            continue;
+        }
+        if ((num_fragmentos > 1 && f.puntuacion < fragmentos[1].puntuacion) ||
+            (num_fragmentos > 2 && f.puntuacion < fragmentos[2].puntuacion)) {
+            fragmentos[0] = f;
+            Hundir(fragmentos, num_fragmentos, 0);
+            continue;
+        }
+        /* Se rellena de atrás hacia delante: los mejores quedan al final */
+        if (f.longitud > libre) {
+            f.inicio += f.longitud - libre;
+            f.longitud = libre;
+        }
+        libre -= f.longitud;
+        memcpy(diccionario + libre, muestras + f.inicio, f.longitud);
+        for (i = 0; i + LZ77_ENTRENAR_CLAVE <= f.longitud; i++)
+            cuentas[HashClave(muestras + f.inicio + i)] = 0;
+        fragmentos[0] = fragmentos[--num_fragmentos];
+        Hundir(fragmentos, num_fragmentos, 0);
+    }
+
+    if (libre)
+        memmove(diccionario, diccionario + libre, capacidad - libre);
+    free(cuentas);
+    free(ultima);
+    free(fragmentos);
+    return (long long)(capacidad - libre);
+}
+
+#endif
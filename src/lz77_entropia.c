@@ -0,0 +1,545 @@
+/*
+ * Etapa de entropía: recodifica los tokens LZ77 con códigos de Huffman canónicos.
+ *
+ * La salida es una secuencia de segmentos de hasta LZ77_ENTROPIA_SEGMENTO tokens, cada
+ * uno con sus propias tablas:
+ *
+ *   1 bit    último segmento
+ *   9 bits   número de longitudes de código del alfabeto literal/longitud (n)
+ *   n códigos de 4 bits: longitud 0..LZ77_ENTROPIA_BITS_TABLA, o 15 seguido de 5 bits
+ *            para una racha de 3 a 34 ceros
+ *   6 bits   número de longitudes de código del alfabeto de distancias, ídem
+ *   tokens   hasta el símbolo LZ77_ENTROPIA_FIN
+ *
+ * El alfabeto literal/longitud (como en deflate) tiene los 256 literales, el fin de
+ * segmento y 40 códigos de longitud: longitud - (umbral + 1) < 16 va directa y el resto
+ * se agrupa por potencias de dos (dos códigos por potencia, con el bit siguiente al más
+ * alto) seguida de los bits restantes. Las distancias se agrupan igual: 52 códigos para
+ * distancias de hasta 26 bits. Los códigos se limitan a LZ77_ENTROPIA_BITS_TABLA bits para
+ * decodificar cada símbolo con una sola consulta a tabla.
+ */
+
+#ifndef LZ77_ENTROPIA_C
+#define LZ77_ENTROPIA_C
+#include "lz77.h"
+#include "lz77_interno.h"
+
+#define LZ77_ENTROPIA_SEGMENTO     (1 << 16)
+#define LZ77_ENTROPIA_BITS_TABLA   11
+#define LZ77_ENTROPIA_FIN          256
+#define LZ77_ENTROPIA_LONGITUDES   40
+#define LZ77_ENTROPIA_LITERALES    (LZ77_ENTROPIA_FIN + 1 + LZ77_ENTROPIA_LONGITUDES)
+#define LZ77_ENTROPIA_DISTANCIAS   52
+#define LZ77_ENTROPIA_RACHA        15
+
+/* Código de un valor agrupado: directo por debajo de 2^bits_directos, si no por potencias de dos */
+static inline unsigned int CodigoAgrupado(unsigned int v, unsigned int bits_directos, unsigned int *extra) {
+    unsigned int n;
+    if (v < (1u << bits_directos)) {
+        *extra = 0;
+        return v;
+    }
+    n = 31 - __builtin_clz(v);
+    *extra = n - 1;
+    return (1u << bits_directos) + 2 * (n - bits_directos) + ((v >> (n - 1)) & 1);
+}
+
+/* Inverso de CodigoAgrupado: valor base y bits extra de cada código */
+static void TablaAgrupada(unsigned int num_codigos, unsigned int bits_directos, unsigned int *base, unsigned char *extra) {
+    register unsigned int c;
+    for (c = 0; c < num_codigos; c++) {
+        if (c < (1u << bits_directos)) {
+            base[c] = c;
+            extra[c] = 0;
+        } else {
+            unsigned int n = bits_directos + ((c - (1u << bits_directos)) >> 1);
+            base[c] = (2 | ((c - (1u << bits_directos)) & 1)) << (n - 1);
+            extra[c] = (unsigned char)(n - 1);
+        }
+    }
+}
+
+static int CompararHojas(const void *a, const void *b) {
+    unsigned long long x = *(const unsigned long long *)a, y = *(const unsigned long long *)b;
+    return x < y ? -1 : x > y;
+}
+
+/*
+ * Longitudes de un código de Huffman limitado a LZ77_ENTROPIA_BITS_TABLA bits. Se construye
+ * el árbol con dos colas sobre las hojas ordenadas; si es demasiado profundo se reducen
+ * a la mitad las frecuencias (sin llegar a 0) y se repite.
+ */
+static void LongitudesHuffman(const unsigned int *frecuencias, unsigned int n, unsigned char *longitudes) {
+    unsigned int f[LZ77_ENTROPIA_LITERALES], peso[2 * LZ77_ENTROPIA_LITERALES];
+    unsigned int padre[2 * LZ77_ENTROPIA_LITERALES], profundidad[2 * LZ77_ENTROPIA_LITERALES];
+    unsigned long long hojas[LZ77_ENTROPIA_LITERALES];
+    register unsigned int i, k;
+    unsigned int m, hoja, interno, maxima;
+
+    memcpy(f, frecuencias, n * sizeof(unsigned int));
+    for (;;) {
+        memset(longitudes, 0, n);
+        for (i = m = 0; i < n; i++)
+            if (f[i])
+                hojas[m++] = ((unsigned long long)f[i] << 16) | i;
+        if (m == 0)
+            return;
+        if (m == 1) {
+            longitudes[hojas[0] & 0xFFFF] = 1;
+            return;
+        }
+        qsort(hojas, m, sizeof(hojas[0]), CompararHojas);
+        for (i = 0; i < m; i++)
+            peso[i] = (unsigned int)(hojas[i] >> 16);
+        /* Los nodos internos se crean con pesos no decrecientes: basta otra cola */
+        hoja = 0;
+        interno = m;
+        for (k = m; k < 2 * m - 1; k++) {
+            peso[k] = 0;
+            for (i = 0; i < 2; i++) {
+                unsigned int x = hoja < m && (interno >= k || peso[hoja] <= peso[interno]) ? hoja++ : interno++;
+                padre[x] = k;
+                peso[k] += peso[x];
+            }
+        }
+        profundidad[2 * m - 2] = 0;
+        maxima = 0;
+        for (k = 2 * m - 2; k-- > 0;) {
+            profundidad[k] = profundidad[padre[k]] + 1;
+            if (k < m && profundidad[k] > maxima)
+                maxima = profundidad[k];
+        }
+        if (maxima <= LZ77_ENTROPIA_BITS_TABLA) {
+            for (i = 0; i < m; i++)
+                longitudes[hojas[i] & 0xFFFF] = (unsigned char)profundidad[i];
+            return;
+        }
+        for (i = 0; i < n; i++)
+            if (f[i])
+                f[i] = (f[i] + 1) >> 1;
+    }
+}
+
+/*
+ * Códigos canónicos a partir de las longitudes, con los bits invertidos porque el flujo
+ * se escribe empezando por el bit menos significativo. Devuelve -1 si las longitudes no
+ * forman un código prefijo válido.
+ */
+static int CodigosCanonicos(const unsigned char *longitudes, unsigned int n, unsigned short *codigos) {
+    unsigned int cuenta[16] = {0}, siguiente[16];
+    unsigned int codigo = 0, kraft = 0;
+    register unsigned int i, b;
+
+    for (i = 0; i < n; i++) {
+        if (longitudes[i] > LZ77_ENTROPIA_BITS_TABLA)
+            return -1;
+        if (longitudes[i]) {
+            cuenta[longitudes[i]]++;
+            kraft += 1u << (LZ77_ENTROPIA_BITS_TABLA - longitudes[i]);
+        }
+    }
+    if (kraft > (1u << LZ77_ENTROPIA_BITS_TABLA))
+        return -1;
+    for (b = 1; b < 16; b++) {
+        codigo = (codigo + cuenta[b - 1]) << 1;
+        siguiente[b] = codigo;
+    }
+    for (i = 0; i < n; i++) {
+        unsigned int c, r = 0;
+        if (!longitudes[i])
+            continue;
+        c = siguiente[longitudes[i]]++;
+        for (b = 0; b < longitudes[i]; b++)
+            r |= ((c >> b) & 1) << (longitudes[i] - 1 - b);
+        codigos[i] = (unsigned short)r;
+    }
+    return 0;
+}
+
+/* Tabla de decodificación: entrada = (símbolo << 4) | longitud, 0 si el código no existe */
+static int ConstruirTabla(const unsigned char *longitudes, unsigned int n, unsigned short *tabla) {
+    unsigned short codigos[LZ77_ENTROPIA_LITERALES];
+    register unsigned int i, k;
+
+    if (CodigosCanonicos(longitudes, n, codigos) != 0)
+        return -1;
+    memset(tabla, 0, (1u << LZ77_ENTROPIA_BITS_TABLA) * sizeof(unsigned short));
+    for (i = 0; i < n; i++)
+        if (longitudes[i])
+            for (k = codigos[i]; k < (1u << LZ77_ENTROPIA_BITS_TABLA); k += 1u << longitudes[i])
+                tabla[k] = (unsigned short)((i << 4) | longitudes[i]);
+    return 0;
+}
+
+/* Escritor de bits con comprobación de capacidad: al desbordarse descarta el resto */
+typedef struct EscritorEntropia {
+    unsigned long long acumulador;
+    unsigned int num_bits;
+    unsigned char *out;
+    unsigned int pos, capacidad;
+    int desbordado;
+} EscritorEntropia;
+
+static inline void Poner(EscritorEntropia *e, unsigned int valor, unsigned int num_bits) {
+    e->acumulador |= (unsigned long long)valor << e->num_bits;
+    e->num_bits += num_bits;
+    if (e->num_bits < 32)
+        return;
+    if (e->capacidad - e->pos >= 8) {
+        Escribir64(e->out + e->pos, e->acumulador);
+        e->pos += e->num_bits >> 3;
+        e->acumulador >>= e->num_bits & ~7u;
+        e->num_bits &= 7;
+        return;
+    }
+    while (e->num_bits >= 8) {
+        if (e->pos >= e->capacidad) {
+            e->desbordado = 1;
+            e->acumulador = 0;
+            e->num_bits = 0;
+            return;
+        }
+        e->out[e->pos++] = (unsigned char)e->acumulador;
+        e->acumulador >>= 8;
+        e->num_bits -= 8;
+    }
+}
+
+static void EscribirLongitudes(EscritorEntropia *e, const unsigned char *longitudes, unsigned int n, unsigned int bits_cuenta) {
+    register unsigned int i, racha;
+    while (n && !longitudes[n - 1])
+        n--;
+    Poner(e, n, bits_cuenta);
+    for (i = 0; i < n;) {
+        for (racha = 0; i + racha < n && racha < 34 && !longitudes[i + racha]; racha++)
+            ;
+        if (racha >= 3) {
+            Poner(e, LZ77_ENTROPIA_RACHA, 4);
+            Poner(e, racha - 3, 5);
+            i += racha;
+        } else {
+            Poner(e, longitudes[i++], 4);
+        }
+    }
+}
+
+/* Lector de los tokens sin recodificar (terminan con la marca de fin y LZ77_MARGEN_TOKENS ceros) */
+typedef struct LectorTokens {
+    const unsigned char *p;
+    unsigned long long bits;
+    unsigned int num_bits;
+} LectorTokens;
+
+typedef struct FormatoTokens {
+    unsigned int bits_literal, bits_longitud, bits_token;
+    unsigned long long mascara_caracter, mascara_longitud, mascara_distancia;
+    unsigned int marca_fin;
+    unsigned int codigos, bits_cubeta;
+} FormatoTokens;
+
+/* Coincidencia con códigos variables: el campo de longitud ya leído en *a (marca_fin
+ * es el escape) y la cubeta 0 como marca de fin. Una extensión no válida también
+ * termina la lectura */
+static inline int LeerCoincidenciaVariable(LectorTokens *l, const FormatoTokens *f, unsigned int *a, unsigned int *b) {
+    unsigned int c, extension;
+    l->bits >>= f->bits_longitud;
+    l->num_bits -= f->bits_longitud;
+    if (*a == f->marca_fin) {
+        c = DecodificarExtension(l->bits, &extension);
+        if (c == 0)
+            return -1;
+        *a += extension;
+        l->bits >>= c;
+        l->num_bits -= c;
+    }
+    l->bits |= Leer64(l->p) << l->num_bits;
+    l->p += (63 - l->num_bits) >> 3;
+    l->num_bits |= 56;
+    c = (unsigned int)l->bits & ((1u << f->bits_cubeta) - 1);
+    if (c == 0)
+        return -1;
+    *b = (1u << (c - 1)) | (unsigned int)((l->bits >> f->bits_cubeta) & ((1ULL << (c - 1)) - 1));
+    l->bits >>= f->bits_cubeta + c - 1;
+    l->num_bits -= f->bits_cubeta + c - 1;
+    return 1;
+}
+
+/* Lee un token: devuelve 0 si es un literal (en *a), 1 si es una coincidencia (longitud
+ * - (umbral + 1) en *a y distancia en *b) y -1 si es la marca de fin */
+static inline int LeerToken(LectorTokens *l, const FormatoTokens *f, unsigned int *a, unsigned int *b) {
+    l->bits |= Leer64(l->p) << l->num_bits;
+    l->p += (63 - l->num_bits) >> 3;
+    l->num_bits |= 56;
+    if ((l->bits & 1) == 0) {
+        *a = (unsigned int)((l->bits >> 1) & f->mascara_caracter);
+        l->bits >>= f->bits_literal;
+        l->num_bits -= f->bits_literal;
+        return 0;
+    }
+    *a = (unsigned int)((l->bits >> 1) & f->mascara_longitud);
+    if (f->codigos == LZ77_CODIGOS_VARIABLES)
+        return LeerCoincidenciaVariable(l, f, a, b);
+    if (*a == f->marca_fin)
+        return -1;
+    *b = (unsigned int)((l->bits >> f->bits_longitud) & f->mascara_distancia);
+    l->bits >>= f->bits_token;
+    l->num_bits -= f->bits_token;
+    return 1;
+}
+
+int CodificarEntropia(const LZ77Contexto *ctx, const unsigned char *tokens, unsigned char *output, unsigned int output_capacity) {
+    unsigned int frec_literales[LZ77_ENTROPIA_LITERALES], frec_distancias[LZ77_ENTROPIA_DISTANCIAS];
+    unsigned char long_literales[LZ77_ENTROPIA_LITERALES], long_distancias[LZ77_ENTROPIA_DISTANCIAS];
+    unsigned short cod_literales[LZ77_ENTROPIA_LITERALES], cod_distancias[LZ77_ENTROPIA_DISTANCIAS];
+    const LZ77Params *params = &ctx->params;
+    EscritorEntropia e;
+    LectorTokens l, inicio;
+    FormatoTokens f;
+    unsigned int a, b, c, x, num_tokens, ultimo;
+    register unsigned int i;
+    int t;
+
+    if (params->bits_caracter > 8 || params->bits_coincidencia > 16)
+        return -1;
+    f.bits_literal = 1 + params->bits_caracter;
+    f.bits_longitud = 1 + params->bits_coincidencia;
+    f.bits_token = f.bits_longitud + params->bits_diccionario;
+    f.mascara_caracter = (1ULL << params->bits_caracter) - 1;
+    f.mascara_longitud = (1ULL << params->bits_coincidencia) - 1;
+    f.mascara_distancia = (1ULL << params->bits_diccionario) - 1;
+    f.marca_fin = (1u << params->bits_coincidencia) - 1;
+    f.codigos = (unsigned int)params->codigos;
+    f.bits_cubeta = BitsCubeta(params->bits_diccionario);
+
+    memset(&e, 0, sizeof(e));
+    e.out = output;
+    e.capacidad = output_capacity;
+    l.p = tokens;
+    l.bits = 0;
+    l.num_bits = 0;
+
+    do {
+        /* Primera pasada: frecuencias del segmento */
+        memset(frec_literales, 0, sizeof(frec_literales));
+        memset(frec_distancias, 0, sizeof(frec_distancias));
+        inicio = l;
+        ultimo = 0;
+        for (num_tokens = 0; num_tokens < LZ77_ENTROPIA_SEGMENTO; num_tokens++) {
+            t = LeerToken(&l, &f, &a, &b);
+            if (t < 0) {
+                ultimo = 1;
+                break;
+            }
+            if (t == 0) {
+                frec_literales[a]++;
+            } else {
+                frec_literales[LZ77_ENTROPIA_FIN + 1 + CodigoAgrupado(a, 4, &x)]++;
+                frec_distancias[CodigoAgrupado(b, 2, &x)]++;
+            }
+        }
+        if (!ultimo) {
+            /* Un segmento lleno también es el último si le sigue la marca de fin */
+            LectorTokens siguiente = l;
+            ultimo = LeerToken(&siguiente, &f, &a, &b) < 0;
+        }
+        frec_literales[LZ77_ENTROPIA_FIN] = 1;
+        LongitudesHuffman(frec_literales, LZ77_ENTROPIA_LITERALES, long_literales);
+        LongitudesHuffman(frec_distancias, LZ77_ENTROPIA_DISTANCIAS, long_distancias);
+        CodigosCanonicos(long_literales, LZ77_ENTROPIA_LITERALES, cod_literales);
+        CodigosCanonicos(long_distancias, LZ77_ENTROPIA_DISTANCIAS, cod_distancias);
+
+        Poner(&e, ultimo, 1);
+        EscribirLongitudes(&e, long_literales, LZ77_ENTROPIA_LITERALES, 9);
+        EscribirLongitudes(&e, long_distancias, LZ77_ENTROPIA_DISTANCIAS, 6);
+
+        /* Segunda pasada: los mismos tokens, recodificados */
+        l = inicio;
+        for (i = 0; i < num_tokens && !e.desbordado; i++) {
+            if (LeerToken(&l, &f, &a, &b) == 0) {
+                Poner(&e, cod_literales[a], long_literales[a]);
+                continue;
+            }
+            c = LZ77_ENTROPIA_FIN + 1 + CodigoAgrupado(a, 4, &x);
+            Poner(&e, cod_literales[c], long_literales[c]);
+            Poner(&e, a & ((1u << x) - 1), x);
+            c = CodigoAgrupado(b, 2, &x);
+            Poner(&e, cod_distancias[c], long_distancias[c]);
+            Poner(&e, b & ((1u << x) - 1), x);
+        }
+        Poner(&e, cod_literales[LZ77_ENTROPIA_FIN], long_literales[LZ77_ENTROPIA_FIN]);
+    } while (!ultimo && !e.desbordado);
+
+    Poner(&e, 0, (8 - (e.num_bits & 7)) & 7);
+    while (e.num_bits && !e.desbordado) {
+        if (e.pos >= e.capacidad)
+            return -1;
+        e.out[e.pos++] = (unsigned char)e.acumulador;
+        e.acumulador >>= 8;
+        e.num_bits -= 8;
+    }
+    return e.desbordado ? -1 : (int)e.pos;
+}
+
+/*
+ * Decodificación: como DecodificarBufferCtx, con un acumulador de 64 bits que cada
+ * recarga deja con al menos 56 bits. Un símbolo y sus bits extra ocupan como mucho
+ * 11 + 24 bits, así que se recarga antes de cada símbolo. Cerca del final de la entrada
+ * la recarga es byte a byte y rellena con ceros; al terminar se comprueba que no se
+ * consumieron bits inexistentes.
+ */
+#define LZ77_RECARGAR()                                                     \
+    do {                                                                    \
+        if (in_fin - in >= 8) {                                             \
+            bits |= Leer64(in) << num_bits;                                 \
+            in += (63 - num_bits) >> 3;                                     \
+            num_bits |= 56;                                                 \
+        } else {                                                            \
+            while (num_bits < 56) {                                         \
+                if (in < in_fin)                                            \
+                    bits |= (unsigned long long)*in << num_bits;            \
+                in++;                                                       \
+                num_bits += 8;                                              \
+            }                                                               \
+        }                                                                   \
+    } while (0)
+
+#define LZ77_LEER(destino, n)                                               \
+    do {                                                                    \
+        LZ77_RECARGAR();                                                    \
+        destino = (unsigned int)(bits & ((1ULL << (n)) - 1));               \
+        bits >>= (n);                                                       \
+        num_bits -= (n);                                                    \
+    } while (0)
+
+/* Lee las longitudes de código de un alfabeto; devuelve 0 o -1 si no son válidas */
+#define LZ77_LEER_LONGITUDES(longitudes, tam, bits_cuenta)                  \
+    do {                                                                    \
+        unsigned int n_, i_ = 0, v_, r_;                                    \
+        memset(longitudes, 0, tam);                                         \
+        LZ77_LEER(n_, bits_cuenta);                                         \
+        if (n_ > tam)                                                       \
+            goto corrupto;                                                  \
+        while (i_ < n_) {                                                   \
+            LZ77_LEER(v_, 4);                                               \
+            if (v_ == LZ77_ENTROPIA_RACHA) {                                \
+                LZ77_LEER(r_, 5);                                           \
+                i_ += r_ + 3;                                               \
+                if (i_ > n_)                                                \
+                    goto corrupto;                                          \
+            } else {                                                        \
+                longitudes[i_++] = (unsigned char)v_;                       \
+            }                                                               \
+        }                                                                   \
+    } while (0)
+
+int DecodificarEntropia(LZ77Contexto *ctx, const unsigned char *input, unsigned int input_size, unsigned char *output, unsigned int output_capacity) {
+    unsigned short tabla_literales[1 << LZ77_ENTROPIA_BITS_TABLA], tabla_distancias[1 << LZ77_ENTROPIA_BITS_TABLA];
+    unsigned char long_literales[LZ77_ENTROPIA_LITERALES], long_distancias[LZ77_ENTROPIA_DISTANCIAS];
+    unsigned int base_longitud[LZ77_ENTROPIA_LONGITUDES], base_distancia[LZ77_ENTROPIA_DISTANCIAS];
+    unsigned char extra_longitud[LZ77_ENTROPIA_LONGITUDES], extra_distancia[LZ77_ENTROPIA_DISTANCIAS];
+    const unsigned int mascara_tabla = (1u << LZ77_ENTROPIA_BITS_TABLA) - 1;
+    const unsigned int longitud_minima = ctx->params.umbral + 1;
+    const unsigned int max_coincidencia = ctx->derived.max_coincidencia;
+    const unsigned char *in = input, *in_fin = input + input_size;
+    unsigned char *out = output, *out_fin = output + output_capacity;
+    unsigned long long bits = 0;
+    unsigned int num_bits = 0, ultimo, entrada, simbolo, k, distancia, x;
+
+    TablaAgrupada(LZ77_ENTROPIA_LONGITUDES, 4, base_longitud, extra_longitud);
+    TablaAgrupada(LZ77_ENTROPIA_DISTANCIAS, 2, base_distancia, extra_distancia);
+    do {
+        LZ77_LEER(ultimo, 1);
+        LZ77_LEER_LONGITUDES(long_literales, LZ77_ENTROPIA_LITERALES, 9);
+        LZ77_LEER_LONGITUDES(long_distancias, LZ77_ENTROPIA_DISTANCIAS, 6);
+        if (ConstruirTabla(long_literales, LZ77_ENTROPIA_LITERALES, tabla_literales) != 0 ||
+            ConstruirTabla(long_distancias, LZ77_ENTROPIA_DISTANCIAS, tabla_distancias) != 0)
+            goto corrupto;
+
+        for (;;) {
+            LZ77_RECARGAR();
+            entrada = tabla_literales[bits & mascara_tabla];
+            if (!entrada)
+                goto corrupto;
+            bits >>= entrada & 15;
+            num_bits -= entrada & 15;
+            simbolo = entrada >> 4;
+            if (simbolo < LZ77_ENTROPIA_FIN) {
+                if (out >= out_fin)
+                    goto salida_llena;
+                LZ77_ESTADISTICA(ctx->estadisticas.literales++);
+                *out++ = (unsigned char)simbolo;
+                /* Quedan bits para otro literal sin recargar */
+                entrada = tabla_literales[bits & mascara_tabla];
+                if (entrada && (entrada >> 4) < LZ77_ENTROPIA_FIN && out < out_fin) {
+                    bits >>= entrada & 15;
+                    num_bits -= entrada & 15;
+                    LZ77_ESTADISTICA(ctx->estadisticas.literales++);
+                    *out++ = (unsigned char)(entrada >> 4);
+                }
+                continue;
+            }
+            if (simbolo == LZ77_ENTROPIA_FIN)
+                break;
+            simbolo -= LZ77_ENTROPIA_FIN + 1;
+            x = extra_longitud[simbolo];
+            k = base_longitud[simbolo] + (unsigned int)(bits & ((1ULL << x) - 1)) + longitud_minima;
+            bits >>= x;
+            num_bits -= x;
+
+            LZ77_RECARGAR();
+            entrada = tabla_distancias[bits & mascara_tabla];
+            if (!entrada)
+                goto corrupto;
+            bits >>= entrada & 15;
+            num_bits -= entrada & 15;
+            x = extra_distancia[entrada >> 4];
+            distancia = base_distancia[entrada >> 4] + (unsigned int)(bits & ((1ULL << x) - 1));
+            bits >>= x;
+            num_bits -= x;
+
+            if (k > max_coincidencia)
+                goto corrupto;
+            if (distancia == 0 || distancia > (unsigned int)(out - output) + ctx->tam_prefijo)
+                goto distancia_no_valida;
+            if (k > (unsigned int)(out_fin - out))
+                goto salida_llena;
+            LZ77_ESTADISTICA(RegistrarToken(&ctx->estadisticas, k, distancia));
+            if (distancia > (unsigned int)(out - output)) {
+                CopiarDesdePrefijo(out, (unsigned int)(out - output), ctx->prefijo, ctx->tam_prefijo, distancia, k);
+                out += k;
+            } else if ((unsigned int)(out_fin - out) >= k + LZ77_MARGEN_COPIA) {
+                CopiarCoincidencia(out, distancia, k);
+                out += k;
+            } else {
+                do {
+                    *out = *(out - distancia);
+                    out++;
+                } while (--k);
+            }
+        }
+    } while (!ultimo);
+
+    /* Bytes realmente consumidos: los leídos menos los que siguen en el acumulador */
+    if ((unsigned long long)(in - input) - (num_bits >> 3) > input_size)
+        goto entrada_insuficiente;
+    ctx->in_pos = input_size;
+    ctx->out_pos = (unsigned int)(out - output);
+    return ctx->out_pos;
+
+corrupto:
+    if ((unsigned long long)(in - input) - (num_bits >> 3) > input_size)
+        goto entrada_insuficiente;
+    fprintf(stderr, "Códigos de entropía no válidos (descompresión)\n");
+    return -1;
+entrada_insuficiente:
+    fprintf(stderr, "\nBuffer de entrada insuficiente (descompresión)");
+    return -1;
+salida_llena:
+    fprintf(stderr, "Buffer de salida lleno (descompresión)\n");
+    return -1;
+distancia_no_valida:
+    fprintf(stderr, "Distancia no válida (descompresión)\n");
+    return -1;
+}
+
+#endif
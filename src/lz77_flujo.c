@@ -0,0 +1,307 @@
+/* Compresión/descompresión en flujo con memoria acotada */
+
+#ifndef LZ77_FLUJO_C
+#define LZ77_FLUJO_C
+#include "lz77_flujo.h"
+#include "lz77_interno.h"
+
+static LZ77Flujo *CrearFlujo(const LZ77Params *params, int codificando) {
+    LZ77Flujo *flujo;
+    /* La etapa de entropía necesita los tokens de todo el buffer */
+    if (params->entropia != LZ77_ENTROPIA_NINGUNA)
+        return NULL;
+    flujo = (LZ77Flujo *)calloc(1, sizeof(LZ77Flujo));
+    if (!flujo)
+        return NULL;
+    flujo->codificando = codificando;
+    flujo->ctx = codificando ? CrearContexto(params) : CrearContextoDecodificacion(params);
+    if (!flujo->ctx) {
+        free(flujo);
+        return NULL;
+    }
+    /* El decodificador solo necesita la ventana circular, que DestruirContexto libera */
+    if (!codificando && !(flujo->ctx->diccionario = (unsigned char *)malloc(flujo->ctx->derived.tam_diccionario))) {
+        DestruirFlujo(flujo);
+        return NULL;
+    }
+    if (codificando) {
+        /* Cabe la salida de un sector completo más la marca de fin, con el margen de 8
+         * bytes que necesita el escritor rápido de BuscarEnDiccionarioCtx */
+        flujo->tam_pendiente = (unsigned int)CotaCompresion(params, flujo->ctx->derived.tam_sector) + 8;
+        flujo->pendiente = (unsigned char *)malloc(flujo->tam_pendiente);
+        if (!flujo->pendiente) {
+            DestruirFlujo(flujo);
+            return NULL;
+        }
+    }
+    return flujo;
+}
+
+LZ77Flujo *CrearFlujoCodificacion(const LZ77Params *params) {
+    return CrearFlujo(params, 1);
+}
+
+LZ77Flujo *CrearFlujoDecodificacion(const LZ77Params *params) {
+    return CrearFlujo(params, 0);
+}
+
+void DestruirFlujo(LZ77Flujo *flujo) {
+    if (!flujo)
+        return;
+    DestruirContexto(flujo->ctx);
+    free(flujo->pendiente);
+    free(flujo);
+}
+
+/* Entrega al llamante los bytes codificados pendientes */
+static void EntregarPendiente(LZ77Flujo *flujo) {
+    LZ77Contexto *ctx = flujo->ctx;
+    size_t n = ctx->out_pos - flujo->inicio_pendiente;
+    if (n > flujo->disponible_salida)
+        n = flujo->disponible_salida;
+    if (n)
+        memcpy(flujo->salida, flujo->pendiente + flujo->inicio_pendiente, n);
+    flujo->salida += n;
+    flujo->disponible_salida -= n;
+    flujo->total_salida += n;
+    flujo->inicio_pendiente += n;
+    if (flujo->inicio_pendiente == ctx->out_pos)
+        flujo->inicio_pendiente = ctx->out_pos = 0;
+}
+
+/* Copia al sector actual tanta entrada como quepa */
+static void CargarEntrada(LZ77Flujo *flujo) {
+    LZ77Contexto *ctx = flujo->ctx;
+    const DerivedParams *derived = &ctx->derived;
+    size_t n = derived->tam_sector - flujo->cargados;
+    if (n > flujo->disponible_entrada)
+        n = flujo->disponible_entrada;
+    if (n == 0)
+        return;
+    memcpy(ctx->diccionario + flujo->posicion_sector + flujo->cargados, flujo->entrada, n);
+    flujo->entrada += n;
+    flujo->disponible_entrada -= n;
+    flujo->total_entrada += n;
+    flujo->cargados += (unsigned int)n;
+    if (!flujo->marcar_para_eliminar)
+        LimpiarTrasDatos(ctx, flujo->posicion_sector + flujo->cargados);
+    if (flujo->posicion_sector == 0)
+        memcpy(ctx->diccionario + derived->tam_diccionario, ctx->diccionario, derived->max_coincidencia);
+}
+
+/* Hashea y codifica los bytes cargados del sector que aún no se han procesado */
+static void ProcesarSector(LZ77Flujo *flujo) {
+    LZ77Contexto *ctx = flujo->ctx;
+    unsigned int umbral = ctx->params.umbral;
+    unsigned int bytes = flujo->cargados - flujo->hasheados;
+
+    ctx->out_ptr = flujo->pendiente;
+    ctx->out_capacity = flujo->tam_pendiente;
+    LZ77_CRONOMETRAR(ctx, ns_hashear, HashearDatosCtx(ctx, flujo->posicion_sector + flujo->hasheados, bytes));
+    /* Los últimos 'umbral' bytes no se pueden hashear hasta que llegue más entrada */
+    if (bytes > umbral)
+        flujo->hasheados += bytes - umbral;
+    LZ77_CRONOMETRAR(ctx, ns_busqueda,
+                     BuscarEnDiccionarioCtx(ctx, flujo->posicion_sector + flujo->procesados, flujo->cargados - flujo->procesados));
+    flujo->procesados = flujo->cargados;
+}
+
+/* Pasa al siguiente sector, liberando el que se va a sobrescribir */
+static void AvanzarSector(LZ77Flujo *flujo) {
+    LZ77Contexto *ctx = flujo->ctx;
+    flujo->posicion_sector += ctx->derived.tam_sector;
+    if (flujo->posicion_sector == ctx->derived.tam_diccionario) {
+        flujo->posicion_sector = 0;
+        flujo->marcar_para_eliminar = 1;
+    }
+    flujo->cargados = flujo->hasheados = flujo->procesados = 0;
+    if (flujo->marcar_para_eliminar)
+        LZ77_CRONOMETRAR(ctx, ns_eliminar, EliminarDatosCtx(ctx, flujo->posicion_sector));
+}
+
+int CodificarFlujo(LZ77Flujo *flujo, int modo) {
+    LZ77Contexto *ctx;
+    if (!flujo || !flujo->codificando)
+        return LZ77_FLUJO_ERROR;
+    ctx = flujo->ctx;
+
+    for (;;) {
+        EntregarPendiente(flujo);
+        if (ctx->out_pos)
+            return LZ77_FLUJO_OK;          /* Falta espacio de salida */
+        if (flujo->terminado)
+            return LZ77_FLUJO_FIN;
+
+        if (flujo->procesados == ctx->derived.tam_sector)
+            AvanzarSector(flujo);
+        CargarEntrada(flujo);
+
+        if (flujo->cargados == ctx->derived.tam_sector ||
+            (modo != LZ77_FLUJO_CONTINUAR && flujo->cargados > flujo->procesados)) {
+            ProcesarSector(flujo);
+            continue;
+        }
+        if (modo == LZ77_FLUJO_FINALIZAR && flujo->disponible_entrada == 0) {
+            ctx->out_ptr = flujo->pendiente;
+            ctx->out_capacity = flujo->tam_pendiente;
+            EnviarFinCtx(ctx);
+            if (ctx->bits_en)
+                EnviarBitsCtx(ctx, 0, 8 - ctx->bits_en);
+            flujo->terminado = 1;
+            continue;
+        }
+        return LZ77_FLUJO_OK;              /* Falta entrada */
+    }
+}
+
+/* Lee num_bits del acumulador de 64 bits (el llamante ya comprobó que hay suficientes) */
+static unsigned int ConsumirBits(LZ77Flujo *flujo, unsigned int num_bits) {
+    unsigned int v = (unsigned int)(flujo->bits & ((1ULL << num_bits) - 1));
+    flujo->bits >>= num_bits;
+    flujo->num_bits -= num_bits;
+    return v;
+}
+
+/* La distancia ha de caer en lo ya decodificado y dentro de la ventana: el diccionario
+ * no se inicializa, así que más atrás solo hay memoria sin escribir */
+static int DistanciaValida(const LZ77Flujo *flujo, unsigned int distancia) {
+    return distancia != 0 && distancia <= flujo->total_salida && distancia <= flujo->ctx->derived.tam_diccionario;
+}
+
+/*
+ * Coincidencia con códigos variables. Con la extensión el token puede pasar de los 57
+ * bits que garantiza la recarga, así que la longitud y la distancia se leen por separado
+ * (la longitud queda en longitud_pendiente). Devuelve 1 si se leyó la coincidencia o la
+ * marca de fin, 0 si faltan bits y -1 si el token no es válido.
+ */
+static int LeerCoincidenciaVariable(LZ77Flujo *flujo) {
+    LZ77Contexto *ctx = flujo->ctx;
+    const LZ77Params *params = &ctx->params;
+    const unsigned int bits_longitud = 1 + params->bits_coincidencia;
+    const unsigned int bits_cubeta = BitsCubeta(params->bits_diccionario);
+    unsigned int k, n = 0, extension, cubeta, distancia;
+
+    if (!flujo->longitud_pendiente) {
+        if (flujo->num_bits < bits_longitud)
+            return 0;
+        k = (unsigned int)((flujo->bits >> 1) & ((1ULL << params->bits_coincidencia) - 1)) + params->umbral + 1;
+        if (k == LongitudEscape(params)) {
+            /* Los bits que aún no han llegado son ceros: la extensión no parece más larga */
+            n = DecodificarExtension(flujo->bits >> bits_longitud, &extension);
+            if (n == 0)
+                return -1;
+            k += extension;
+        }
+        if (flujo->num_bits < bits_longitud + n)
+            return 0;
+        ConsumirBits(flujo, bits_longitud + n);
+        flujo->longitud_pendiente = k;
+    }
+
+    if (flujo->num_bits < bits_cubeta)
+        return 0;
+    cubeta = (unsigned int)flujo->bits & ((1u << bits_cubeta) - 1);
+    if (cubeta == 0) {
+        ConsumirBits(flujo, bits_cubeta);
+        flujo->longitud_pendiente = 0;
+        flujo->terminado = 1;
+        return 1;
+    }
+    if (cubeta > (unsigned int)params->bits_diccionario)
+        return -1;
+    if (flujo->num_bits < bits_cubeta + cubeta - 1)
+        return 0;
+    ConsumirBits(flujo, bits_cubeta);
+    distancia = (1u << (cubeta - 1)) | ConsumirBits(flujo, cubeta - 1);
+    if (!DistanciaValida(flujo, distancia))
+        return -1;
+    flujo->copia_desde = (flujo->posicion - distancia) & (ctx->derived.tam_diccionario - 1);
+    flujo->copia_restante = flujo->longitud_pendiente;
+    flujo->longitud_pendiente = 0;
+    return 1;
+}
+
+int DecodificarFlujo(LZ77Flujo *flujo, int modo) {
+    LZ77Contexto *ctx;
+    unsigned char *dic;
+    unsigned int mascara, bits_literal, bits_longitud, bits_coincidencia, distancia;
+
+    if (!flujo || flujo->codificando)
+        return LZ77_FLUJO_ERROR;
+    ctx = flujo->ctx;
+    dic = ctx->diccionario;
+    mascara = ctx->derived.tam_diccionario - 1;
+    bits_literal = 1 + ctx->params.bits_caracter;
+    bits_longitud = 1 + ctx->params.bits_coincidencia;
+    bits_coincidencia = bits_longitud + ctx->params.bits_diccionario;
+
+    for (;;) {
+        /* Terminar la copia de una coincidencia interrumpida por falta de salida */
+        while (flujo->copia_restante && flujo->disponible_salida) {
+            unsigned char c = dic[flujo->copia_desde];
+            dic[flujo->posicion] = c;
+            *flujo->salida++ = c;
+            flujo->disponible_salida--;
+            flujo->total_salida++;
+            flujo->posicion = (flujo->posicion + 1) & mascara;
+            flujo->copia_desde = (flujo->copia_desde + 1) & mascara;
+            flujo->copia_restante--;
+        }
+        if (flujo->copia_restante)
+            return LZ77_FLUJO_OK;
+        if (flujo->terminado)
+            return LZ77_FLUJO_FIN;
+
+        while (flujo->num_bits <= 56 && flujo->disponible_entrada) {
+            flujo->bits |= (unsigned long long)*flujo->entrada++ << flujo->num_bits;
+            flujo->num_bits += 8;
+            flujo->disponible_entrada--;
+            flujo->total_entrada++;
+        }
+
+        if (flujo->longitud_pendiente == 0 && flujo->num_bits && (flujo->bits & 1) == 0) {
+            if (flujo->num_bits < bits_literal)
+                break;
+            if (flujo->disponible_salida == 0)
+                return LZ77_FLUJO_OK;
+            ConsumirBits(flujo, 1);
+            dic[flujo->posicion] = (unsigned char)ConsumirBits(flujo, ctx->params.bits_caracter);
+            *flujo->salida++ = dic[flujo->posicion];
+            flujo->disponible_salida--;
+            flujo->total_salida++;
+            flujo->posicion = (flujo->posicion + 1) & mascara;
+        } else if (ctx->params.codigos == LZ77_CODIGOS_VARIABLES) {
+            int leido = LeerCoincidenciaVariable(flujo);
+            if (leido < 0)
+                return LZ77_FLUJO_ERROR;
+            if (leido == 0)
+                break;
+        } else if (flujo->num_bits >= bits_longitud) {
+            unsigned int k = (unsigned int)((flujo->bits >> 1) & ((1ULL << ctx->params.bits_coincidencia) - 1)) + ctx->params.umbral + 1;
+            if (k == ctx->derived.max_coincidencia + 1) {
+                ConsumirBits(flujo, bits_longitud);
+                flujo->terminado = 1;
+                continue;
+            }
+            if (flujo->num_bits < bits_coincidencia)
+                break;
+            ConsumirBits(flujo, bits_longitud);
+            distancia = ConsumirBits(flujo, ctx->params.bits_diccionario);
+            if (!DistanciaValida(flujo, distancia))
+                return LZ77_FLUJO_ERROR;
+            flujo->copia_desde = (flujo->posicion - distancia) & mascara;
+            flujo->copia_restante = k;
+        } else {
+            break;
+        }
+    }
+
+    /* Token incompleto: esperar más entrada salvo que no vaya a llegar */
+    if (modo == LZ77_FLUJO_FINALIZAR) {
+        fprintf(stderr, "Flujo de entrada truncado (descompresión)\n");
+        return LZ77_FLUJO_ERROR;
+    }
+    return LZ77_FLUJO_OK;
+}
+
+#endif
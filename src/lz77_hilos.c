@@ -0,0 +1,244 @@
+/* Pool de hilos mínimo para los modos paralelos de LZ77 */
+
+#ifndef LZ77_HILOS_C
+#define LZ77_HILOS_C
+#include <stdlib.h>
+#include <pthread.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+#include "lz77_hilos.h"
+
+typedef struct Pool {
+    pthread_mutex_t mutex;
+    unsigned int siguiente_tarea, num_tareas;
+    int error;
+    LZ77Tarea funcion;
+    void *datos;
+} Pool;
+
+typedef struct Trabajador {
+    Pool *pool;
+    unsigned int hilo;
+} Trabajador;
+
+int LZ77NumeroNucleos(void) {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+#endif
+}
+
+int LZ77HilosEfectivos(int num_hilos, unsigned int num_tareas) {
+    if (num_hilos <= 0)
+        num_hilos = LZ77NumeroNucleos();
+    if (num_tareas && (unsigned int)num_hilos > num_tareas)
+        num_hilos = (int)num_tareas;
+    return num_hilos > 0 ? num_hilos : 1;
+}
+
+static void *BucleTrabajador(void *arg) {
+    Trabajador *t = (Trabajador *)arg;
+    Pool *pool = t->pool;
+    unsigned int tarea;
+
+    for (;;) {
+        pthread_mutex_lock(&pool->mutex);
+        if (pool->error || pool->siguiente_tarea >= pool->num_tareas) {
+            pthread_mutex_unlock(&pool->mutex);
+            return NULL;
+        }
+        tarea = pool->siguiente_tarea++;
+        pthread_mutex_unlock(&pool->mutex);
+
+        if (pool->funcion(pool->datos, t->hilo, tarea) != 0) {
+            pthread_mutex_lock(&pool->mutex);
+            pool->error = 1;
+            pthread_mutex_unlock(&pool->mutex);
+        }
+    }
+}
+
+int LZ77EjecutarParalelo(int num_hilos, unsigned int num_tareas, LZ77Tarea funcion, void *datos) {
+    register unsigned int i;
+    Pool pool;
+    Trabajador *trabajadores;
+    pthread_t *hilos;
+    unsigned char *creado;
+
+    num_hilos = LZ77HilosEfectivos(num_hilos, num_tareas);
+    if (num_tareas == 0)
+        return 0;
+
+    /* Un solo hilo: ni mutex ni reservas */
+    if (num_hilos == 1) {
+        for (i = 0; i < num_tareas; i++)
+            if (funcion(datos, 0, i) != 0)
+                return -1;
+        return 0;
+    }
+
+    trabajadores = (Trabajador *)malloc(num_hilos * sizeof(Trabajador));
+    hilos = (pthread_t *)malloc(num_hilos * sizeof(pthread_t));
+    creado = (unsigned char *)calloc(num_hilos, 1);
+    if (!trabajadores || !hilos || !creado) {
+        free(trabajadores);
+        free(hilos);
+        free(creado);
+        return -1;
+    }
+
+    pool.siguiente_tarea = 0;
+    pool.num_tareas = num_tareas;
+    pool.error = 0;
+    pool.funcion = funcion;
+    pool.datos = datos;
+    pthread_mutex_init(&pool.mutex, NULL);
+
+    /* El hilo llamante actúa como trabajador 0 */
+    for (i = 0; i < (unsigned int)num_hilos; i++) {
+        trabajadores[i].pool = &pool;
+        trabajadores[i].hilo = i;
+        if (i > 0)
+            creado[i] = pthread_create(&hilos[i], NULL, BucleTrabajador, &trabajadores[i]) == 0;
+    }
+    BucleTrabajador(&trabajadores[0]);
+    for (i = 1; i < (unsigned int)num_hilos; i++)
+        if (creado[i])
+            pthread_join(hilos[i], NULL);
+
+    pthread_mutex_destroy(&pool.mutex);
+    free(trabajadores);
+    free(hilos);
+    free(creado);
+    return pool.error ? -1 : 0;
+}
+
+/* Estado de LZ77EjecutarEnOrden */
+typedef struct Cadena {
+    pthread_mutex_t mutex;
+    pthread_cond_t cambio;
+    unsigned int siguiente_tarea, consumidas, num_tareas, en_vuelo;
+    unsigned int *producidas;     /* producidas[t % en_vuelo] == t + 1: t está lista */
+    int error;
+    LZ77Tarea producir;
+    void *datos;
+} Cadena;
+
+typedef struct TrabajadorCadena {
+    Cadena *cadena;
+    unsigned int hilo;
+} TrabajadorCadena;
+
+/* Con el mutex tomado: produce la siguiente tarea si el buffer circular tiene sitio */
+static int ProducirSiguiente(Cadena *c, unsigned int hilo) {
+    unsigned int tarea;
+    int r;
+    if (c->error || c->siguiente_tarea >= c->num_tareas || c->siguiente_tarea - c->consumidas >= c->en_vuelo)
+        return 0;
+    tarea = c->siguiente_tarea++;
+    pthread_mutex_unlock(&c->mutex);
+    r = c->producir(c->datos, hilo, tarea);
+    pthread_mutex_lock(&c->mutex);
+    if (r != 0)
+        c->error = 1;
+    else
+        c->producidas[tarea % c->en_vuelo] = tarea + 1;
+    pthread_cond_broadcast(&c->cambio);
+    return 1;
+}
+
+static void *BucleCadena(void *arg) {
+    TrabajadorCadena *t = (TrabajadorCadena *)arg;
+    Cadena *c = t->cadena;
+
+    pthread_mutex_lock(&c->mutex);
+    while (!c->error && c->siguiente_tarea < c->num_tareas)
+        if (!ProducirSiguiente(c, t->hilo))
+            pthread_cond_wait(&c->cambio, &c->mutex);
+    pthread_mutex_unlock(&c->mutex);
+    return NULL;
+}
+
+int LZ77EjecutarEnOrden(int num_hilos, unsigned int num_tareas, unsigned int en_vuelo,
+                        LZ77Tarea producir, LZ77Tarea consumir, void *datos) {
+    register unsigned int i;
+    Cadena c;
+    TrabajadorCadena *trabajadores;
+    pthread_t *hilos;
+    unsigned char *creado;
+
+    num_hilos = LZ77HilosEfectivos(num_hilos, num_tareas);
+    if (num_tareas == 0)
+        return 0;
+    if (en_vuelo == 0)
+        en_vuelo = 1;
+
+    trabajadores = (TrabajadorCadena *)malloc(num_hilos * sizeof(TrabajadorCadena));
+    hilos = (pthread_t *)malloc(num_hilos * sizeof(pthread_t));
+    creado = (unsigned char *)calloc(num_hilos, 1);
+    c.producidas = (unsigned int *)calloc(en_vuelo, sizeof(unsigned int));
+    if (!trabajadores || !hilos || !creado || !c.producidas) {
+        free(trabajadores);
+        free(hilos);
+        free(creado);
+        free(c.producidas);
+        return -1;
+    }
+
+    c.siguiente_tarea = c.consumidas = 0;
+    c.num_tareas = num_tareas;
+    c.en_vuelo = en_vuelo;
+    c.error = 0;
+    c.producir = producir;
+    c.datos = datos;
+    pthread_mutex_init(&c.mutex, NULL);
+    pthread_cond_init(&c.cambio, NULL);
+
+    for (i = 1; i < (unsigned int)num_hilos; i++) {
+        trabajadores[i].cadena = &c;
+        trabajadores[i].hilo = i;
+        creado[i] = pthread_create(&hilos[i], NULL, BucleCadena, &trabajadores[i]) == 0;
+    }
+
+    /* El hilo llamante consume en orden y, mientras espera, produce */
+    pthread_mutex_lock(&c.mutex);
+    for (i = 0; i < num_tareas && !c.error; i++) {
+        while (!c.error && c.producidas[i % en_vuelo] != i + 1)
+            if (!ProducirSiguiente(&c, 0))
+                pthread_cond_wait(&c.cambio, &c.mutex);
+        if (c.error)
+            break;
+        pthread_mutex_unlock(&c.mutex);
+        if (consumir(datos, 0, i) != 0) {
+            pthread_mutex_lock(&c.mutex);
+            c.error = 1;
+            pthread_cond_broadcast(&c.cambio);
+            break;
+        }
+        pthread_mutex_lock(&c.mutex);
+        c.consumidas++;
+        pthread_cond_broadcast(&c.cambio);
+    }
+    pthread_mutex_unlock(&c.mutex);
+
+    for (i = 1; i < (unsigned int)num_hilos; i++)
+        if (creado[i])
+            pthread_join(hilos[i], NULL);
+
+    pthread_cond_destroy(&c.cambio);
+    pthread_mutex_destroy(&c.mutex);
+    free(trabajadores);
+    free(hilos);
+    free(creado);
+    free(c.producidas);
+    return c.error ? -1 : 0;
+}
+
+#endif
@@ -0,0 +1,273 @@
+// lz77_interno.h
+// Utilidades compartidas por los módulos de la biblioteca (no forman parte de la API)
+#ifndef LZ77_INTERNO_H
+#define LZ77_INTERNO_H
+
+#include "lz77.h"
+
+/* Bytes extra reservados tras el diccionario para lecturas de 8 bytes sin comprobar */
+#define LZ77_RELLENO_DICCIONARIO 8
+
+/* Funciones que deben expandirse en cada llamada para que sus argumentos constantes se
+ * plieguen (núcleos especializados de lz77.c) */
+#define LZ77_EN_LINEA static inline __attribute__((always_inline))
+
+/* Lectura little-endian de 8 bytes sin requisitos de alineación */
+static inline unsigned long long Leer64(const unsigned char *p) {
+    unsigned long long v;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    memcpy(&v, p, 8);
+#else
+    v = (unsigned long long)p[0]       | ((unsigned long long)p[1] << 8)  |
+        ((unsigned long long)p[2] << 16) | ((unsigned long long)p[3] << 24) |
+        ((unsigned long long)p[4] << 32) | ((unsigned long long)p[5] << 40) |
+        ((unsigned long long)p[6] << 48) | ((unsigned long long)p[7] << 56);
+#endif
+    return v;
+}
+
+/* Escritura little-endian de 8 bytes sin requisitos de alineación */
+static inline void Escribir64(unsigned char *p, unsigned long long v) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    memcpy(p, &v, 8);
+#else
+    register unsigned int i;
+    for (i = 0; i < 8; i++)
+        p[i] = (unsigned char)(v >> (8 * i));
+#endif
+}
+
+/* Lectura/escritura little-endian de 4 bytes */
+static inline void Escribir32(unsigned char *p, unsigned int v) {
+    p[0] = v & 0xFF; p[1] = (v >> 8) & 0xFF; p[2] = (v >> 16) & 0xFF; p[3] = (v >> 24) & 0xFF;
+}
+static inline unsigned int Leer32(const unsigned char *p) {
+    return (unsigned int)p[0] | ((unsigned int)p[1] << 8) | ((unsigned int)p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+/* Número de bytes iguales al principio de a y b (como mucho max), de 8 en 8 bytes */
+static inline unsigned int LongitudComun(const unsigned char *a, const unsigned char *b, unsigned int max) {
+    register unsigned int j = 0;
+    while (j + 8 <= max) {
+        unsigned long long x = Leer64(a + j) ^ Leer64(b + j);
+        if (x)
+            return j + (__builtin_ctzll(x) >> 3);
+        j += 8;
+    }
+    while (j < max && a[j] == b[j])
+        j++;
+    return j;
+}
+
+/*
+ * Tokens de coincidencia con LZ77_CODIGOS_VARIABLES: bandera 1, campo de longitud de
+ * bits_coincidencia bits (todo unos es el escape), la extensión si hubo escape, la
+ * cubeta de la distancia en BitsCubeta(bits_diccionario) bits y los cubeta - 1 bits
+ * que quedan bajo el más alto de la distancia. La cubeta 0 es la marca de fin.
+ *
+ * La extensión (longitud - LongitudEscape) va en grupos de 7 bits, empezando por los
+ * menos significativos, con el octavo bit a 1 si sigue otro grupo.
+ */
+#define LZ77_GRUPOS_EXTENSION 3
+
+static inline unsigned int BitsCubeta(unsigned int bits_diccionario) {
+    return 32 - __builtin_clz(bits_diccionario);
+}
+
+static inline unsigned int CubetaDistancia(unsigned int distancia) {
+    return 32 - __builtin_clz(distancia);
+}
+
+/* Longitud más corta que se codifica con escape */
+static inline unsigned int LongitudEscape(const LZ77Params *params) {
+    return (1u << params->bits_coincidencia) + params->umbral;
+}
+
+/*
+ * Con códigos variables los buscadores dejan de buscar al llegar a esta longitud (el
+ * nice_len de LZMA) y el árbol binario solo ordena hasta ella: sin el corte, dentro de
+ * una racha más corta que max_coincidencia cada búsqueda recorre la cadena entera.
+ */
+#define LZ77_LONGITUD_SUFICIENTE 273
+
+static inline unsigned int LongitudSuficiente(const LZ77Contexto *ctx) {
+    if (ctx->params.codigos == LZ77_CODIGOS_VARIABLES && ctx->derived.max_coincidencia > LZ77_LONGITUD_SUFICIENTE)
+        return LZ77_LONGITUD_SUFICIENTE;
+    return ctx->derived.max_coincidencia;
+}
+
+/* Devuelve los bits de la extensión y deja en *num_bits cuántos son */
+static inline unsigned int CodificarExtension(unsigned int extension, unsigned int *num_bits) {
+    unsigned int v = 0, n = 0;
+    while (extension >= 0x80) {
+        v |= ((extension & 0x7F) | 0x80) << n;
+        extension >>= 7;
+        n += 8;
+    }
+    *num_bits = n + 8;
+    return v | (extension << n);
+}
+
+/* Lee la extensión de los bits bajos de v: devuelve cuántos bits ocupa, o 0 si tiene
+ * más de LZ77_GRUPOS_EXTENSION grupos */
+static inline unsigned int DecodificarExtension(unsigned long long v, unsigned int *extension) {
+    unsigned int e = 0, n;
+    for (n = 0; n < 8 * LZ77_GRUPOS_EXTENSION; n += 8) {
+        e |= (unsigned int)((v >> n) & 0x7F) << (7 * (n >> 3));
+        if (!((v >> n) & 0x80)) {
+            *extension = e;
+            return n + 8;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Copia una coincidencia sobre la propia salida. Puede escribir hasta
+ * LZ77_MARGEN_COPIA bytes de más tras el final: el llamante garantiza el hueco.
+ */
+#define LZ77_MARGEN_COPIA 16
+static inline void CopiarCoincidencia(unsigned char *out, unsigned int distancia, unsigned int longitud) {
+    const unsigned char *src = out - distancia;
+    unsigned char *fin = out + longitud;
+    if (distancia >= 16) {
+        do {
+            memcpy(out, src, 16);
+            out += 16;
+            src += 16;
+        } while (out < fin);
+    } else if (distancia >= 8) {
+        do {
+            memcpy(out, src, 8);
+            out += 8;
+            src += 8;
+        } while (out < fin);
+    } else if (distancia == 1) {
+        memset(out, *src, longitud);
+    } else {
+        /* Distancias cortas: el patrón se solapa consigo mismo. En las coincidencias
+         * largas (rachas de LZ77_CODIGOS_VARIABLES) se repiten los 16 primeros bytes
+         * avanzando el mayor múltiplo de la distancia que cabe en ellos, sin releer lo
+         * que se acaba de escribir */
+        static const unsigned char pasos[8] = {0, 0, 16, 15, 16, 15, 12, 14};
+        unsigned char *inicio = out, *corte = longitud > 32 ? out + 16 : fin;
+        unsigned char patron[16];
+        do {
+            *out++ = *src++;
+        } while (out < corte);
+        if (out < fin) {
+            memcpy(patron, inicio, 16);
+            for (out = inicio + pasos[distancia]; out < fin; out += pasos[distancia])
+                memcpy(out, patron, 16);
+        }
+    }
+}
+
+/*
+ * Copia una coincidencia que empieza antes de la salida, dentro del diccionario
+ * prefijado que la precede: producidos son los bytes ya escritos en la salida y
+ * distancia > producidos. Devuelve -1 si la distancia sale también del prefijo.
+ */
+static inline int CopiarDesdePrefijo(unsigned char *out, unsigned int producidos, const unsigned char *prefijo,
+                                     unsigned int tam_prefijo, unsigned int distancia, unsigned int longitud) {
+    unsigned int atras = distancia - producidos, n, i;
+    if (atras > tam_prefijo)
+        return -1;
+    n = atras < longitud ? atras : longitud;
+    memcpy(out, prefijo + tam_prefijo - atras, n);
+    for (i = n; i < longitud; i++)
+        out[i] = (out - distancia)[i];
+    return 0;
+}
+
+/*
+ * Estadísticas: LZ77_ESTADISTICA(x) solo compila x con -DLZ77_ESTADISTICAS y
+ * LZ77_CRONOMETRAR suma al campo indicado el tiempo de la llamada.
+ */
+#ifdef LZ77_ESTADISTICAS
+#include <time.h>
+#define LZ77_ESTADISTICA(instruccion) instruccion
+#define LZ77_CRONOMETRAR(ctx, campo, llamada)                                   \
+    do {                                                                        \
+        unsigned long long inicio_ = LZ77Nanosegundos();                        \
+        llamada;                                                                \
+        (ctx)->estadisticas.campo += LZ77Nanosegundos() - inicio_;              \
+    } while (0)
+
+static inline unsigned long long LZ77Nanosegundos(void) {
+    struct timespec t;
+    timespec_get(&t, TIME_UTC);
+    return (unsigned long long)t.tv_sec * 1000000000ULL + (unsigned long long)t.tv_nsec;
+}
+
+static inline unsigned int CubetaHistograma(unsigned int v) {
+    return v ? 32 - __builtin_clz(v) : 0;
+}
+
+static inline void RegistrarToken(LZ77Estadisticas *e, unsigned int longitud, unsigned int distancia) {
+    if (longitud == 0) {
+        e->literales++;
+        return;
+    }
+    e->coincidencias++;
+    e->histograma_longitudes[CubetaHistograma(longitud)]++;
+    e->histograma_distancias[CubetaHistograma(distancia)]++;
+}
+
+static inline void RegistrarBusqueda(LZ77Estadisticas *e, unsigned int candidatos, int agotada) {
+    e->busquedas++;
+    e->candidatos += candidatos;
+    if (candidatos > e->profundidad_maxima)
+        e->profundidad_maxima = candidatos;
+    e->limite_alcanzado += agotada;
+}
+#else
+#define LZ77_ESTADISTICA(instruccion)
+#define LZ77_CRONOMETRAR(ctx, campo, llamada) llamada
+#endif
+
+/* Recorre la cadena hash en modo ventana grande (lz77.c) */
+void EncontrarCoincidenciaGrande(LZ77Contexto *ctx, unsigned int posicion, unsigned int longitud_inicial, unsigned int max_comparaciones);
+
+/* Buscadores alternativos (lz77_buscadores.c), usados cuando buscador != LZ77_BUSCADOR_CADENA */
+int ReservarBuscador(LZ77Contexto *ctx);
+void LiberarBuscador(LZ77Contexto *ctx);
+void InicializarBuscador(LZ77Contexto *ctx, int borrar_tablas);
+void HashearBuscador(LZ77Contexto *ctx, unsigned int posicion, unsigned int bytes_a_hashear);
+void EncontrarBuscador(LZ77Contexto *ctx, unsigned int posicion, unsigned int longitud_inicial);
+void RebasarBuscador(LZ77Contexto *ctx, unsigned int delta);
+
+/* Diccionario prefijado: lo coloca en la ventana y devuelve la posición donde empieza
+ * la entrada (lz77.c); copia el estado de un diccionario preparado (lz77_diccionario.c) */
+unsigned int CargarPrefijoCtx(LZ77Contexto *ctx);
+unsigned int RestaurarDiccionarioPreparado(LZ77Contexto *ctx);
+
+/* Marca de fin de los tokens según params.codigos (lz77.c) */
+void EnviarFinCtx(LZ77Contexto *ctx);
+
+/* Compresión con varios hilos (lz77_paralelo.c): si se aplica a input_size bytes y,
+ * con la entrada y la salida ya puestas en el contexto, los tokens de todos los
+ * sectores sin la marca de fin. Devuelve -1 si no llega a empezar (se comprime con
+ * un hilo); los demás errores quedan en ctx->error */
+int UsarParalelo(const LZ77Contexto *ctx, unsigned int input_size);
+int CodificarSectoresParalelo(LZ77Contexto *ctx);
+
+/* Búsqueda aún no hecha en LZ77Contexto.precalculadas */
+#define LZ77_NO_CALCULADA 0xFFFFFFFFu
+
+/* Primer byte de la salida cuando params.entropia != LZ77_ENTROPIA_NINGUNA */
+#define LZ77_MODO_TOKENS   0    /* Siguen los tokens sin recodificar */
+#define LZ77_MODO_HUFFMAN  1    /* Siguen segmentos recodificados con Huffman */
+#define LZ77_MODO_ALMACENADO 2  /* Sigue la entrada sin comprimir */
+
+/* Estimación por muestreo de que la compresión no va a reducir los datos (lz77_ajuste.c) */
+int PareceIncompresible(const LZ77Params *params, const unsigned char *datos, size_t tam);
+
+/* Bytes a cero que deben seguir a los tokens que recibe CodificarEntropia */
+#define LZ77_MARGEN_TOKENS 16
+
+/* Etapa de entropía (lz77_entropia.c): devuelven el tamaño de la salida o -1 */
+int CodificarEntropia(const LZ77Contexto *ctx, const unsigned char *tokens, unsigned char *output, unsigned int output_capacity);
+int DecodificarEntropia(LZ77Contexto *ctx, const unsigned char *input, unsigned int input_size, unsigned char *output, unsigned int output_capacity);
+
+#endif
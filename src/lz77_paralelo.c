@@ -0,0 +1,211 @@
+/* Compresión de un solo flujo con varios hilos: búsqueda por tramos y análisis en orden */
+
+#ifndef LZ77_PARALELO_C
+#define LZ77_PARALELO_C
+#include "lz77_hilos.h"
+#include "lz77_interno.h"
+
+/* Tramos en vuelo por hilo: los que se están buscando y los que esperan al análisis */
+#define LZ77_TRAMOS_POR_HILO 2
+
+/*
+ * Cada tramo es una tarea de LZ77EjecutarEnOrden. La producción (BuscarTramo) repite
+ * en un contexto propio del hilo lo que haría CodificarTokensCtx desde el sector que
+ * precede a la ventana del tramo: carga y hashea cada sector en el mismo hueco del
+ * diccionario circular, y en los sectores del tramo llama a BuscarEnDiccionarioCtx
+ * registrando en la tabla del tramo las búsquedas que hace (desde umbral), con los
+ * tokens a un borrador. Las cadenas solo se recorren dentro de la ventana y los bytes
+ * que la búsqueda lee tras cada sector son los mismos, así que cada resultado
+ * coincide con el del codificador de un hilo. El consumo (AnalizarTramo) carga los
+ * sectores en el contexto del llamante y vuelve a llamar a BuscarEnDiccionarioCtx,
+ * que toma las búsquedas de la tabla. El recorrido del hilo solo se separa del real
+ * si los fallos seguidos con los que empieza el tramo (aceleracion) no son los que
+ * calculó con el último sector anterior; si coinciden, todas las búsquedas están en
+ * la tabla y el llamante no mantiene cadenas. Si no, rehace las de la ventana
+ * anterior al tramo, hashea sus sectores y hace con ellas las búsquedas que falten.
+ */
+typedef struct TrabajoParalelo {
+    LZ77Contexto *ctx;                /* El del llamante: hash, análisis y escritura */
+    LZ77Contexto **contextos;         /* Uno por hilo para las búsquedas */
+    unsigned int *tablas;             /* en_vuelo tablas de pares (longitud, origen) */
+    unsigned int *fallos;             /* Fallos seguidos del hilo al empezar cada tramo */
+    unsigned char *borradores;        /* Uno por hilo para los tokens descartados */
+    unsigned int tam_tramo, en_vuelo, tam_borrador;
+    unsigned int num_sectores, sectores_por_tramo, sectores_por_ventana;
+    int cadenas_al_dia;               /* Las del llamante cubren la ventana del tramo siguiente */
+} TrabajoParalelo;
+
+void EstablecerHilosCtx(LZ77Contexto *ctx, int num_hilos) {
+    ctx->num_hilos = LZ77HilosEfectivos(num_hilos, 0);
+}
+
+/* Al menos cuatro ventanas: cada tramo vuelve a hashear la suya antes de buscar */
+static unsigned int TamanoTramo(const LZ77Contexto *ctx) {
+    unsigned int cuatro_ventanas = 4 * ctx->derived.tam_diccionario;
+    return cuatro_ventanas > LZ77_TRAMO_PARALELO ? cuatro_ventanas : LZ77_TRAMO_PARALELO;
+}
+
+int UsarParalelo(const LZ77Contexto *ctx, unsigned int input_size) {
+    return ctx->num_hilos > 1 && ctx->params.buscador == LZ77_BUSCADOR_CADENA && ctx->tam_prefijo == 0 &&
+           !ctx->preparado && input_size > TamanoTramo(ctx);
+}
+
+static int BuscarTramo(void *datos, unsigned int hilo, unsigned int tramo) {
+    TrabajoParalelo *t = (TrabajoParalelo *)datos;
+    LZ77Contexto *c = t->contextos[hilo];
+    const unsigned int tam_sector = c->derived.tam_sector, por_ventana = t->sectores_por_ventana;
+    const unsigned int primero = tramo * t->sectores_por_tramo;
+    const unsigned int fin = t->num_sectores - primero < t->sectores_por_tramo ? t->num_sectores : primero + t->sectores_por_tramo;
+    /* Desde el sector que ocupaba el hueco del primero: tras un último sector parcial la
+     * búsqueda lee lo que queda de él */
+    const unsigned int desde = primero > por_ventana ? primero - por_ventana : 0;
+    unsigned int *tabla = t->tablas + (size_t)(tramo % t->en_vuelo) * 2 * t->tam_tramo;
+    register unsigned int k;
+
+    c->in_ptr = t->ctx->in_ptr;
+    c->in_size = t->ctx->in_size;
+    c->in_pos = desde * tam_sector;
+    c->inicio_entrada = 0;
+    c->out_ptr = t->borradores + (size_t)hilo * t->tam_borrador;
+    c->out_capacity = t->tam_borrador;
+    c->fallos = 0;
+    c->registrar_precalculadas = 1;
+    InicializarCodificacionCtx(c);
+    for (k = desde; k < fin; k++) {
+        unsigned int posicion = (k % por_ventana) * tam_sector, longitud;
+        if (k >= por_ventana)
+            EliminarDatosCtx(c, posicion);
+        longitud = CargarDiccionarioCtx(c, posicion);
+        HashearDatosCtx(c, posicion, longitud);
+        if (k + 1 < primero)
+            continue;
+        /* El sector anterior al tramo solo se analiza para llegar a él con los mismos
+         * fallos seguidos que el llamante (casi siempre hay alguna coincidencia que
+         * los pone a 0) */
+        c->precalculadas = NULL;
+        if (k == primero)
+            t->fallos[tramo % t->en_vuelo] = c->fallos;
+        if (k >= primero) {
+            memset(tabla, 0xFF, 2 * (size_t)longitud * sizeof(unsigned int));
+            c->precalculadas = tabla;
+            c->primera_precalculada = posicion;
+            c->num_precalculadas = longitud;
+            tabla += 2 * longitud;
+        }
+        c->out_pos = c->buffer_bits = c->bits_en = 0;
+        BuscarEnDiccionarioCtx(c, posicion, longitud);
+    }
+    c->precalculadas = NULL;
+    return 0;
+}
+
+/* Hashea en el contexto del llamante la ventana anterior al sector primero como lo hace
+ * BuscarTramo, tras invalidar las cadenas; el diccionario ya tiene esos mismos datos */
+static void RehacerCadenas(TrabajoParalelo *t, unsigned int primero) {
+    LZ77Contexto *ctx = t->ctx;
+    const unsigned int tam_sector = ctx->derived.tam_sector, por_ventana = t->sectores_por_ventana;
+    const unsigned int desde = primero > por_ventana ? primero - por_ventana : 0;
+    const unsigned int buffer_bits = ctx->buffer_bits, bits_en = ctx->bits_en, in_pos = ctx->in_pos;
+    register unsigned int k;
+
+    ctx->in_pos = desde * tam_sector;
+    InicializarCodificacionCtx(ctx);
+    for (k = desde; k < primero; k++) {
+        unsigned int posicion = (k % por_ventana) * tam_sector, longitud;
+        if (k >= por_ventana)
+            EliminarDatosCtx(ctx, posicion);
+        longitud = CargarDiccionarioCtx(ctx, posicion);
+        HashearDatosCtx(ctx, posicion, longitud);
+    }
+    ctx->buffer_bits = buffer_bits;
+    ctx->bits_en = bits_en;
+    ctx->in_pos = in_pos;
+}
+
+static int AnalizarTramo(void *datos, unsigned int hilo, unsigned int tramo) {
+    TrabajoParalelo *t = (TrabajoParalelo *)datos;
+    LZ77Contexto *ctx = t->ctx;
+    const unsigned int tam_sector = ctx->derived.tam_sector;
+    const unsigned int primero = tramo * t->sectores_por_tramo;
+    const unsigned int fin = t->num_sectores - primero < t->sectores_por_tramo ? t->num_sectores : primero + t->sectores_por_tramo;
+    unsigned int *tabla = t->tablas + (size_t)(tramo % t->en_vuelo) * 2 * t->tam_tramo;
+    /* Sin aceleración los fallos seguidos no cambian el análisis */
+    const int hashear = ctx->params.aceleracion != 0 && ctx->fallos != t->fallos[tramo % t->en_vuelo];
+    register unsigned int k;
+
+    if (hashear && !t->cadenas_al_dia)
+        LZ77_CRONOMETRAR(ctx, ns_hashear, RehacerCadenas(t, primero));
+    for (k = primero; k < fin; k++) {
+        unsigned int posicion = (k % t->sectores_por_ventana) * tam_sector, longitud;
+        /* En modo ventana grande solo adelanta el límite de la ventana */
+        if (k >= t->sectores_por_ventana)
+            LZ77_CRONOMETRAR(ctx, ns_eliminar, EliminarDatosCtx(ctx, posicion));
+        longitud = CargarDiccionarioCtx(ctx, posicion);
+        if (hashear)
+            LZ77_CRONOMETRAR(ctx, ns_hashear, HashearDatosCtx(ctx, posicion, longitud));
+        ctx->precalculadas = tabla;
+        ctx->primera_precalculada = posicion;
+        ctx->num_precalculadas = longitud;
+        LZ77_CRONOMETRAR(ctx, ns_busqueda, BuscarEnDiccionarioCtx(ctx, posicion, longitud));
+        if (ctx->error)
+            return -1;              /* Salida llena */
+        tabla += 2 * longitud;
+    }
+    t->cadenas_al_dia = hashear;
+    return 0;
+}
+
+int CodificarSectoresParalelo(LZ77Contexto *ctx) {
+    TrabajoParalelo t;
+    unsigned int num_tramos;
+    register int i;
+    int num_hilos, r;
+
+    t.ctx = ctx;
+    t.tam_tramo = TamanoTramo(ctx);
+    t.sectores_por_tramo = t.tam_tramo / ctx->derived.tam_sector;
+    t.sectores_por_ventana = ctx->derived.tam_diccionario / ctx->derived.tam_sector;
+    t.num_sectores = (ctx->in_size + ctx->derived.tam_sector - 1) / ctx->derived.tam_sector;
+    num_tramos = (t.num_sectores + t.sectores_por_tramo - 1) / t.sectores_por_tramo;
+    num_hilos = LZ77HilosEfectivos(ctx->num_hilos, num_tramos);
+    t.en_vuelo = LZ77_TRAMOS_POR_HILO * (unsigned int)num_hilos;
+    t.tam_borrador = (unsigned int)CotaCompresion(&ctx->params, ctx->derived.tam_sector) + 8;
+
+    t.contextos = (LZ77Contexto **)calloc(num_hilos, sizeof(LZ77Contexto *));
+    t.tablas = (unsigned int *)malloc((size_t)t.en_vuelo * 2 * t.tam_tramo * sizeof(unsigned int));
+    t.fallos = (unsigned int *)malloc(t.en_vuelo * sizeof(unsigned int));
+    t.cadenas_al_dia = 1;
+    t.borradores = (unsigned char *)malloc((size_t)num_hilos * t.tam_borrador);
+    for (i = 0; t.contextos && i < num_hilos; i++)
+        if (!(t.contextos[i] = CrearContexto(&ctx->params)))
+            break;
+    if (!t.contextos || !t.tablas || !t.fallos || !t.borradores || i < num_hilos) {
+        for (i = 0; t.contextos && i < num_hilos; i++)
+            DestruirContexto(t.contextos[i]);
+        free(t.contextos);
+        free(t.tablas);
+        free(t.fallos);
+        free(t.borradores);
+        return -1;
+    }
+
+    InicializarCodificacionCtx(ctx);
+    ctx->inicio_entrada = 0;
+    r = LZ77EjecutarEnOrden(num_hilos, num_tramos, t.en_vuelo, BuscarTramo, AnalizarTramo, &t);
+    ctx->precalculadas = NULL;
+    ctx->registrar_precalculadas = 0;
+    if (r != 0 && !ctx->error) {
+        fprintf(stderr, "\nError en la compresión con varios hilos");
+        ctx->error = 1;
+    }
+
+    for (i = 0; i < num_hilos; i++)
+        DestruirContexto(t.contextos[i]);
+    free(t.contextos);
+    free(t.tablas);
+    free(t.fallos);
+    free(t.borradores);
+    return 0;
+}
+
+#endif